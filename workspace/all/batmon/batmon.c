@@ -16,16 +16,35 @@
 #define CHECK_BATTERY_TIMEOUT_S 15 // s - check battery percentage every 15s
 
 // Battery logs
-#define FILO_MIN_SIZE 1000
-#define MAX_DURATION_BEFORE_UPDATE 600
+#define FLUSH_INTERVAL_S 600 // s - write buffered samples out at least this often
+#define SAMPLE_BUFFER_SIZE 32
 
 static bool quit = false;
 static bool is_suspended = false;
+static bool suspend_requested = false;
 
 int battery_current_state_duration = 0;
 int best_session_time = 0;
 char *device_model = NULL;
 
+// samples are collected here and written in one transaction every
+// FLUSH_INTERVAL_S, when the buffer fills up, before anything reads them
+// back and before we get stopped for sleep. the last sample is the
+// current state, it stays buffered and keeps accumulating duration.
+typedef struct BatterySample {
+    int id;
+    int bat_level;
+    int duration;
+    int is_charging;
+} BatterySample;
+
+static BatterySample samples[SAMPLE_BUFFER_SIZE];
+static int sample_count = 0;
+static int next_sample_id = 1;
+
+static sqlite3 *bat_log_db = NULL;
+static sqlite3_stmt *write_stmt = NULL;
+
 void register_handler();
 void sigintHandler(int signum) {
     switch (signum)
@@ -34,11 +53,14 @@ void sigintHandler(int signum) {
     case SIGTERM:
         quit = true;
         break;
-    case SIGSTOP:
-        is_suspended = true;
+    case SIGTSTP:
+        // SIGSTOP cant be caught, so sleep sends this instead and we stop
+        // ourselves once the samples are safe
+        suspend_requested = true;
         break;
     case SIGCONT:
         is_suspended = false;
+        suspend_requested = false; // woken before we got to stop
         break;
     default:
         break;
@@ -60,8 +82,8 @@ void register_handler() {
     sigaction(SIGTERM, &sa, 0);
 
     sigemptyset(&sa.sa_mask);
-    sigaddset(&sa.sa_mask, SIGSTOP);
-    sigaction(SIGSTOP, &sa, 0);
+    sigaddset(&sa.sa_mask, SIGTSTP);
+    sigaction(SIGTSTP, &sa, 0);
 
     sigemptyset(&sa.sa_mask);
     sigaddset(&sa.sa_mask, SIGCONT);
@@ -73,91 +95,91 @@ void cleanup(void)
     remove("/tmp/percBat");
 }
 
-void update_current_duration(void)
+void flush_samples(void)
 {
-    sqlite3 *bat_log_db = open_battery_log_db();
+    if (bat_log_db == NULL || sample_count == 0)
+        return;
+
+    if (write_stmt == NULL) {
+        // replacing by slot is the retention, the row BATTERY_LOG_SIZE
+        // samples older than this one goes away. the current sample is
+        // rewritten in place on every flush as its duration grows.
+        const char *sql = "INSERT OR REPLACE INTO bat_activity(id, slot, device_serial, bat_level, duration, is_charging) VALUES(?1, ?2, ?3, ?4, ?5, ?6);";
+        if (sqlite3_prepare_v2(bat_log_db, sql, -1, &write_stmt, 0) != SQLITE_OK) {
+            LOG_error("batmon: %s\n", sqlite3_errmsg(bat_log_db));
+            write_stmt = NULL;
+            return;
+        }
+    }
 
-    if (bat_log_db != NULL)
+    if (sqlite3_exec(bat_log_db, "BEGIN IMMEDIATE;", NULL, NULL, NULL) != SQLITE_OK)
     {
-        const char *sql = "SELECT * FROM bat_activity WHERE device_serial = ? ORDER BY id DESC LIMIT 1;";
-        sqlite3_stmt *stmt;
-        int rc = sqlite3_prepare_v2(bat_log_db, sql, -1, &stmt, 0);
-
-        if (rc == SQLITE_OK)
+        // keep everything for the next attempt
+        LOG_error("batmon: %s\n", sqlite3_errmsg(bat_log_db));
+        return;
+    }
+    for (int i = 0; i < sample_count; i++)
+    {
+        BatterySample *sample = &samples[i];
+        sqlite3_bind_int(write_stmt, 1, sample->id);
+        sqlite3_bind_int(write_stmt, 2, sample->id % BATTERY_LOG_SIZE);
+        sqlite3_bind_text(write_stmt, 3, device_model, -1, SQLITE_STATIC);
+        sqlite3_bind_int(write_stmt, 4, sample->bat_level);
+        sqlite3_bind_int(write_stmt, 5, sample->duration);
+        sqlite3_bind_int(write_stmt, 6, sample->is_charging);
+        int rc = sqlite3_step(write_stmt);
+        sqlite3_reset(write_stmt);
+        if (rc != SQLITE_DONE)
         {
-            sqlite3_bind_text(stmt, 1, device_model, -1, SQLITE_STATIC);
-            rc = sqlite3_step(stmt);
-            if (rc == SQLITE_ROW)
-            {
-                int current_duration = sqlite3_column_int(stmt, 3);
-                int new_duration = current_duration + battery_current_state_duration;
-
-                const char *update_sql = "UPDATE bat_activity SET duration = ? WHERE id = ?";
-
-                sqlite3_stmt *update_stmt;
-                rc = sqlite3_prepare_v2(bat_log_db, update_sql, -1, &update_stmt, 0);
-
-                if (rc == SQLITE_OK)
-                {
-                    sqlite3_bind_int(update_stmt, 1, new_duration);
-                    sqlite3_bind_int(update_stmt, 2, sqlite3_column_int(stmt, 0));
-
-                    // Exécuter la mise à jour
-                    rc = sqlite3_step(update_stmt);
-
-                    battery_current_state_duration = 0;
-                    sqlite3_finalize(stmt);
-                    sqlite3_finalize(update_stmt);
-                }
-            }
+            LOG_error("batmon: %s\n", sqlite3_errmsg(bat_log_db));
+            sqlite3_exec(bat_log_db, "ROLLBACK;", NULL, NULL, NULL);
+            return;
         }
-        close_battery_log_db(bat_log_db);
     }
+    if (sqlite3_exec(bat_log_db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK)
+    {
+        LOG_error("batmon: %s\n", sqlite3_errmsg(bat_log_db));
+        sqlite3_exec(bat_log_db, "ROLLBACK;", NULL, NULL, NULL);
+        return;
+    }
+
+    samples[0] = samples[sample_count - 1];
+    sample_count = 1;
 }
 
-void log_new_percentage(int new_bat_value, int is_charging)
+void update_current_duration(void)
 {
-    sqlite3 *bat_log_db = open_battery_log_db();
+    // Current battery state duration addition
+    if (sample_count > 0)
+        samples[sample_count - 1].duration += battery_current_state_duration;
+    battery_current_state_duration = 0;
+}
 
-    if (bat_log_db != NULL)
+void log_new_percentage(int new_bat_value, int is_charging)
+{
+    if (sample_count == SAMPLE_BUFFER_SIZE)
+        flush_samples();
+    if (sample_count == SAMPLE_BUFFER_SIZE)
     {
-        char *sql = sqlite3_mprintf("INSERT INTO bat_activity(device_serial, bat_level, duration, is_charging) VALUES(%Q, %d, %d, %d);", device_model, new_bat_value, 0, is_charging);
-        sqlite3_exec(bat_log_db, sql, NULL, NULL, NULL);
-        sqlite3_free(sql);
-
-        // FILO logic
-        sqlite3_stmt *stmt;
-        const char *count_sql = "SELECT COUNT(id) FROM bat_activity";
-
-        int count = 0;
-
-        if (sqlite3_prepare_v2(bat_log_db, count_sql, -1, &stmt, NULL) == SQLITE_OK)
-        {
-            if (sqlite3_step(stmt) == SQLITE_ROW)
-            {
-                count = sqlite3_column_int(stmt, 0);
-            }
-            sqlite3_finalize(stmt);
-        }
-
-        if (count > FILO_MIN_SIZE)
-        {
-            // Deletion of the 1st entry
-            const char *delete_sql = "DELETE FROM bat_activity WHERE id = (SELECT MIN(id) FROM bat_activity);";
-            sqlite3_prepare_v2(bat_log_db, delete_sql, -1, &stmt, 0);
-            sqlite3_step(stmt);
-            sqlite3_finalize(stmt);
-        }
+        // couldnt write them, drop the oldest rather than grow
+        memmove(&samples[0], &samples[1], sizeof(BatterySample) * (SAMPLE_BUFFER_SIZE - 1));
+        sample_count--;
     }
-    close_battery_log_db(bat_log_db);
+
+    samples[sample_count++] = (BatterySample){
+        .id = next_sample_id++,
+        .bat_level = new_bat_value,
+        .duration = 0,
+        .is_charging = is_charging,
+    };
 }
 
 int get_current_session_time(void)
 {
     int current_session_duration = 0;
 
-    sqlite3 *bat_log_db = open_battery_log_db();
-    
+    flush_samples();
+
     if (bat_log_db != NULL)
     {
         const char *sql = "SELECT * FROM bat_activity WHERE device_serial = ? AND is_charging = 1 ORDER BY id DESC LIMIT 1;";
@@ -189,8 +211,7 @@ int get_current_session_time(void)
         }
         sqlite3_finalize(stmt);
     }
-    close_battery_log_db(bat_log_db);
-    
+
     return current_session_duration;
 }
 
@@ -198,8 +219,6 @@ int set_best_session_time(int best_session)
 {
     int is_success = 0;
 
-    sqlite3* bat_log_db = open_battery_log_db();
-
     if (bat_log_db != NULL)
     {
         const char *sql = "SELECT * FROM device_specifics WHERE device_serial = ? ORDER BY id LIMIT 1;";
@@ -231,7 +250,6 @@ int set_best_session_time(int best_session)
                 }
             }
         }
-        close_battery_log_db(bat_log_db);
     }
 
     return is_success;
@@ -240,10 +258,18 @@ int set_best_session_time(int best_session)
 int main(int argc, char *argv[])
 {
     device_model = PLAT_getModel();
-    sqlite3 *bat_log_db = open_battery_log_db();
+    // kept open for as long as we run
+    bat_log_db = open_battery_log_db();
     if(bat_log_db != NULL) {
         best_session_time = get_best_session_time(bat_log_db, device_model);
-        close_battery_log_db(bat_log_db);
+
+        sqlite3_stmt *stmt;
+        if (sqlite3_prepare_v2(bat_log_db, "SELECT MAX(id) FROM bat_activity;", -1, &stmt, 0) == SQLITE_OK)
+        {
+            if (sqlite3_step(stmt) == SQLITE_ROW)
+                next_sample_id = sqlite3_column_int(stmt, 0) + 1;
+            sqlite3_finalize(stmt);
+        }
     }
 
     FILE *fp;
@@ -252,6 +278,7 @@ int main(int argc, char *argv[])
     atexit(cleanup);
     register_handler();
     int ticks = CHECK_BATTERY_TIMEOUT_S;
+    int unflushed_s = 0;
 
     struct {
         int is_charging;
@@ -334,11 +361,26 @@ int main(int argc, char *argv[])
             ticks = -1;
         }
 
-        if (battery_current_state_duration > MAX_DURATION_BEFORE_UPDATE)
+        if (unflushed_s >= FLUSH_INTERVAL_S || suspend_requested)
+        {
             update_current_duration();
+            flush_samples();
+            unflushed_s = 0;
+        }
+
+        // checked again, a quick wake up may have cancelled it while flushing
+        if (suspend_requested)
+        {
+            LOG_debug("suspending\n");
+            suspend_requested = false;
+            is_suspended = true;
+            raise(SIGSTOP); // SIGCONT clears is_suspended
+            continue;
+        }
 
         sleep(1);
         battery_current_state_duration++;
+        unflushed_s++;
         ticks++;
     }
 
@@ -346,5 +388,8 @@ int main(int argc, char *argv[])
 
     // Current battery state duration addition
     update_current_duration();
+    flush_samples();
+    sqlite3_finalize(write_stmt);
+    close_battery_log_db(bat_log_db);
     return EXIT_SUCCESS;
 }
\ No newline at end of file
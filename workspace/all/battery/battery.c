@@ -76,10 +76,33 @@ typedef struct
     bool is_estimated;
 } GraphSpot;
 
+// a run of zoom consecutive graph spots folded into one screen column
+typedef struct
+{
+    int min_height;
+    int max_height;
+    int avg_height;
+    bool is_charging;
+    bool is_estimated;
+} GraphBucket;
+
+// GRAPH_SEGMENT_HIGH / GRAPH_SEGMENT_MED / GRAPH_SEGMENT_LOW
+#define GRAPH_ZOOM_LEVELS 3
+
+typedef struct
+{
+    int zoom; // spots per bucket
+    int size;
+    GraphBucket *buckets;
+} GraphLevel;
+
 struct Graph
 {
     struct GraphLayout layout;
     GraphSpot *graphic; // needs to be >= GRAPH_MAX_FULL_PAGES * screen_width
+    // graphic downsampled once per zoom level, so drawing any zoom is
+    // one bucket per column rather than skipping over spots
+    GraphLevel levels[GRAPH_ZOOM_LEVELS];
 } graph = {0};
 
 // One page in seconds
@@ -271,6 +294,50 @@ int duration_to_pixel(int duration)
     return (int)((graph.layout.graph_display_size_x * duration) / GRAPH_DISPLAY_DURATION);
 }
 
+void build_graph_levels(void)
+{
+    for (int l = 0; l < GRAPH_ZOOM_LEVELS; l++)
+    {
+        GraphLevel *level = &graph.levels[l];
+        level->zoom = 1 << l;
+        level->size = (graph.layout.graph_max_size + level->zoom - 1) / level->zoom;
+        free(level->buckets);
+        level->buckets = (GraphBucket *)calloc(level->size, sizeof(GraphBucket));
+
+        for (int b = 0; b < level->size; b++)
+        {
+            GraphBucket *bucket = &level->buckets[b];
+            int sum = 0;
+            int count = 0;
+            for (int i = b * level->zoom; i < (b + 1) * level->zoom && i < graph.layout.graph_max_size; i++)
+            {
+                GraphSpot *spot = &graph.graphic[i];
+                bucket->is_charging |= spot->is_charging;
+                bucket->is_estimated |= spot->is_estimated;
+                // empty spots dont pull the line down
+                if (spot->pixel_height <= 0)
+                    continue;
+                if (count == 0 || spot->pixel_height < bucket->min_height)
+                    bucket->min_height = spot->pixel_height;
+                if (spot->pixel_height > bucket->max_height)
+                    bucket->max_height = spot->pixel_height;
+                sum += spot->pixel_height;
+                count++;
+            }
+            if (count > 0)
+                bucket->avg_height = sum / count;
+        }
+    }
+}
+
+GraphLevel *graph_level(int zoom)
+{
+    for (int l = 0; l < GRAPH_ZOOM_LEVELS; l++)
+        if (graph.levels[l].zoom == zoom)
+            return &graph.levels[l];
+    return &graph.levels[0];
+}
+
 void compute_graph(void)
 {
     int total_duration = 0;
@@ -282,7 +349,7 @@ void compute_graph(void)
 
     if (bat_log_db != NULL)
     {
-        const char *sql = "SELECT * FROM bat_activity WHERE device_serial = ? ORDER BY id DESC;";
+        const char *sql = "SELECT id, device_serial, bat_level, duration, is_charging FROM bat_activity WHERE device_serial = ? ORDER BY id DESC;";
         sqlite3_stmt *stmt;
         int rc = sqlite3_prepare_v2(bat_log_db, sql, -1, &stmt, 0);
 
@@ -387,6 +454,8 @@ void compute_graph(void)
         sqlite3_finalize(stmt);
         close_battery_log_db(bat_log_db);
     }
+
+    build_graph_levels();
 }
 
 void drawBatteryIcon(int percent, SDL_Rect dst) {
@@ -499,6 +568,7 @@ void renderPage()
     int y_end = 0;
 
     int zoom_level = (int)segment_duration / GRAPH_SEGMENT_HIGH;
+    GraphLevel *level = graph_level(zoom_level);
 
     if (SDL_LockSurface(screen) == 0)
     {
@@ -509,10 +579,11 @@ void renderPage()
         for (int i = 0; i < graph.layout.graph_max_size - current_index; i += zoom_level)
         {
             x = graph.layout.graph_display_start_x + (int)(i / zoom_level);
-            y = graph.graphic[i + current_index].pixel_height;
+            GraphBucket *bucket = &level->buckets[(i + current_index) / level->zoom];
+            y = bucket->avg_height;
 
-            bool is_charging = graph.graphic[i + current_index].is_charging;
-            bool is_estimated = graph.graphic[i + current_index].is_estimated;
+            bool is_charging = bucket->is_charging;
+            bool is_estimated = bucket->is_estimated;
             // if ((!is_charging)
             if ((!is_charging) && (!is_estimated))
                 pixel_color = white_pixel_color;
@@ -531,10 +602,10 @@ void renderPage()
 
             if (x < graph_display_right && y > 0)
             {
-                // Actual graph line
+                // Actual graph line, spanning whatever range the column covers when zoomed out
                 if (half_line_width >= 0)
                 {
-                    for (int k = -half_line_width; k <= half_line_width; k++)
+                    for (int k = -half_line_width - (bucket->max_height - y); k <= half_line_width + (y - bucket->min_height); k++)
                     {
                         int index = (graph_display_bottom - y + k) * screen->pitch + x * screen->format->BytesPerPixel;
                         *((Uint32 *)((Uint8 *)screen->pixels + index)) = pixel_color;
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE // for sched_setaffinity
 #include "defines.h"
 #include "api.h"
 
@@ -5,14 +6,21 @@
 #include <fcntl.h>
 #include <math.h>
 #include <msettings.h>
+#include <poll.h>
 #include <pthread.h>
 #include <samplerate.h>
+#include <sched.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
 #include <unistd.h>
 #include <sys/stat.h>
 
@@ -158,7 +166,7 @@ static struct PWR_Context
 	int requested_wake;
 	int resume_tick;
 
-	pthread_t battery_pt;
+	int task; // battery/network polling
 	int is_charging;
 	int charge;
 	int should_warn;
@@ -213,11 +221,14 @@ int currentsamplerateout = 0;
 int should_rotate = 0;
 int currentcputemp = 0;
 
-FALLBACK_IMPLEMENTATION void *PLAT_cpu_monitor(void *arg)
+FALLBACK_IMPLEMENTATION void PLAT_cpuFrame(int busy, int budget)
 {
-	return NULL;
+	if (budget > 0)
+		currentcpuse = currentcpuse * 0.95 + busy * 100.0 / budget * 0.05;
 }
 
+FALLBACK_IMPLEMENTATION void PLAT_cpuBoost(int frames) {}
+
 FALLBACK_IMPLEMENTATION void PLAT_getCPUTemp()
 {
 	currentcputemp = 0;
@@ -405,10 +416,18 @@ static uint64_t per_frame_start = 0;
 // filling with  60.1 cause i'd rather underrun than overflow in start phase
 static double fps_buffer[FPS_BUFFER_SIZE] = {60.1};
 static int fps_buffer_index = 0;
+// pacing sleeps and blocking on the swap since GFX_startFrame, that time
+// isn't load so the cpu governor leaves it out
+static uint64_t frame_waited = 0;
 
 void GFX_startFrame(void)
 {
 	frame_start = SDL_GetTicks();
+	frame_waited = 0;
+}
+uint64_t GFX_frameWaited(void)
+{
+	return frame_waited;
 }
 
 void chmodfile(const char *file, int writable)
@@ -581,8 +600,9 @@ void GFX_flip(SDL_Surface *screen)
 }
 void GFX_GL_Swap()
 {
-
+	uint64_t wait_start = getMicroseconds();
 	PLAT_GL_Swap();
+	frame_waited += getMicroseconds() - wait_start;
 
 	currentfps = current_fps;
 	fps_counter++;
@@ -652,6 +672,7 @@ void GFX_flip_fixed_rate(SDL_Surface *screen, double target_fps)
 		last_target_fps = target_fps;
 	}
 
+	uint64_t wait_start = getMicroseconds();
 	int64_t frame_duration = perf_freq / target_fps;
 	int64_t time_of_frame = first_frame_start_time + frame_index * frame_duration;
 	int64_t offset = now - time_of_frame;
@@ -702,6 +723,7 @@ void GFX_flip_fixed_rate(SDL_Surface *screen, double target_fps)
 	}
 	// PLAT_flip(screen, 0);
 	PLAT_GL_Swap();
+	frame_waited += getMicroseconds() - wait_start;
 
 	double elapsed_time_s = (double)(SDL_GetPerformanceCounter() - per_frame_start) / perf_freq;
 	double tempfps = 1.0 / elapsed_time_s;
@@ -880,6 +902,12 @@ struct blend_args
 	int h_ratio_out;
 	uint16_t h_bp[2];
 	uint16_t *blend_line;
+	// scaleAA32 only
+	uint32_t *blend_line32;
+	uint32_t *col_a;
+	uint32_t *col_b;
+	uint32_t *col_mode;
+	int col_count;
 } blend_args;
 
 // Pure C fallbacks
@@ -1115,10 +1143,217 @@ static void scaleAA(void *__restrict src, void *__restrict dst, uint32_t w, uint
 	}
 }
 
-scaler_t GFX_getAAScaler(GFX_Renderer *renderer)
+///////////////////////////////
+
+// 32bpp version of scaleAA for the RGBA8888 frames minarch produces. the
+// blend pattern is the same but which source columns and weights feed each
+// output pixel is worked out once in GFX_getAAScaler32, leaving two flat
+// loops that the NEON and SSE2 paths run four pixels at a time. averages are
+// per channel and round down in every path so they all match the C output.
+
+enum {
+	AA_A,	 // aaaa
+	AA_AAAB, // 1/4 b
+	AA_AABB, // 1/2 b
+	AA_ABBB, // 3/4 b
+	AA_B,	 // bbbb
+};
+
+static inline uint32_t average8888(uint32_t a, uint32_t b)
+{
+	return (a & b) + (((a ^ b) & 0xfefefefe) >> 1);
+}
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+
+static inline uint32x4_t average8888_neon(uint32x4_t a, uint32x4_t b)
+{
+	return vreinterpretq_u32_u8(vhaddq_u8(vreinterpretq_u8_u32(a), vreinterpretq_u8_u32(b)));
+}
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+
+static inline __m128i average8888_sse2(__m128i a, __m128i b)
+{
+	// pavgb rounds up, take the carry back off where the low bits differ
+	return _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+}
+#endif
+
+// out = avg(top, bottom), or when third avg(avg(top, bottom), bottom)
+static void blendRows32(uint32_t *__restrict out, const uint32_t *top, const uint32_t *bottom, int count, int third)
+{
+	int i = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+	for (; i + 4 <= count; i += 4)
+	{
+		uint32x4_t t = vld1q_u32(top + i);
+		uint32x4_t b = vld1q_u32(bottom + i);
+		uint32x4_t o = average8888_neon(t, b);
+		if (third)
+			o = average8888_neon(o, b);
+		vst1q_u32(out + i, o);
+	}
+#elif defined(__SSE2__)
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i t = _mm_loadu_si128((const __m128i *)(top + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(bottom + i));
+		__m128i o = average8888_sse2(t, b);
+		if (third)
+			o = average8888_sse2(o, b);
+		_mm_storeu_si128((__m128i *)(out + i), o);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		uint32_t o = average8888(top[i], bottom[i]);
+		out[i] = third ? average8888(o, bottom[i]) : o;
+	}
+}
+
+static void blendCols32(uint32_t *__restrict out, const uint32_t *line)
+{
+	const uint32_t *ca = blend_args.col_a;
+	const uint32_t *cb = blend_args.col_b;
+	const uint32_t *mode = blend_args.col_mode;
+	int count = blend_args.col_count;
+
+	int x = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+	for (; x + 4 <= count; x += 4)
+	{
+		uint32x4_t a = vdupq_n_u32(line[ca[x]]);
+		a = vsetq_lane_u32(line[ca[x + 1]], a, 1);
+		a = vsetq_lane_u32(line[ca[x + 2]], a, 2);
+		a = vsetq_lane_u32(line[ca[x + 3]], a, 3);
+		uint32x4_t b = vdupq_n_u32(line[cb[x]]);
+		b = vsetq_lane_u32(line[cb[x + 1]], b, 1);
+		b = vsetq_lane_u32(line[cb[x + 2]], b, 2);
+		b = vsetq_lane_u32(line[cb[x + 3]], b, 3);
+		uint32x4_t m = vld1q_u32(mode + x);
+
+		uint32x4_t ab = average8888_neon(a, b);
+		uint32x4_t o = a;
+		o = vbslq_u32(vceqq_u32(m, vdupq_n_u32(AA_AAAB)), average8888_neon(a, ab), o);
+		o = vbslq_u32(vceqq_u32(m, vdupq_n_u32(AA_AABB)), ab, o);
+		o = vbslq_u32(vceqq_u32(m, vdupq_n_u32(AA_ABBB)), average8888_neon(ab, b), o);
+		o = vbslq_u32(vceqq_u32(m, vdupq_n_u32(AA_B)), b, o);
+		vst1q_u32(out + x, o);
+	}
+#elif defined(__SSE2__)
+	for (; x + 4 <= count; x += 4)
+	{
+		__m128i a = _mm_set_epi32(line[ca[x + 3]], line[ca[x + 2]], line[ca[x + 1]], line[ca[x]]);
+		__m128i b = _mm_set_epi32(line[cb[x + 3]], line[cb[x + 2]], line[cb[x + 1]], line[cb[x]]);
+		__m128i m = _mm_loadu_si128((const __m128i *)(mode + x));
+
+		__m128i ab = average8888_sse2(a, b);
+		__m128i o = a;
+		__m128i k;
+		k = _mm_cmpeq_epi32(m, _mm_set1_epi32(AA_AAAB));
+		o = _mm_or_si128(_mm_and_si128(k, average8888_sse2(a, ab)), _mm_andnot_si128(k, o));
+		k = _mm_cmpeq_epi32(m, _mm_set1_epi32(AA_AABB));
+		o = _mm_or_si128(_mm_and_si128(k, ab), _mm_andnot_si128(k, o));
+		k = _mm_cmpeq_epi32(m, _mm_set1_epi32(AA_ABBB));
+		o = _mm_or_si128(_mm_and_si128(k, average8888_sse2(ab, b)), _mm_andnot_si128(k, o));
+		k = _mm_cmpeq_epi32(m, _mm_set1_epi32(AA_B));
+		o = _mm_or_si128(_mm_and_si128(k, b), _mm_andnot_si128(k, o));
+		_mm_storeu_si128((__m128i *)(out + x), o);
+	}
+#endif
+	for (; x < count; x++)
+	{
+		uint32_t a = line[ca[x]];
+		uint32_t b = line[cb[x]];
+		switch (mode[x])
+		{
+		case AA_A:
+			out[x] = a;
+			break;
+		case AA_AAAB:
+			out[x] = average8888(a, average8888(a, b));
+			break;
+		case AA_AABB:
+			out[x] = average8888(a, b);
+			break;
+		case AA_ABBB:
+			out[x] = average8888(average8888(a, b), b);
+			break;
+		default:
+			out[x] = b;
+			break;
+		}
+	}
+}
+
+static void scaleAA32(void *__restrict src, void *__restrict dst, uint32_t w, uint32_t h, uint32_t pitch, uint32_t dst_w, uint32_t dst_h, uint32_t dst_p)
+{
+	int dy = 0;
+	int lines = h;
+
+	int rat_h = blend_args.h_ratio_in;
+	int rat_dst_h = blend_args.h_ratio_out;
+	uint16_t *bh = blend_args.h_bp;
+
+	// upscaling repeats the same row a lot, those are copied from the row above
+	const void *last_src = NULL;
+	int last_blend = -1;
+
+	while (lines--)
+	{
+		const uint32_t *src32 = (const uint32_t *)src;
+		const uint32_t *next32 = lines ? (const uint32_t *)(src + pitch) : src32;
+
+		while (dy < rat_dst_h)
+		{
+			const uint32_t *line = blend_args.blend_line32;
+			int blend;
+			if (dy > rat_dst_h - bh[0])
+				blend = AA_B;
+			else if (dy <= bh[0])
+				blend = AA_A;
+			else if (dy <= bh[1])
+				blend = AA_AAAB;
+			else if (dy > rat_dst_h - bh[1])
+				blend = AA_ABBB;
+			else
+				blend = AA_AABB;
+
+			if (src == last_src && blend == last_blend)
+			{
+				memcpy(dst, dst - dst_p, blend_args.col_count * sizeof(uint32_t));
+			}
+			else
+			{
+				if (blend == AA_A)
+					line = src32;
+				else if (blend == AA_B)
+					line = next32;
+				else if (blend == AA_AAAB)
+					blendRows32(blend_args.blend_line32, next32, src32, w, 1);
+				else
+					blendRows32(blend_args.blend_line32, src32, next32, w, blend == AA_ABBB);
+
+				blendCols32((uint32_t *)dst, line);
+				last_src = src;
+				last_blend = blend;
+			}
+
+			dy += rat_h;
+			dst += dst_p;
+		}
+
+		dy -= rat_dst_h;
+		src += pitch;
+	}
+}
+
+static void setupAAScaler(GFX_Renderer *renderer)
 {
 	int gcd_w, div_w, gcd_h, div_h;
-	blend_args.blend_line = (uint16_t *)calloc(renderer->src_w, sizeof(uint16_t));
+	GFX_freeAAScaler();
 
 	gcd_w = gcd(renderer->src_w, renderer->dst_w);
 	blend_args.w_ratio_in = renderer->src_w / gcd_w;
@@ -1139,9 +1374,76 @@ scaler_t GFX_getAAScaler(GFX_Renderer *renderer)
 	div_h = round(blend_args.h_ratio_out / blend_denominator);
 	blend_args.h_bp[0] = div_h;
 	blend_args.h_bp[1] = blend_args.h_ratio_out >> 1;
+}
 
+scaler_t GFX_getAAScaler(GFX_Renderer *renderer)
+{
+	setupAAScaler(renderer);
+	blend_args.blend_line = (uint16_t *)calloc(renderer->src_w, sizeof(uint16_t));
 	return scaleAA;
 }
+
+scaler_t GFX_getAAScaler32(GFX_Renderer *renderer)
+{
+	setupAAScaler(renderer);
+
+	int w = renderer->src_w;
+	int rat_w = blend_args.w_ratio_in;
+	int rat_dst_w = blend_args.w_ratio_out;
+	uint16_t *bw = blend_args.w_bp;
+
+	// walks the same dx steps scaleAA does per pixel, once to size the tables and once to fill them
+	uint32_t count = 0;
+	int dx = 0;
+	for (int col = 0; col < w; col++)
+	{
+		for (; dx < rat_dst_w; dx += rat_w)
+			count++;
+		dx -= rat_dst_w;
+	}
+
+	blend_args.blend_line32 = calloc(w, sizeof(uint32_t));
+	blend_args.col_a = calloc(count, sizeof(uint32_t));
+	blend_args.col_b = calloc(count, sizeof(uint32_t));
+	blend_args.col_mode = calloc(count, sizeof(uint32_t));
+	blend_args.col_count = count;
+	if (!blend_args.blend_line32 || !blend_args.col_a || !blend_args.col_b || !blend_args.col_mode)
+	{
+		LOG_error("GFX_getAAScaler32: out of memory\n");
+		GFX_freeAAScaler();
+		return NULL;
+	}
+
+	int x = 0;
+	dx = 0;
+	for (int col = 0; col < w; col++)
+	{
+		while (dx < rat_dst_w)
+		{
+			int mode;
+			if (dx > rat_dst_w - bw[0])
+				mode = AA_B;
+			else if (dx <= bw[0])
+				mode = AA_A;
+			else if (dx > rat_dst_w - bw[1])
+				mode = AA_ABBB;
+			else if (dx <= bw[1])
+				mode = AA_AAAB;
+			else
+				mode = AA_AABB;
+
+			blend_args.col_a[x] = col;
+			blend_args.col_b[x] = col + 1 < w ? col + 1 : col; // the last column has nothing to its right
+			blend_args.col_mode[x] = mode;
+			x++;
+			dx += rat_w;
+		}
+		dx -= rat_dst_w;
+	}
+
+	return scaleAA32;
+}
+
 void GFX_freeAAScaler(void)
 {
 	if (blend_args.blend_line != NULL)
@@ -1149,6 +1451,15 @@ void GFX_freeAAScaler(void)
 		free(blend_args.blend_line);
 		blend_args.blend_line = NULL;
 	}
+	free(blend_args.blend_line32);
+	free(blend_args.col_a);
+	free(blend_args.col_b);
+	free(blend_args.col_mode);
+	blend_args.blend_line32 = NULL;
+	blend_args.col_a = NULL;
+	blend_args.col_b = NULL;
+	blend_args.col_mode = NULL;
+	blend_args.col_count = 0;
 }
 
 ///////////////////////////////
@@ -2107,6 +2418,385 @@ SDL_Color GFX_mapColor(uint32_t c)
 
 ///////////////////////////////
 
+// save-state previews and game switcher screenshots
+// stored as QOI (https://qoiformat.org), it encodes several times faster than
+// zlib'd PNG at a similar size for this kind of content. files keep their
+// legacy .bmp name and GFX_loadPreview() still reads older PNG previews.
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xc0
+#define QOI_OP_RGB 0xfe
+#define QOI_OP_RGBA 0xff
+#define QOI_MASK_2 0xc0
+#define QOI_HEADER_SIZE 14
+#define QOI_PADDING_SIZE 8
+#define QOI_HASH(c) (((c)[0] * 3 + (c)[1] * 5 + (c)[2] * 7 + (c)[3] * 11) % 64)
+
+// rgba is R,G,B,A bytes (SDL_PIXELFORMAT_ABGR8888), caller must free the result
+static uint8_t *QOI_encode(const uint8_t *rgba, int w, int h, size_t *out_len)
+{
+	size_t max_len = QOI_HEADER_SIZE + (size_t)w * h * 5 + QOI_PADDING_SIZE;
+	uint8_t *bytes = malloc(max_len);
+	if (!bytes)
+		return NULL;
+
+	size_t p = 0;
+	memcpy(bytes, "qoif", 4);
+	p += 4;
+	uint32_t dims[2] = {w, h};
+	for (int i = 0; i < 2; i++)
+	{
+		bytes[p++] = dims[i] >> 24;
+		bytes[p++] = dims[i] >> 16;
+		bytes[p++] = dims[i] >> 8;
+		bytes[p++] = dims[i];
+	}
+	bytes[p++] = 4; // channels
+	bytes[p++] = 0; // sRGB
+
+	uint8_t index[64][4] = {0};
+	uint8_t prev[4] = {0, 0, 0, 255};
+	int run = 0;
+	size_t px_len = (size_t)w * h * 4;
+	for (size_t px = 0; px < px_len; px += 4)
+	{
+		const uint8_t *c = rgba + px;
+		if (!memcmp(c, prev, 4))
+		{
+			run++;
+			if (run == 62 || px == px_len - 4)
+			{
+				bytes[p++] = QOI_OP_RUN | (run - 1);
+				run = 0;
+			}
+			continue;
+		}
+		if (run > 0)
+		{
+			bytes[p++] = QOI_OP_RUN | (run - 1);
+			run = 0;
+		}
+
+		int hash = QOI_HASH(c);
+		if (!memcmp(index[hash], c, 4))
+		{
+			bytes[p++] = QOI_OP_INDEX | hash;
+		}
+		else
+		{
+			memcpy(index[hash], c, 4);
+			if (c[3] == prev[3])
+			{
+				int8_t vr = c[0] - prev[0];
+				int8_t vg = c[1] - prev[1];
+				int8_t vb = c[2] - prev[2];
+				int8_t vg_r = vr - vg;
+				int8_t vg_b = vb - vg;
+				if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+				{
+					bytes[p++] = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+				}
+				else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8)
+				{
+					bytes[p++] = QOI_OP_LUMA | (vg + 32);
+					bytes[p++] = (vg_r + 8) << 4 | (vg_b + 8);
+				}
+				else
+				{
+					bytes[p++] = QOI_OP_RGB;
+					bytes[p++] = c[0];
+					bytes[p++] = c[1];
+					bytes[p++] = c[2];
+				}
+			}
+			else
+			{
+				bytes[p++] = QOI_OP_RGBA;
+				memcpy(bytes + p, c, 4);
+				p += 4;
+			}
+		}
+		memcpy(prev, c, 4);
+	}
+
+	memset(bytes + p, 0, QOI_PADDING_SIZE - 1);
+	p += QOI_PADDING_SIZE - 1;
+	bytes[p++] = 1;
+
+	*out_len = p;
+	return bytes;
+}
+
+// returns R,G,B,A bytes, caller must free
+static uint8_t *QOI_decode(const uint8_t *bytes, size_t len, int *out_w, int *out_h)
+{
+	if (len < QOI_HEADER_SIZE + QOI_PADDING_SIZE || memcmp(bytes, "qoif", 4))
+		return NULL;
+
+	uint32_t w = (uint32_t)bytes[4] << 24 | bytes[5] << 16 | bytes[6] << 8 | bytes[7];
+	uint32_t h = (uint32_t)bytes[8] << 24 | bytes[9] << 16 | bytes[10] << 8 | bytes[11];
+	if (!w || !h || w > 8192 || h > 8192)
+		return NULL;
+
+	size_t px_len = (size_t)w * h * 4;
+	uint8_t *rgba = malloc(px_len);
+	if (!rgba)
+		return NULL;
+
+	uint8_t index[64][4] = {0};
+	uint8_t c[4] = {0, 0, 0, 255};
+	int run = 0;
+	size_t p = QOI_HEADER_SIZE;
+	size_t chunks_len = len - QOI_PADDING_SIZE;
+	for (size_t px = 0; px < px_len; px += 4)
+	{
+		if (run > 0)
+		{
+			run--;
+		}
+		else if (p < chunks_len)
+		{
+			int b1 = bytes[p++];
+			if (b1 == QOI_OP_RGB)
+			{
+				c[0] = bytes[p++];
+				c[1] = bytes[p++];
+				c[2] = bytes[p++];
+			}
+			else if (b1 == QOI_OP_RGBA)
+			{
+				memcpy(c, bytes + p, 4);
+				p += 4;
+			}
+			else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX)
+			{
+				memcpy(c, index[b1], 4);
+			}
+			else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF)
+			{
+				c[0] += ((b1 >> 4) & 0x03) - 2;
+				c[1] += ((b1 >> 2) & 0x03) - 2;
+				c[2] += (b1 & 0x03) - 2;
+			}
+			else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA)
+			{
+				int b2 = bytes[p++];
+				int vg = (b1 & 0x3f) - 32;
+				c[0] += vg - 8 + ((b2 >> 4) & 0x0f);
+				c[1] += vg;
+				c[2] += vg - 8 + (b2 & 0x0f);
+			}
+			else if ((b1 & QOI_MASK_2) == QOI_OP_RUN)
+			{
+				run = (b1 & 0x3f);
+			}
+			memcpy(index[QOI_HASH(c)], c, 4);
+		}
+		memcpy(rgba + px, c, 4);
+	}
+
+	*out_w = w;
+	*out_h = h;
+	return rgba;
+}
+
+typedef struct PreviewJob
+{
+	SDL_Surface *surface;
+	void *pixels;
+	char path[MAX_PATH];
+} PreviewJob;
+
+static SDL_Thread *preview_thread = NULL;
+
+static int GFX_previewThread(void *data)
+{
+	PreviewJob *job = data;
+	SDL_Surface *src = job->surface;
+	SDL_Surface *converted = NULL;
+	if (src->format->format != SDL_PIXELFORMAT_ABGR8888)
+	{
+		converted = SDL_ConvertSurfaceFormat(src, SDL_PIXELFORMAT_ABGR8888, 0);
+		if (converted)
+			src = converted;
+	}
+
+	// nothing is ever displayed larger than the screen so box filter anything bigger down to it
+	int w = src->w;
+	int h = src->h;
+	int factor = 1;
+	while (w / factor > FIXED_WIDTH || h / factor > FIXED_HEIGHT)
+		factor++;
+
+	uint8_t *rgba = NULL;
+	if (factor > 1)
+	{
+		w /= factor;
+		h /= factor;
+		rgba = malloc((size_t)w * h * 4);
+		if (rgba)
+		{
+			int area = factor * factor;
+			for (int y = 0; y < h; y++)
+			{
+				for (int x = 0; x < w; x++)
+				{
+					uint32_t sum[4] = {0};
+					for (int sy = 0; sy < factor; sy++)
+					{
+						const uint8_t *row = (const uint8_t *)src->pixels + (size_t)(y * factor + sy) * src->pitch + (size_t)x * factor * 4;
+						for (int sx = 0; sx < factor * 4; sx++)
+							sum[sx & 3] += row[sx];
+					}
+					uint8_t *dst = rgba + ((size_t)y * w + x) * 4;
+					for (int i = 0; i < 4; i++)
+						dst[i] = sum[i] / area;
+				}
+			}
+		}
+	}
+	else if (src->pitch == w * 4)
+	{
+		rgba = src->pixels;
+	}
+	else
+	{
+		rgba = malloc((size_t)w * h * 4);
+		if (rgba)
+		{
+			for (int y = 0; y < h; y++)
+				memcpy(rgba + (size_t)y * w * 4, (uint8_t *)src->pixels + (size_t)y * src->pitch, w * 4);
+		}
+	}
+
+	size_t len = 0;
+	uint8_t *bytes = rgba ? QOI_encode(rgba, w, h, &len) : NULL;
+	if (bytes)
+	{
+		// write next to the destination and swap in so readers never see a partial file
+		char tmp_path[MAX_PATH + 4];
+		snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", job->path);
+		FILE *file = fopen(tmp_path, "wb");
+		if (file)
+		{
+			int ok = fwrite(bytes, 1, len, file) == len;
+			fclose(file);
+			if (ok)
+				rename(tmp_path, job->path);
+			else
+				unlink(tmp_path);
+			LOG_info("saved preview %s (%ix%i, %i bytes)\n", job->path, w, h, (int)len);
+		}
+		else
+			LOG_error("Failed to open preview for writing: %s\n", tmp_path);
+		free(bytes);
+	}
+
+	if (rgba && rgba != src->pixels)
+		free(rgba);
+	if (converted)
+		SDL_FreeSurface(converted);
+	SDL_FreeSurface(job->surface);
+	if (job->pixels)
+		free(job->pixels);
+	free(job);
+	return 0;
+}
+
+static int GFX_previewWorker(void *data)
+{
+	THREAD_register(THREAD_HOUSEKEEPING);
+	int result = GFX_previewThread(data);
+	THREAD_unregister();
+	return result;
+}
+
+void GFX_savePreview(SDL_Surface *surface, void *pixels, const char *path)
+{
+	PreviewJob *job = malloc(sizeof(PreviewJob));
+	if (!job)
+	{
+		SDL_FreeSurface(surface);
+		if (pixels)
+			free(pixels);
+		return;
+	}
+	job->surface = surface;
+	job->pixels = pixels;
+	snprintf(job->path, sizeof(job->path), "%s", path);
+
+	GFX_waitPreview(); // one at a time, a later save of the same slot must land last
+	preview_thread = SDL_CreateThread(GFX_previewWorker, "SavePreviewThread", job);
+	if (!preview_thread)
+		GFX_previewThread(job);
+}
+
+void GFX_waitPreview(void)
+{
+	if (preview_thread)
+	{
+		SDL_WaitThread(preview_thread, NULL);
+		preview_thread = NULL;
+	}
+}
+
+SDL_Surface *GFX_loadImage(const char *path, Uint32 format)
+{
+	SDL_Surface *image = NULL;
+	FILE *file = fopen(path, "rb");
+	if (!file)
+		return NULL;
+
+	char magic[4] = {0};
+	fread(magic, 1, 4, file);
+	if (!memcmp(magic, "qoif", 4))
+	{
+		fseek(file, 0, SEEK_END);
+		size_t len = ftell(file);
+		rewind(file);
+		uint8_t *bytes = malloc(len);
+		if (bytes && fread(bytes, 1, len, file) == len)
+		{
+			int w, h;
+			uint8_t *rgba = QOI_decode(bytes, len, &w, &h);
+			if (rgba)
+			{
+				SDL_Surface *tmp = SDL_CreateRGBSurfaceWithFormatFrom(rgba, w, h, 32, w * 4, SDL_PIXELFORMAT_ABGR8888);
+				if (tmp)
+				{
+					image = SDL_ConvertSurfaceFormat(tmp, format, 0);
+					SDL_FreeSurface(tmp);
+				}
+				free(rgba);
+			}
+		}
+		if (bytes)
+			free(bytes);
+		fclose(file);
+	}
+	else
+	{
+		// png and anything else SDL_image reads
+		fclose(file);
+		SDL_Surface *tmp = IMG_Load(path);
+		if (tmp)
+		{
+			image = SDL_ConvertSurfaceFormat(tmp, format, 0);
+			SDL_FreeSurface(tmp);
+		}
+	}
+	return image;
+}
+
+SDL_Surface *GFX_loadPreview(const char *path)
+{
+	return GFX_loadImage(path, SDL_PIXELFORMAT_RGBA8888);
+}
+
+///////////////////////////////
+
 // based on picoarch's audio
 // implementation, rewritten
 // to (try to) understand it
@@ -2124,6 +2814,13 @@ pthread_mutex_t audio_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static void SND_audioCallback(void *userdata, uint8_t *stream, int len)
 {
+	static __thread int registered = 0; // SDL starts a new thread whenever the device is reopened
+	if (!registered)
+	{
+		THREAD_register(THREAD_AUDIO);
+		registered = 1;
+	}
+
 	if (snd.frame_count == 0)
 		return;
 	if (!snd.initialized)
@@ -2685,6 +3382,7 @@ void SND_quit(void)
 #else
 	SDL_CloseAudio();
 #endif
+	THREAD_forget(THREAD_AUDIO); // its thread is gone and the tid can be reused
 
 	SDL_QuitSubSystem(SDL_INIT_AUDIO);
 	if(SDL_WasInit(SDL_INIT_AUDIO))
@@ -3310,39 +4008,407 @@ int PAD_tappedSelect(uint32_t now)
 }
 
 ///////////////////////////////
-static struct VIB_Context
+
+// thread placement
+// pinned splits the cpus into housekeeping on cpu 0 (which also takes most
+// irqs), audio on the last cpu and emulation on everything in between. threads
+// the core starts itself inherit the emulation cpus, which starves cores that
+// run several busy threads, so it's opt in and priority is the default. audio
+// gets SCHED_FIFO when we're allowed to and a raised nice level when we're not.
+
+#define THREAD_MAX 16
+#define THREAD_AUDIO_PRIORITY 50 // SCHED_FIFO, below the kernel's own irq threads
+#define THREAD_AUDIO_NICE -10 // when SCHED_FIFO isn't permitted
+#define THREAD_HOUSEKEEPING_NICE 10
+
+static struct
+{
+	pthread_mutex_t lock;
+	int profile;
+	int count;
+	struct
+	{
+		pid_t tid;
+		int role;
+	} list[THREAD_MAX];
+	int warned;
+} threads = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+#ifdef __linux__
+static pid_t THREAD_id(void)
 {
-	int initialized;
+	return syscall(SYS_gettid);
+}
+
+static int THREAD_alive(pid_t tid)
+{
+	char path[32];
+	sprintf(path, "/proc/self/task/%i", tid);
+	return access(path, F_OK) == 0;
+}
+
+static void THREAD_place(pid_t tid, int role, int profile)
+{
+	int cpus = sysconf(_SC_NPROCESSORS_CONF);
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (profile == THREAD_PROFILE_PINNED && cpus >= 4)
+	{
+		if (role == THREAD_HOUSEKEEPING)
+			CPU_SET(0, &set);
+		else if (role == THREAD_AUDIO)
+			CPU_SET(cpus - 1, &set);
+		else
+			for (int i = 1; i < cpus - 1; i++)
+				CPU_SET(i, &set);
+	}
+	else
+	{
+		for (int i = 0; i < cpus; i++)
+			CPU_SET(i, &set);
+	}
+	if (sched_setaffinity(tid, sizeof(set), &set) != 0 && !threads.warned)
+		LOG_warn("thread %i: can't set affinity: %s\n", tid, strerror(errno));
+
+	int realtime = profile != THREAD_PROFILE_OFF && role == THREAD_AUDIO;
+	struct sched_param param = {.sched_priority = realtime ? THREAD_AUDIO_PRIORITY : 0};
+	int nice = 0;
+	if (sched_setscheduler(tid, realtime ? SCHED_FIFO : SCHED_OTHER, &param) != 0)
+	{
+		if (!threads.warned)
+			LOG_warn("thread %i: can't set %s: %s\n", tid, realtime ? "SCHED_FIFO" : "SCHED_OTHER", strerror(errno));
+		if (realtime)
+			nice = THREAD_AUDIO_NICE;
+	}
+	if (profile != THREAD_PROFILE_OFF && role == THREAD_HOUSEKEEPING)
+		nice = THREAD_HOUSEKEEPING_NICE;
+	if (setpriority(PRIO_PROCESS, tid, nice) != 0 && !threads.warned) // per thread on linux
+		LOG_warn("thread %i: can't set nice %i: %s\n", tid, nice, strerror(errno));
+}
+#else
+// macOS desktop builds, nothing to place
+static pid_t THREAD_id(void) { return 0; }
+static int THREAD_alive(pid_t tid) { return 1; }
+static void THREAD_place(pid_t tid, int role, int profile) {}
+#endif
+
+void THREAD_register(int role)
+{
+	pid_t tid = THREAD_id();
+	pthread_mutex_lock(&threads.lock);
+	// there's only one emulation and one audio thread, a new one (eg. after an audio reset) replaces the last
+	for (int i = 0; i < threads.count; i++)
+	{
+		if (threads.list[i].tid != tid && threads.list[i].role == role && role != THREAD_HOUSEKEEPING)
+			threads.list[i--] = threads.list[--threads.count];
+	}
+	int i;
+	for (i = 0; i < threads.count; i++)
+	{
+		if (threads.list[i].tid == tid)
+			break;
+	}
+	if (i < THREAD_MAX)
+	{
+		threads.list[i].tid = tid;
+		threads.list[i].role = role;
+		if (i == threads.count)
+			threads.count += 1;
+	}
+	THREAD_place(tid, role, threads.profile);
+	pthread_mutex_unlock(&threads.lock);
+}
+
+void THREAD_unregister(void)
+{
+	pid_t tid = THREAD_id();
+	pthread_mutex_lock(&threads.lock);
+	for (int i = 0; i < threads.count; i++)
+	{
+		if (threads.list[i].tid == tid)
+		{
+			threads.list[i] = threads.list[--threads.count];
+			break;
+		}
+	}
+	pthread_mutex_unlock(&threads.lock);
+}
+
+void THREAD_forget(int role)
+{
+	pthread_mutex_lock(&threads.lock);
+	for (int i = 0; i < threads.count; i++)
+	{
+		if (threads.list[i].role == role)
+			threads.list[i--] = threads.list[--threads.count];
+	}
+	pthread_mutex_unlock(&threads.lock);
+}
+
+void THREAD_setProfile(int profile)
+{
+	pthread_mutex_lock(&threads.lock);
+	if (profile != threads.profile)
+	{
+		LOG_info("thread profile %i -> %i (%i threads)\n", threads.profile, profile, threads.count);
+		threads.profile = profile;
+		for (int i = 0; i < threads.count; i++)
+		{
+			// one that exited without unregistering, its tid may belong to someone else by now
+			if (!THREAD_alive(threads.list[i].tid))
+			{
+				threads.list[i--] = threads.list[--threads.count];
+				continue;
+			}
+			THREAD_place(threads.list[i].tid, threads.list[i].role, profile);
+		}
+		threads.warned = 1; // once per process is enough to know it isn't permitted
+	}
+	pthread_mutex_unlock(&threads.lock);
+}
+
+///////////////////////////////
+
+// service thread
+// vibration and battery/network polling used to run on their own threads,
+// waking every 17ms and every few seconds whether or not there was anything
+// to do. they're tasks here instead. there are only ever a handful so the
+// next deadline is a scan of the table rather than a wheel, the thread
+// blocks in poll() until then (or forever) and scheduling pokes an eventfd
+// so an earlier deadline is picked up straight away. tasks can also watch an
+// fd and run whenever it's readable.
+
+#define SVC_MAX 16
+
+static struct
+{
+	pthread_mutex_t lock;
+	pthread_cond_t idle;
 	pthread_t pt;
-	int queued_strength;
-	int strength;
-} vib = {0};
-static void *VIB_thread(void *arg)
+	int started;
+	int wake_fd[2]; // the same eventfd twice on linux, a pipe elsewhere
+	int running; // task being run, -1 when none
+	struct
+	{
+		SVC_Task task;
+		void *data;
+		uint64_t due; // ms, 0 when not scheduled
+		int period; // ms, 0 for one-shot
+		int fd; // watched for input, -1 when not
+		int ready;
+	} list[SVC_MAX];
+} svc = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.idle = PTHREAD_COND_INITIALIZER,
+	.running = -1,
+};
+
+static uint64_t SVC_now(void)
 {
-#define DEFER_FRAMES 3
-	static int defer = 0;
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void SVC_wake(void)
+{
+	uint64_t one = 1;
+	if (write(svc.wake_fd[1], &one, sizeof(one)) < 0 && errno != EAGAIN)
+		LOG_error("service thread: wake failed: %s\n", strerror(errno));
+}
+
+static void *SVC_thread(void *arg)
+{
+	THREAD_register(THREAD_HOUSEKEEPING);
+	pthread_mutex_lock(&svc.lock);
 	while (1)
 	{
-		SDL_Delay(17);
-		if (vib.queued_strength != vib.strength)
+		uint64_t now = SVC_now();
+		int next = -1;
+		int ready = -1;
+		for (int i = 0; i < SVC_MAX; i++)
 		{
-			if (defer < DEFER_FRAMES && vib.queued_strength == 0)
-			{ // minimize vacillation between 0 and some number (which this motor doesn't like)
-				defer += 1;
-				continue;
+			if (svc.list[i].task && svc.list[i].ready)
+				ready = i;
+			if (svc.list[i].task && svc.list[i].due && (next < 0 || svc.list[i].due < svc.list[next].due))
+				next = i;
+		}
+
+		if (ready >= 0 || (next >= 0 && svc.list[next].due <= now))
+		{
+			int id = ready >= 0 ? ready : next;
+			SVC_Task task = svc.list[id].task;
+			void *data = svc.list[id].data;
+			if (ready >= 0)
+				svc.list[id].ready = 0;
+			else
+				svc.list[id].due = svc.list[id].period ? now + svc.list[id].period : 0;
+			svc.running = id;
+			pthread_mutex_unlock(&svc.lock);
+
+			task(data);
+
+			pthread_mutex_lock(&svc.lock);
+			svc.running = -1;
+			pthread_cond_broadcast(&svc.idle);
+			continue;
+		}
+
+		int timeout = next >= 0 ? (int)(svc.list[next].due - now) : -1;
+		struct pollfd pfds[SVC_MAX + 1] = {{.fd = svc.wake_fd[0], .events = POLLIN}};
+		int ids[SVC_MAX + 1];
+		int count = 1;
+		for (int i = 0; i < SVC_MAX; i++)
+		{
+			if (svc.list[i].task && svc.list[i].fd >= 0)
+			{
+				pfds[count].fd = svc.list[i].fd;
+				pfds[count].events = POLLIN;
+				ids[count++] = i;
 			}
-			vib.strength = vib.queued_strength;
-			defer = 0;
+		}
+		pthread_mutex_unlock(&svc.lock);
+
+		int polled = poll(pfds, count, timeout);
+		if (polled > 0 && pfds[0].revents)
+		{
+			uint64_t wakes;
+			while (read(svc.wake_fd[0], &wakes, sizeof(wakes)) > 0)
+				; // just draining, whatever changed is rescanned above
+		}
 
-			PLAT_setRumble(vib.strength);
+		pthread_mutex_lock(&svc.lock);
+		for (int i = 1; polled > 0 && i < count; i++)
+		{
+			// the task may have been removed (and its fd closed) while we were in poll()
+			int id = ids[i];
+			if ((pfds[i].revents & (POLLIN | POLLERR | POLLHUP)) && svc.list[id].fd == pfds[i].fd)
+				svc.list[id].ready = 1;
 		}
 	}
-	return 0;
+	return NULL;
+}
+
+static int SVC_start(void)
+{
+#ifdef __linux__
+	svc.wake_fd[0] = svc.wake_fd[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (svc.wake_fd[0] < 0)
+#else
+	if (pipe(svc.wake_fd) != 0 || fcntl(svc.wake_fd[0], F_SETFL, O_NONBLOCK) != 0 || fcntl(svc.wake_fd[1], F_SETFL, O_NONBLOCK) != 0)
+#endif
+	{
+		LOG_error("service thread: can't create wakeup fd: %s\n", strerror(errno));
+		return 0;
+	}
+	if (pthread_create(&svc.pt, NULL, &SVC_thread, NULL) != 0)
+	{
+		LOG_error("service thread: can't create thread\n");
+		return 0;
+	}
+	svc.started = 1;
+	return 1;
+}
+
+int SVC_add(SVC_Task task, void *data)
+{
+	int id = -1;
+	pthread_mutex_lock(&svc.lock);
+	if (svc.started || SVC_start())
+	{
+		for (int i = 0; i < SVC_MAX; i++)
+		{
+			if (!svc.list[i].task)
+			{
+				svc.list[i].task = task;
+				svc.list[i].data = data;
+				svc.list[i].due = 0;
+				svc.list[i].period = 0;
+				svc.list[i].fd = -1;
+				svc.list[i].ready = 0;
+				id = i;
+				break;
+			}
+		}
+		if (id < 0)
+			LOG_error("service thread: no free task slots\n");
+	}
+	pthread_mutex_unlock(&svc.lock);
+	return id;
+}
+
+void SVC_schedule(int id, int delay_ms, int period_ms)
+{
+	if (id < 0)
+		return;
+	pthread_mutex_lock(&svc.lock);
+	svc.list[id].due = SVC_now() + delay_ms;
+	svc.list[id].period = period_ms;
+	pthread_mutex_unlock(&svc.lock);
+	SVC_wake();
+}
+
+int SVC_watch(int fd, SVC_Task task, void *data)
+{
+	int id = SVC_add(task, data);
+	if (id < 0)
+		return id;
+	pthread_mutex_lock(&svc.lock);
+	svc.list[id].fd = fd;
+	pthread_mutex_unlock(&svc.lock);
+	SVC_wake();
+	return id;
+}
+
+void SVC_cancel(int id)
+{
+	if (id < 0)
+		return;
+	pthread_mutex_lock(&svc.lock);
+	svc.list[id].due = 0;
+	svc.list[id].ready = 0;
+	// a task cancelling itself can't wait for itself to finish
+	while (svc.running == id && !pthread_equal(pthread_self(), svc.pt))
+		pthread_cond_wait(&svc.idle, &svc.lock);
+	pthread_mutex_unlock(&svc.lock);
+}
+
+void SVC_remove(int id)
+{
+	if (id < 0)
+		return;
+	SVC_cancel(id);
+	pthread_mutex_lock(&svc.lock);
+	svc.list[id].task = NULL;
+	svc.list[id].data = NULL;
+	svc.list[id].fd = -1;
+	pthread_mutex_unlock(&svc.lock);
+	SVC_wake(); // stop polling its fd
+}
+
+///////////////////////////////
+static struct VIB_Context
+{
+	int initialized;
+	int task;
+	int queued_strength;
+	int strength;
+} vib = {0};
+#define VIB_DEFER_MS 51 // minimize vacillation between 0 and some number (which this motor doesn't like)
+static void VIB_apply(void *arg)
+{
+	if (vib.queued_strength != vib.strength)
+	{
+		vib.strength = vib.queued_strength;
+		PLAT_setRumble(vib.strength);
+	}
 }
 void VIB_init(void)
 {
 	vib.queued_strength = vib.strength = 0;
-	pthread_create(&vib.pt, NULL, &VIB_thread, NULL);
+	vib.task = SVC_add(VIB_apply, NULL);
 	vib.initialized = 1;
 }
 void VIB_quit(void)
@@ -3350,15 +4416,23 @@ void VIB_quit(void)
 	if (!vib.initialized)
 		return;
 
-	VIB_setStrength(0);
-	pthread_cancel(vib.pt);
-	pthread_join(vib.pt, NULL);
+	SVC_remove(vib.task);
+	vib.initialized = 0;
+	vib.queued_strength = 0;
+	if (vib.strength)
+	{
+		vib.strength = 0;
+		PLAT_setRumble(0);
+	}
 }
 void VIB_setStrength(int strength)
 {
 	if (vib.queued_strength == strength)
 		return;
 	vib.queued_strength = strength;
+	// stopping waits a few frames in case it starts right back up, anything else applies now
+	if (vib.initialized)
+		SVC_schedule(vib.task, strength == 0 ? VIB_DEFER_MS : 0, 0);
 }
 int VIB_getStrength(void)
 {
@@ -3449,21 +4523,19 @@ static void PWR_updateNetworkStatus(void)
 
 void PWR_updateFrequency(int secs, int updateWifi)
 {
-	if (secs > 0)
+	if (secs > 0 && secs != pwr.update_secs)
+	{
 		pwr.update_secs = secs;
+		if (pwr.initialized)
+			SVC_schedule(pwr.task, secs * 1000, secs * 1000);
+	}
 	pwr.poll_network_status = updateWifi;
 }
 
-static void *PWR_monitorBattery(void *arg)
+static void PWR_monitorBattery(void *arg)
 {
-	while (1)
-	{
-		struct PWR_Context *pwr_ctx = (struct PWR_Context *)arg;
-		sleep(pwr_ctx->update_secs);
-		PWR_updateBatteryStatus();
-		PWR_updateNetworkStatus();
-	}
-	return NULL;
+	PWR_updateBatteryStatus();
+	PWR_updateNetworkStatus();
 }
 
 void PWR_init(void)
@@ -3489,7 +4561,8 @@ void PWR_init(void)
 	PWR_initOverlay();
 	PWR_updateBatteryStatus();
 
-	pthread_create(&pwr.battery_pt, NULL, &PWR_monitorBattery, &pwr);
+	pwr.task = SVC_add(PWR_monitorBattery, NULL);
+	SVC_schedule(pwr.task, pwr.update_secs * 1000, pwr.update_secs * 1000);
 	pwr.initialized = 1;
 }
 void PWR_quit(void)
@@ -3497,11 +4570,11 @@ void PWR_quit(void)
 	if (!pwr.initialized)
 		return;
 
-	PLAT_quitOverlay();
+	// stop polling before the overlay it updates goes away
+	SVC_remove(pwr.task);
+	pwr.initialized = 0;
 
-	// cancel battery thread
-	pthread_cancel(pwr.battery_pt);
-	pthread_join(pwr.battery_pt, NULL);
+	PLAT_quitOverlay();
 }
 void PWR_warn(int enable)
 {
@@ -3723,7 +4796,7 @@ void PWR_powerOff(int reboot)
 		GFX_flip(gfx.screen);
 
 		system("killall -STOP keymon.elf");
-		system("killall -STOP batmon.elf");
+		system("killall -TSTP batmon.elf");
 		system("killall -STOP wifi_daemon");
 		system("killall -STOP bt_daemon");
 
@@ -3752,7 +4825,7 @@ static void PWR_enterSleep(void)
 		PLAT_enableBacklight(0);
 	}
 	system("killall -STOP keymon.elf");
-	system("killall -STOP batmon.elf");
+	system("killall -TSTP batmon.elf");
 	system("killall -STOP wifi_daemon");
 	system("killall -STOP bt_daemon");
 
@@ -4099,6 +5172,9 @@ FALLBACK_IMPLEMENTATION void PLAT_wifiConnectPass(const char *ssid, WifiSecurity
 FALLBACK_IMPLEMENTATION void PLAT_wifiDisconnect() {}
 FALLBACK_IMPLEMENTATION bool PLAT_wifiDiagnosticsEnabled() { return false; }
 FALLBACK_IMPLEMENTATION void PLAT_wifiDiagnosticsEnable(bool on) {}
+FALLBACK_IMPLEMENTATION int PLAT_wifiScanResults(struct WIFI_network *networks, int max) { return PLAT_wifiScan(networks, max); }
+FALLBACK_IMPLEMENTATION bool PLAT_wifiWatchRegister(void (*cb)(int event)) { return false; }
+FALLBACK_IMPLEMENTATION void PLAT_wifiWatchUnregister(void) {}
 
 /////////////////////////////////////////////////////////////////////////////////////////
 
@@ -4126,4 +5202,6 @@ FALLBACK_IMPLEMENTATION void PLAT_bluetoothStreamQuit() {}
 FALLBACK_IMPLEMENTATION int PLAT_bluetoothVolume() { return 100; }
 FALLBACK_IMPLEMENTATION void PLAT_bluetoothSetVolume(int vol) {}
 FALLBACK_IMPLEMENTATION void PLAT_bluetoothWatchRegister(void (*cb)(bool, int)) {}
-FALLBACK_IMPLEMENTATION void PLAT_bluetoothWatchUnregister(void) {}
\ No newline at end of file
+FALLBACK_IMPLEMENTATION void PLAT_bluetoothWatchUnregister(void) {}
+FALLBACK_IMPLEMENTATION void PLAT_bluetoothEventsRegister(void (*cb)(int event)) {}
+FALLBACK_IMPLEMENTATION void PLAT_bluetoothEventsUnregister(void) {}
\ No newline at end of file
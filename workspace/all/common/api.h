@@ -267,6 +267,17 @@ SDL_Surface* GFX_init(int mode);
 #define GFX_scrollTextTexture PLAT_scrollTextTexture
 #define GFX_flipHidden PLAT_flipHidden //(void)
 #define GFX_GL_screenCapture PLAT_GL_screenCapture //(void)
+#define GFX_GL_repeatFrame PLAT_GL_repeatFrame //(void)
+#define GFX_GL_enableTiming PLAT_GL_enableTiming //(int enabled)
+#define GFX_GL_getTimings PLAT_GL_getTimings //(GPUTimings* out)
+#define GFX_GL_screenCaptureAsync PLAT_GL_screenCaptureAsync //(void)
+#define GFX_GL_screenCapturePoll PLAT_GL_screenCapturePoll //(int* outWidth, int* outHeight, int wait)
+#define GFX_GL_supportsHWRender PLAT_GL_supportsHWRender //(int gles, int major, int minor)
+#define GFX_GL_initHWRender PLAT_GL_initHWRender //(int width, int height, int depth, int stencil, int bottom_left)
+#define GFX_GL_quitHWRender PLAT_GL_quitHWRender //(void)
+#define GFX_GL_getHWFramebuffer PLAT_GL_getHWFramebuffer //(void)
+#define GFX_GL_getProcAddress PLAT_GL_getProcAddress //(const char* sym)
+#define GFX_GL_presentHWFrame PLAT_GL_presentHWFrame //(void)
 
 #define GFX_present PLAT_present //(SDL_Surface *inputSurface,int x, int y)
 void GFX_setMode(int mode);
@@ -277,6 +288,7 @@ SDL_Color /*GFX_*/ uintToColour(uint32_t colour);
 #define GFX_clearAll PLAT_clearAll // (void)
 
 void GFX_startFrame(void);
+uint64_t GFX_frameWaited(void); // us spent pacing or blocked on the swap since GFX_startFrame()
 void audioFPS(void);
 void GFX_flip(SDL_Surface* screen);
 void PLAT_flipHidden();
@@ -310,8 +322,10 @@ int GFX_wrapText(TTF_Font* font, char* str, int max_width, int max_lines);
 #define GFX_clearShaders PLAT_clearShaders	// void:(GFX_Renderer* renderer)
 #define GFX_updateShader PLAT_updateShader	// void:(GFX_Renderer* renderer)
 #define GFX_initShaders PLAT_initShaders	// void:(GFX_Renderer* renderer)
+#define GFX_precompileShaders PLAT_precompileShaders	// void:(void)
 
 scaler_t GFX_getAAScaler(GFX_Renderer* renderer);
+scaler_t GFX_getAAScaler32(GFX_Renderer* renderer); // RGBA8888, NEON/SSE2 where available
 void GFX_freeAAScaler(void);
 
 // calls the appropriate scale function based on the enum value.
@@ -354,6 +368,13 @@ void GFX_ApplyRoundedCorners16(SDL_Surface* surface, SDL_Rect* rect, int radius)
 void GFX_ApplyRoundedCorners_RGBA4444(SDL_Surface* surface, SDL_Rect* rect, int radius);
 void GFX_ApplyRoundedCorners_RGBA8888(SDL_Surface* surface, SDL_Rect* rect, int radius);
 void BlitRGBA4444toRGB565(SDL_Surface* src, SDL_Surface* dest, SDL_Rect* dest_rect);
+
+// encodes and writes a save-state/switcher preview on a background thread.
+// takes ownership of surface and, for surfaces created from existing memory, pixels (may be NULL)
+void GFX_savePreview(SDL_Surface* surface, void* pixels, const char* path);
+void GFX_waitPreview(void); // blocks until the pending preview (if any) is written
+SDL_Surface* GFX_loadPreview(const char* path); // returns an RGBA8888 surface or NULL, reads current and legacy png previews
+SDL_Surface* GFX_loadImage(const char* path, Uint32 format); // decodes qoi or anything SDL_image reads, converted to format
 ///////////////////////////////
 
 typedef struct SND_Frame {
@@ -426,6 +447,36 @@ int PAD_justRepeated(int btn);
 int PAD_tappedMenu(uint32_t now); // special case, returns 1 on release of BTN_MENU within 250ms if BTN_PLUS/BTN_MINUS haven't been pressed
 int PAD_tappedSelect(uint32_t now); // special case, returns 1 on release of BTN_SELECT within 250ms if BTN_PLUS/BTN_MINUS haven't been pressed
 
+///////////////////////////////
+
+// threads register the role they play and the current profile places them,
+// minarch sets the profile per core (minarch_thread_profile)
+enum {
+	THREAD_PROFILE_OFF, // everything floats under the default scheduler
+	THREAD_PROFILE_PRIORITY, // realtime audio, low priority housekeeping
+	THREAD_PROFILE_PINNED, // priority plus emulation, audio and housekeeping on their own cores
+};
+enum {
+	THREAD_EMULATION,
+	THREAD_AUDIO,
+	THREAD_HOUSEKEEPING,
+};
+void THREAD_register(int role); // the calling thread, until it exits or unregisters
+void THREAD_unregister(void); // the calling thread
+void THREAD_forget(int role); // threads we don't own that have gone away (eg. SDL's audio thread on close)
+void THREAD_setProfile(int profile); // (re)places every registered thread
+
+///////////////////////////////
+
+// a single housekeeping thread runs every registered task when it's due and
+// sleeps indefinitely when nothing is, tasks run one at a time so keep them short
+typedef void (*SVC_Task)(void *data);
+int SVC_add(SVC_Task task, void *data); // returns an id (or -1), not scheduled until SVC_schedule
+void SVC_schedule(int id, int delay_ms, int period_ms); // period 0 runs once, replaces any pending run
+int SVC_watch(int fd, SVC_Task task, void *data); // runs task whenever fd is readable, SVC_remove before closing it
+void SVC_cancel(int id); // drops the pending run and waits out a current one
+void SVC_remove(int id);
+
 ///////////////////////////////
 #define VIB_sleepStrength 4
 #define VIB_sleepDuration_ms 100
@@ -488,12 +539,13 @@ enum {
 };
 #define CPU_SWITCH_DELAY_MS 500
 #define PWR_setCPUSpeed PLAT_setCPUSpeed
+#define PWR_cpuFrame PLAT_cpuFrame //(int busy, int budget)
+#define PWR_cpuBoost PLAT_cpuBoost //(int frames)
 
 ///////////////////////////////
 
 FILE *PLAT_OpenSettings(const char *filename);
 FILE *PLAT_WriteSettings(const char *filename);
-char* PLAT_findFileInDir(const char *directory, const char *filename);
 void PLAT_initInput(void);
 void PLAT_updateInput(const SDL_Event *event);
 void PLAT_quitInput(void);
@@ -592,8 +644,32 @@ scaler_t PLAT_getScaler(GFX_Renderer* renderer);
 void PLAT_blitRenderer(GFX_Renderer* renderer);
 void PLAT_flip(SDL_Surface* screen, int sync);
 void PLAT_GL_Swap();
+void PLAT_GL_repeatFrame(void); // next swap presents the last uploaded frame again
+int PLAT_GL_supportsHWRender(int gles, int major, int minor); // whether a core asking for this api/version can render on our context
+int PLAT_GL_initHWRender(int width, int height, int depth, int stencil, int bottom_left); // sizes the fbo gl cores render into, 0 on failure
+void PLAT_GL_quitHWRender(void);
+uintptr_t PLAT_GL_getHWFramebuffer(void);
+void* PLAT_GL_getProcAddress(const char* sym);
+void PLAT_GL_presentHWFrame(void); // next swap takes its source from the hw render fbo instead of vid.blit->src
+
+// moving averages in ms, filled while timing is enabled
+typedef struct GPUTimings {
+	int valid;
+	int timer_query; // measured on the gpu, otherwise fenced cpu time
+	int passes;
+	float upload;
+	float pass[MAXSHADERS];
+	float present; // the final pass to the screen
+	float effect;
+	float overlay;
+	float swap; // cpu time in SDL_GL_SwapWindow, includes waiting for vsync
+} GPUTimings;
+void PLAT_GL_enableTiming(int enabled);
+void PLAT_GL_getTimings(GPUTimings* out);
 void GFX_GL_Swap();
 unsigned char* PLAT_GL_screenCapture(int* outWidth, int* outHeight);
+int PLAT_GL_screenCaptureAsync(void); // starts a non-blocking readback of the current frame, 0 if it couldn't
+unsigned char* PLAT_GL_screenCapturePoll(int* outWidth, int* outHeight, int wait); // NULL until the readback has landed
 unsigned char* PLAT_pixelscaler(const unsigned char* src, int sw, int sh, int scale, int* outW, int* outH);
 void PLAT_GPU_Flip();
 void PLAT_setShaders(int nr);
@@ -610,6 +686,7 @@ void PLAT_setShader2(const char* filename);
 void PLAT_setShader3(const char* filename);
 void PLAT_updateShader(int i, const char *filename, int *scale, int *filter, int *scaletype, int *inputtype);
 void PLAT_initShaders();
+void PLAT_precompileShaders(void); // fills the shader program cache in the background
 ShaderParam* PLAT_getShaderPragmas(int i);
 int PLAT_supportsOverscan(void);
 
@@ -625,7 +702,8 @@ int PLAT_supportsDeepSleep(void);
 int PLAT_deepSleep(void);
 void PLAT_powerOff(int reboot);
 
-void *PLAT_cpu_monitor(void *arg);
+void PLAT_cpuFrame(int busy, int budget); // us the frame kept the cpu busy, us it had
+void PLAT_cpuBoost(int frames); // top clock now and for the next frames, ahead of known heavy work
 void PLAT_setCPUSpeed(int speed); // enum
 void PLAT_setCustomCPUSpeed(int speed);
 void PLAT_setRumble(int strength);
@@ -741,6 +819,17 @@ void PLAT_wifiDisconnect();
 bool PLAT_wifiDiagnosticsEnabled();
 // returns true if diagnostic logging is enabled
 void PLAT_wifiDiagnosticsEnable(bool on);
+// returns the results of the last scan, without starting a new one
+int PLAT_wifiScanResults(struct WIFI_network *networks, int max);
+// watch for new scan results and connection changes (on the service thread),
+// returns false if the supplicant can't be reached
+typedef enum {
+	WIFI_EVENT_SCAN_RESULTS = 0,
+	WIFI_EVENT_CONNECTED,
+	WIFI_EVENT_DISCONNECTED,
+} WifiEvent;
+bool PLAT_wifiWatchRegister(void (*cb)(int event));
+void PLAT_wifiWatchUnregister(void);
 
 #define WIFI_init PLAT_wifiInit
 #define WIFI_supported PLAT_hasWifi
@@ -756,6 +845,9 @@ void PLAT_wifiDiagnosticsEnable(bool on);
 #define WIFI_disconnect PLAT_wifiDisconnect
 #define WIFI_diagnosticsEnabled PLAT_wifiDiagnosticsEnabled
 #define WIFI_diagnosticsEnable PLAT_wifiDiagnosticsEnable
+#define WIFI_scanResults PLAT_wifiScanResults
+#define WIFI_registerEventWatcher PLAT_wifiWatchRegister
+#define WIFI_removeEventWatcher PLAT_wifiWatchUnregister
 
 ////////////////////////
 typedef enum {
@@ -837,6 +929,14 @@ typedef enum {
 } WatchEvent;
 void PLAT_bluetoothWatchRegister(void (*cb)(bool, int));
 void PLAT_bluetoothWatchUnregister(void);
+// watch for discovered devices and connection changes (on btmanager's thread),
+// only while btmanager is running in this process
+typedef enum {
+	BT_EVENT_DEVICES = 0, // discovered or lost
+	BT_EVENT_CONNECTION, // connected, disconnected, paired or unpaired
+} BluetoothEvent;
+void PLAT_bluetoothEventsRegister(void (*cb)(int event));
+void PLAT_bluetoothEventsUnregister(void);
 
 #define BT_init PLAT_bluetoothInit
 #define BT_quit PLAT_bluetoothDeinit
@@ -858,5 +958,7 @@ void PLAT_bluetoothWatchUnregister(void);
 #define BT_setVolume PLAT_bluetoothSetVolume
 #define BT_registerDeviceWatcher PLAT_bluetoothWatchRegister
 #define BT_removeDeviceWatcher PLAT_bluetoothWatchUnregister
+#define BT_registerEventWatcher PLAT_bluetoothEventsRegister
+#define BT_removeEventWatcher PLAT_bluetoothEventsUnregister
 
 #endif
@@ -3,6 +3,7 @@
 #include <string.h>
 
 #include "platform.h" // for HAS_NEON
+#include "scaler.h"
 
 //
 //	arm NEON / C integer scalers for ARMv7 devices
@@ -2891,6 +2892,217 @@ void scaler_c32(uint32_t xmul, uint32_t ymul, void* __restrict src, void* __rest
 	return;
 }
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+//
+//	SSE2 / AVX2 scalers for the desktop build
+//	each source row is widened xmul times by a row kernel and the result
+//	copied down for ymul. 2x and 4x are plain unpacks, the other factors
+//	store each pixel splatted across a whole register at its destination and
+//	let the next store overwrite the excess, the row tail is done in C so
+//	nothing is ever written past the end of the row.
+//
+
+typedef void (*row_x86_t)(void* __restrict dst, const void* __restrict src, uint32_t sw, uint32_t xmul);
+
+static void row16_tail(uint16_t* __restrict d, const uint16_t* __restrict s, uint32_t x, uint32_t sw, uint32_t xmul) {
+	for (d+=x*xmul; x<sw; x++) {
+		for (uint32_t i=xmul; i>0; i--) *d++ = s[x];
+	}
+}
+static void row32_tail(uint32_t* __restrict d, const uint32_t* __restrict s, uint32_t x, uint32_t sw, uint32_t xmul) {
+	for (d+=x*xmul; x<sw; x++) {
+		for (uint32_t i=xmul; i>0; i--) *d++ = s[x];
+	}
+}
+
+__attribute__((target("sse2")))
+static void row16_sse2(void* __restrict dst, const void* __restrict src, uint32_t sw, uint32_t xmul) {
+	uint16_t* d = (uint16_t*)dst;
+	const uint16_t* s = (const uint16_t*)src;
+	uint32_t x = 0;
+	if (xmul==2) {
+		for (; x+8<=sw; x+=8) {
+			__m128i v = _mm_loadu_si128((const __m128i*)(s+x));
+			_mm_storeu_si128((__m128i*)(d+x*2  ), _mm_unpacklo_epi16(v, v));
+			_mm_storeu_si128((__m128i*)(d+x*2+8), _mm_unpackhi_epi16(v, v));
+		}
+	}
+	else if (xmul==4) {
+		for (; x+8<=sw; x+=8) {
+			__m128i v = _mm_loadu_si128((const __m128i*)(s+x));
+			__m128i lo = _mm_unpacklo_epi16(v, v);
+			__m128i hi = _mm_unpackhi_epi16(v, v);
+			_mm_storeu_si128((__m128i*)(d+x*4   ), _mm_unpacklo_epi32(lo, lo));
+			_mm_storeu_si128((__m128i*)(d+x*4+ 8), _mm_unpackhi_epi32(lo, lo));
+			_mm_storeu_si128((__m128i*)(d+x*4+16), _mm_unpacklo_epi32(hi, hi));
+			_mm_storeu_si128((__m128i*)(d+x*4+24), _mm_unpackhi_epi32(hi, hi));
+		}
+	}
+	else if (xmul<=8) {
+		for (; x*xmul+8<=sw*xmul; x++) {
+			_mm_storeu_si128((__m128i*)(d+x*xmul), _mm_set1_epi16(s[x]));
+		}
+	}
+	row16_tail(d, s, x, sw, xmul);
+}
+
+__attribute__((target("sse2")))
+static void row32_sse2(void* __restrict dst, const void* __restrict src, uint32_t sw, uint32_t xmul) {
+	uint32_t* d = (uint32_t*)dst;
+	const uint32_t* s = (const uint32_t*)src;
+	uint32_t x = 0;
+	if (xmul==2) {
+		for (; x+4<=sw; x+=4) {
+			__m128i v = _mm_loadu_si128((const __m128i*)(s+x));
+			_mm_storeu_si128((__m128i*)(d+x*2  ), _mm_unpacklo_epi32(v, v));
+			_mm_storeu_si128((__m128i*)(d+x*2+4), _mm_unpackhi_epi32(v, v));
+		}
+	}
+	else if (xmul==4) {
+		for (; x+4<=sw; x+=4) {
+			__m128i v = _mm_loadu_si128((const __m128i*)(s+x));
+			__m128i lo = _mm_unpacklo_epi32(v, v);
+			__m128i hi = _mm_unpackhi_epi32(v, v);
+			_mm_storeu_si128((__m128i*)(d+x*4   ), _mm_unpacklo_epi64(lo, lo));
+			_mm_storeu_si128((__m128i*)(d+x*4+ 4), _mm_unpackhi_epi64(lo, lo));
+			_mm_storeu_si128((__m128i*)(d+x*4+ 8), _mm_unpacklo_epi64(hi, hi));
+			_mm_storeu_si128((__m128i*)(d+x*4+12), _mm_unpackhi_epi64(hi, hi));
+		}
+	}
+	else if (xmul<=4) {
+		for (; x*xmul+4<=sw*xmul; x++) {
+			_mm_storeu_si128((__m128i*)(d+x*xmul), _mm_set1_epi32(s[x]));
+		}
+	}
+	else if (xmul<=8) {
+		for (; x*xmul+xmul<=sw*xmul; x++) {
+			__m128i v = _mm_set1_epi32(s[x]);
+			_mm_storeu_si128((__m128i*)(d+x*xmul), v);
+			_mm_storeu_si128((__m128i*)(d+x*xmul+xmul-4), v);
+		}
+	}
+	row32_tail(d, s, x, sw, xmul);
+}
+
+__attribute__((target("avx2")))
+static void row16_avx2(void* __restrict dst, const void* __restrict src, uint32_t sw, uint32_t xmul) {
+	uint16_t* d = (uint16_t*)dst;
+	const uint16_t* s = (const uint16_t*)src;
+	uint32_t x = 0;
+	if (xmul==2) {
+		for (; x+16<=sw; x+=16) {
+			__m256i v = _mm256_loadu_si256((const __m256i*)(s+x));
+			__m256i lo = _mm256_unpacklo_epi16(v, v); // 0-3 | 8-11
+			__m256i hi = _mm256_unpackhi_epi16(v, v); // 4-7 | 12-15
+			_mm256_storeu_si256((__m256i*)(d+x*2   ), _mm256_permute2x128_si256(lo, hi, 0x20));
+			_mm256_storeu_si256((__m256i*)(d+x*2+16), _mm256_permute2x128_si256(lo, hi, 0x31));
+		}
+	}
+	else if (xmul==4) {
+		const __m256i idx = _mm256_setr_epi32(0,0,1,1,2,2,3,3);
+		for (; x+8<=sw; x+=8) {
+			__m128i v = _mm_loadu_si128((const __m128i*)(s+x));
+			__m256i lo = _mm256_castsi128_si256(_mm_unpacklo_epi16(v, v));
+			__m256i hi = _mm256_castsi128_si256(_mm_unpackhi_epi16(v, v));
+			_mm256_storeu_si256((__m256i*)(d+x*4   ), _mm256_permutevar8x32_epi32(lo, idx));
+			_mm256_storeu_si256((__m256i*)(d+x*4+16), _mm256_permutevar8x32_epi32(hi, idx));
+		}
+	}
+	else if (xmul<=16) {
+		for (; x*xmul+16<=sw*xmul; x++) {
+			_mm256_storeu_si256((__m256i*)(d+x*xmul), _mm256_set1_epi16(s[x]));
+		}
+	}
+	row16_tail(d, s, x, sw, xmul);
+}
+
+__attribute__((target("avx2")))
+static void row32_avx2(void* __restrict dst, const void* __restrict src, uint32_t sw, uint32_t xmul) {
+	uint32_t* d = (uint32_t*)dst;
+	const uint32_t* s = (const uint32_t*)src;
+	uint32_t x = 0;
+	if (xmul>=2 && xmul<=8) {
+		// destination vector k of every 8 source pixels takes pixel (8k+j)/xmul in lane j
+		__m256i idx[8];
+		for (uint32_t k=0; k<xmul; k++) {
+			uint32_t o = 8*k;
+			idx[k] = _mm256_setr_epi32(o/xmul, (o+1)/xmul, (o+2)/xmul, (o+3)/xmul, (o+4)/xmul, (o+5)/xmul, (o+6)/xmul, (o+7)/xmul);
+		}
+		for (; x+8<=sw; x+=8) {
+			__m256i v = _mm256_loadu_si256((const __m256i*)(s+x));
+			uint32_t* o = d+x*xmul;
+			for (uint32_t k=0; k<xmul; k++, o+=8) _mm256_storeu_si256((__m256i*)o, _mm256_permutevar8x32_epi32(v, idx[k]));
+		}
+	}
+	row32_tail(d, s, x, sw, xmul);
+}
+
+static row_x86_t row16_x86 = NULL;
+static row_x86_t row32_x86 = NULL;
+static int level_x86 = -1;
+
+void scaler_x86_force(int level) {
+	__builtin_cpu_init();
+	if (level>=SCALER_X86_AVX2 && !__builtin_cpu_supports("avx2")) level = SCALER_X86_SSE2;
+	if (level>=SCALER_X86_SSE2 && !__builtin_cpu_supports("sse2")) level = SCALER_X86_C;
+
+	if (level>=SCALER_X86_AVX2) {
+		row16_x86 = row16_avx2;
+		row32_x86 = row32_avx2;
+	}
+	else if (level==SCALER_X86_SSE2) {
+		row16_x86 = row16_sse2;
+		row32_x86 = row32_sse2;
+	}
+	else {
+		row16_x86 = NULL;
+		row32_x86 = NULL;
+	}
+	level_x86 = level;
+}
+int scaler_x86_level(void) {
+	if (level_x86<0) scaler_x86_force(SCALER_X86_AVX2);
+	return level_x86;
+}
+
+static void scale_x86(row_x86_t row, uint32_t bpp, uint32_t xmul, uint32_t ymul, void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dw, uint32_t dh, uint32_t dp) {
+	if (!sw||!sh||!xmul||!ymul) return;
+	uint32_t swl = sw*bpp;
+	uint32_t dwl = swl*xmul;
+	if (!sp) { sp = swl; } if (!dp) { dp = dwl; }
+	for (; sh>0; sh--, src=(uint8_t*)src+sp) {
+		if (xmul==1) memcpy(dst, src, swl);
+		else row(dst, src, sw, xmul);
+		void* __restrict dstsrc = dst; dst = (uint8_t*)dst+dp;
+		for (uint32_t i=ymul-1; i>0; i--, dst=(uint8_t*)dst+dp) memcpy(dst, dstsrc, dwl);
+	}
+}
+
+void scaler_x16(uint32_t xmul, uint32_t ymul, void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dw, uint32_t dh, uint32_t dp) {
+	if (scaler_x86_level()==SCALER_X86_C) scaler_c16(xmul, ymul, src, dst, sw, sh, sp, dw, dh, dp);
+	else if (xmul>=1 && xmul<=6 && ymul>=1 && ymul<=6) scale_x86(row16_x86, sizeof(uint16_t), xmul, ymul, src, dst, sw, sh, sp, dw, dh, dp);
+}
+void scaler_x32(uint32_t xmul, uint32_t ymul, void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dw, uint32_t dh, uint32_t dp) {
+	if (scaler_x86_level()==SCALER_X86_C) scaler_c32(xmul, ymul, src, dst, sw, sh, sp, dw, dh, dp);
+	else if (xmul>=1 && xmul<=6 && ymul>=1 && ymul<=6) scale_x86(row32_x86, sizeof(uint32_t), xmul, ymul, src, dst, sw, sh, sp, dw, dh, dp);
+}
+
+#define SCALE_X86(n) \
+void scale##n##x##n##_x16(void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dw, uint32_t dh, uint32_t dp) { \
+	scaler_x16(n, n, src, dst, sw, sh, sp, dw, dh, dp); } \
+void scale##n##x##n##_x32(void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dw, uint32_t dh, uint32_t dp) { \
+	scaler_x32(n, n, src, dst, sw, sh, sp, dw, dh, dp); }
+SCALE_X86(1)
+SCALE_X86(2)
+SCALE_X86(3)
+SCALE_X86(4)
+SCALE_X86(5)
+SCALE_X86(6)
+#undef SCALE_X86
+
+#endif
 
 // from gambatte-dms
 //from RGB565
@@ -486,6 +486,12 @@ uint64_t getMicroseconds(void) {
 
     return ret;
 }
+uint64_t getCPUMicroseconds(clockid_t clock) {
+	// cpu time used, CLOCK_THREAD_CPUTIME_ID or CLOCK_PROCESS_CPUTIME_ID
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
 
 #define max(a,b)             \
 ({                           \
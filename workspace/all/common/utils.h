@@ -4,6 +4,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <time.h>
 
 int prefixMatch(char* pre, const char* str);
 int suffixMatch(char* suf,const char* str);
@@ -43,6 +44,7 @@ void putInt(char* path, int value);
 int getInt(char* path);
 
 uint64_t getMicroseconds(void);
+uint64_t getCPUMicroseconds(clockid_t clock);
 
 int clamp(int x, int lower, int upper);
 double clampd(double x, double lower, double upper);
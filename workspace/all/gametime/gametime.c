@@ -48,6 +48,7 @@ static void sigHandler(int sig)
 
 static SDL_Surface *screen;
 static SDL_Surface **romImages;
+static bool *romImagesLoaded;
 
 static PlayActivities *play_activities;
 
@@ -157,7 +158,7 @@ void renderRoundedRectangle(SDL_Rect rect, Uint32 color, int radius) {
 
 SDL_Surface *loadRomImage(char *image_path)
 {
-    if(!exists(image_path))
+    if(!image_path || !exists(image_path))
         return NULL;
 
     SDL_Surface *img = IMG_Load(image_path);
@@ -179,14 +180,37 @@ SDL_Surface *loadRomImage(char *image_path)
     return dst;
 }
 
-void preloadRomImages()
+// rom art is only decoded for the rows that are about to be drawn and
+// dropped again once it has scrolled well out of view. opening the
+// tracker no longer waits on decoding every image, and memory stays
+// flat no matter how many roms have been played.
+#define ROM_IMAGE_KEEP_PAGES 1 // pages kept decoded above and below the visible one
+
+void initRomImages()
+{
+    romImages = calloc(play_activities->count, sizeof(SDL_Surface *));
+    romImagesLoaded = calloc(play_activities->count, sizeof(bool));
+}
+
+SDL_Surface *getRomImage(int index)
+{
+    if (!romImagesLoaded[index]) {
+        ROM *rom = play_activities->play_activity[index]->rom;
+        romImages[index] = loadRomImage(rom->image_path);
+        romImagesLoaded[index] = true;
+    }
+    return romImages[index];
+}
+
+void trimRomImages(int start, int end)
 {
-    // load all rom images into SDL_Surfaces
-    romImages = malloc(sizeof(SDL_Surface *) * play_activities->count);
+    int keep = layout.items_per_page * ROM_IMAGE_KEEP_PAGES;
     for (int i = 0; i < play_activities->count; i++) {
-        PlayActivity *entry = play_activities->play_activity[i];
-        ROM *rom = entry->rom;
-        romImages[i] = loadRomImage(rom->image_path);
+        if (romImagesLoaded[i] && (i < start - keep || i >= end + keep)) {
+            SDL_FreeSurface(romImages[i]);
+            romImages[i] = NULL;
+            romImagesLoaded[i] = false;
+        }
     }
 }
 
@@ -196,6 +220,7 @@ void freeRomImages()
         SDL_FreeSurface(romImages[i]);
     }
     free(romImages);
+    free(romImagesLoaded);
 }
 
 void renderList(int count, int start, int end, int selected)
@@ -226,7 +251,7 @@ void renderList(int count, int start, int end, int selected)
             elemHeight
         }, isSelected ? RGB_WHITE : RGB_BLACK, SCALE1(24));
 
-        SDL_Surface *romImage = romImages[index];
+        SDL_Surface *romImage = getRomImage(index);
         if (romImage) {
             SDL_Rect rectRomImage = {
                 layout.list_display_start_x + num_width + thumbMargin / 2 + (SCALE1(IMG_MAX_WIDTH) - romImage->w) / 2, 
@@ -346,7 +371,7 @@ int main(int argc, char *argv[])
     LOG_debug("found %d roms\n", play_activities->count);
 
     initLayout();
-    preloadRomImages();
+    initRomImages();
     int count = play_activities->count;
     int selected = 0;
     int start = 0;
@@ -431,6 +456,7 @@ int main(int argc, char *argv[])
                 SDL_FreeSurface(text);
             }
 
+            trimRomImages(start, end);
             renderList(count, start, end, selected);
 
             if (show_setting)
@@ -12,6 +12,58 @@
 #define BATTERY_LOG_PATH SHARED_USERDATA_PATH
 #define BATTERY_LOG_FILE BATTERY_LOG_PATH "/battery_logs.sqlite"
 
+#define BATTERY_LOG_SCHEMA_VERSION 2
+
+// versions tracked in PRAGMA user_version, each step runs in the same
+// transaction that checks the version so concurrent openers apply it once
+static const char *battery_log_migrations[BATTERY_LOG_SCHEMA_VERSION] = {
+    // 1: retention by ring slot instead of counting and deleting the oldest
+    // row on every insert. ids stay chronological, a writer replaces the
+    // row in slot id % size. keep the newest rows, their ids are
+    // consecutive so their slots cant collide.
+    "ALTER TABLE bat_activity ADD COLUMN slot INTEGER;"
+    "DELETE FROM bat_activity WHERE id <= (SELECT MAX(id) FROM bat_activity) - %d;"
+    "UPDATE bat_activity SET slot = id %% %d;"
+    "CREATE UNIQUE INDEX bat_activity_slot_index ON bat_activity(slot);",
+    // 2: the battery app walks one device's rows newest first and stops
+    // once the graph is full, this lets it do that without sorting first
+    "CREATE INDEX IF NOT EXISTS bat_activity_device_id_index ON bat_activity(device_serial, id);",
+};
+
+static int battery_log_version(sqlite3 *bat_log_db)
+{
+    int version = 0;
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(bat_log_db, "PRAGMA user_version;", -1, &stmt, NULL) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+        version = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    return version;
+}
+
+static void migrate_battery_log_db(sqlite3 *bat_log_db)
+{
+    if (battery_log_version(bat_log_db) >= BATTERY_LOG_SCHEMA_VERSION)
+        return;
+    if (sqlite3_exec(bat_log_db, "BEGIN IMMEDIATE;", NULL, NULL, NULL) != SQLITE_OK)
+        return;
+
+    for (int version = battery_log_version(bat_log_db); version < BATTERY_LOG_SCHEMA_VERSION; version++) {
+        char *step = sqlite3_mprintf(battery_log_migrations[version], BATTERY_LOG_SIZE, BATTERY_LOG_SIZE);
+        char *sql = sqlite3_mprintf("%s PRAGMA user_version = %d;", step, version + 1);
+        char *err = NULL;
+        int rc = sqlite3_exec(bat_log_db, sql, NULL, NULL, &err);
+        sqlite3_free(sql);
+        sqlite3_free(step);
+        if (rc != SQLITE_OK) {
+            printf("battery log migration to %d failed: %s\n", version + 1, err);
+            sqlite3_free(err);
+            sqlite3_exec(bat_log_db, "ROLLBACK;", NULL, NULL, NULL);
+            return;
+        }
+    }
+    sqlite3_exec(bat_log_db, "COMMIT;", NULL, NULL, NULL);
+}
+
 sqlite3* open_battery_log_db(void)
 {
     mkdir(BATTERY_LOG_PATH, 0755);
@@ -27,6 +79,11 @@ sqlite3* open_battery_log_db(void)
         return NULL;
     }
 
+    // batmon writes while the battery app reads, WAL keeps them out of each
+    // others way and turns commits into appends
+    sqlite3_busy_timeout(bat_log_db, 2000);
+    sqlite3_exec(bat_log_db, "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL;", NULL, NULL, NULL);
+
     if (!db_exists) {
         sqlite3_exec(bat_log_db,
                      "DROP TABLE IF EXISTS bat_activity;"
@@ -39,6 +96,7 @@ sqlite3* open_battery_log_db(void)
                      "CREATE INDEX device_specifics_index ON device_specifics(device_serial);",
                      NULL, NULL, NULL);
     }
+    migrate_battery_log_db(bat_log_db);
 
     return bat_log_db;
 }
@@ -2,6 +2,9 @@
 #ifndef __batmon_db_h__
 #define __batmon_db_h__
 
+// bat_activity is a ring of this many rows, a row lives in slot id % BATTERY_LOG_SIZE
+#define BATTERY_LOG_SIZE 1000
+
 sqlite3* open_battery_log_db(void);
 void close_battery_log_db(sqlite3* ctx);
 int get_best_session_time(sqlite3* ctx, const char* device);
@@ -15,21 +15,151 @@
 #define GAMETIME_LOG_PATH SHARED_USERDATA_PATH
 #define GAMETIME_LOG_FILE GAMETIME_LOG_PATH "/game_logs.sqlite"
 
+///////////////////////////////
+// connection
+//
+// every process keeps a single connection open for its whole lifetime
+// instead of reopening the file per call. the db runs in WAL mode so a
+// commit is one append to the log rather than a journal rewrite and a
+// handful of fsyncs on the sd card, and gametime reading while
+// gametimectl writes no longer block each other. statements are
+// prepared once and reused, writes are grouped into one transaction
+// per public call.
+
+enum {
+    STMT_ROM_BY_PATH,
+    STMT_ORPHAN_ROM,
+    STMT_INSERT_ROM,
+    STMT_UPDATE_ROM,
+    STMT_ROM_PLAY_TIME,
+    STMT_OPEN_ACTIVITY,
+    STMT_START_ACTIVITY,
+    STMT_STOP_ACTIVITY,
+    STMT_STOP_ALL_ACTIVITIES,
+    STMT_PRUNE_ACTIVITIES,
+    STMT_TOTAL_PLAY_TIME,
+    STMT_FIND_ALL,
+    STMT_COUNT
+};
+
+static const char *statement_sql[STMT_COUNT] = {
+    [STMT_ROM_BY_PATH] = "SELECT id FROM rom WHERE file_path=?1 LIMIT 1;",
+    [STMT_ORPHAN_ROM] = "SELECT id FROM rom WHERE (name=?1 OR name=?2) AND type='ORPHAN' LIMIT 1;",
+    [STMT_INSERT_ROM] = "INSERT INTO rom(type, name, file_path, image_path) VALUES(?1, ?2, ?3, ?4);",
+    [STMT_UPDATE_ROM] = "UPDATE rom SET type = ?1, name = ?2, file_path = ?3, image_path = ?4 WHERE id = ?5;",
+    [STMT_ROM_PLAY_TIME] = "SELECT play_time_total FROM play_summary WHERE rom_id = ?1;",
+    [STMT_OPEN_ACTIVITY] = "SELECT 1 FROM play_activity WHERE rom_id = ?1 AND play_time IS NULL LIMIT 1;",
+    [STMT_START_ACTIVITY] = "INSERT INTO play_activity(rom_id) VALUES(?1);",
+    [STMT_STOP_ACTIVITY] =
+        "UPDATE play_activity SET play_time = (strftime('%s', 'now')) - created_at, updated_at = (strftime('%s', 'now')) "
+        "WHERE rom_id = ?1 AND play_time IS NULL;",
+    [STMT_STOP_ALL_ACTIVITIES] =
+        "UPDATE play_activity SET play_time = (strftime('%s', 'now')) - created_at, updated_at = (strftime('%s', 'now')) "
+        "WHERE play_time IS NULL;",
+    [STMT_PRUNE_ACTIVITIES] = "DELETE FROM play_activity WHERE play_time < 0;",
+    [STMT_TOTAL_PLAY_TIME] = "SELECT SUM(play_time_total) FROM play_summary WHERE play_time_total > 60;",
+    [STMT_FIND_ALL] =
+        "SELECT rom.id, rom.type, rom.name, rom.file_path, "
+        "       play_summary.play_count, "
+        "       play_summary.play_time_total, "
+        "       play_summary.play_time_total/play_summary.play_count AS play_time_average, "
+        "       datetime(play_summary.first_played_at, 'unixepoch') AS first_played_at, "
+        "       datetime(play_summary.last_played_at, 'unixepoch') AS last_played_at "
+        "FROM play_summary JOIN rom ON rom.id = play_summary.rom_id "
+        "WHERE play_summary.play_time_total > 0 "
+        "ORDER BY play_summary.play_time_total DESC;",
+};
+
+static sqlite3 *game_log_db = NULL;
+static sqlite3_stmt *statements[STMT_COUNT];
+
+///////////////////////////////
+// schema migrations
+//
+// tracked in PRAGMA user_version. each step runs in its own transaction
+// and is safe to repeat, so two processes racing an upgrade is harmless.
+
+#define GAMETIME_SCHEMA_VERSION 1
+
+static const char *schema_migrations[GAMETIME_SCHEMA_VERSION] = {
+    // 1: per-rom totals kept up to date as sessions close, so the tracker
+    // and play time lookups never aggregate the whole history. sessions
+    // are closed exactly once (play_time goes from NULL to a value), the
+    // trigger folds each one in as part of the statement closing it.
+    // negative play times are pruned right after, so they're skipped here.
+    "CREATE TABLE IF NOT EXISTS play_summary(rom_id INTEGER PRIMARY KEY, play_count INTEGER, play_time_total INTEGER, first_played_at INTEGER, last_played_at INTEGER);"
+    "CREATE INDEX IF NOT EXISTS play_summary_play_time_index ON play_summary(play_time_total);"
+    "DELETE FROM play_summary;"
+    "INSERT INTO play_summary "
+    "    SELECT rom_id, COUNT(*), SUM(play_time), MIN(created_at), MAX(created_at) "
+    "    FROM play_activity WHERE play_time >= 0 GROUP BY rom_id;"
+    "CREATE TRIGGER IF NOT EXISTS play_summary_on_stop AFTER UPDATE OF play_time ON play_activity "
+    "WHEN OLD.play_time IS NULL AND NEW.play_time >= 0 "
+    "BEGIN "
+    "    INSERT OR IGNORE INTO play_summary VALUES(NEW.rom_id, 0, 0, NEW.created_at, NEW.created_at); "
+    "    UPDATE play_summary SET "
+    "        play_count = play_count + 1, "
+    "        play_time_total = play_time_total + NEW.play_time, "
+    "        first_played_at = MIN(first_played_at, NEW.created_at), "
+    "        last_played_at = MAX(last_played_at, NEW.created_at) "
+    "    WHERE rom_id = NEW.rom_id; "
+    "END;",
+};
+
+static int __db_user_version(sqlite3 *db)
+{
+    int version = 0;
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, NULL) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+        version = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    return version;
+}
+
+static void __db_migrate(sqlite3 *db)
+{
+    for (int version = __db_user_version(db); version < GAMETIME_SCHEMA_VERSION; version++) {
+        char *sql = sqlite3_mprintf("BEGIN IMMEDIATE; %s PRAGMA user_version = %d; COMMIT;", schema_migrations[version], version + 1);
+        char *err = NULL;
+        if (sqlite3_exec(db, sql, NULL, NULL, &err) != SQLITE_OK) {
+            printf("schema migration to %d failed: %s\n", version + 1, err);
+            sqlite3_free(err);
+            sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+            sqlite3_free(sql);
+            return;
+        }
+        sqlite3_free(sql);
+    }
+}
+
+static void play_activity_db_shutdown(void)
+{
+    play_activity_db_close(game_log_db);
+}
+
 sqlite3* play_activity_db_open(void)
 {
+    if (game_log_db)
+        return game_log_db;
+
     mkdir(GAMETIME_LOG_PATH, 0777);
     bool db_exists = exists(GAMETIME_LOG_FILE);
     if (!db_exists)
         touch(GAMETIME_LOG_FILE);
 
-    sqlite3 *game_log_db = NULL;
-
     if (sqlite3_open(GAMETIME_LOG_FILE, &game_log_db) != SQLITE_OK) {
         printf("%s\n", sqlite3_errmsg(game_log_db));
-        play_activity_db_close(game_log_db);
+        sqlite3_close(game_log_db);
+        game_log_db = NULL;
         return NULL;
     }
 
+    // the launcher and gametime may have the file open at the same time
+    sqlite3_busy_timeout(game_log_db, 2000);
+    // persistent, so every later connection gets it too. NORMAL is safe in
+    // WAL mode, a power cut can only lose the last commits, never corrupt
+    sqlite3_exec(game_log_db, "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL;", NULL, NULL, NULL);
+
     if (!db_exists) {
         sqlite3_exec(game_log_db,
                      "DROP TABLE IF EXISTS rom;"
@@ -42,16 +172,84 @@ sqlite3* play_activity_db_open(void)
                      "CREATE INDEX play_activity_rom_id_index ON play_activity(rom_id);",
                      NULL, NULL, NULL);
     }
+    __db_migrate(game_log_db);
+
+    static bool registered = false;
+    if (!registered) {
+        atexit(play_activity_db_shutdown);
+        registered = true;
+    }
 
     return game_log_db;
 }
 
-void play_activity_db_close(sqlite3* game_log_db)
+// finalizes the cached statements and closes the shared connection,
+// the next call into the library transparently reopens it
+void play_activity_db_close(sqlite3* ctx)
 {
+    if (ctx == NULL || ctx != game_log_db)
+        return;
+
+    for (int i = 0; i < STMT_COUNT; i++) {
+        sqlite3_finalize(statements[i]);
+        statements[i] = NULL;
+    }
     sqlite3_close(game_log_db);
     game_log_db = NULL;
 }
 
+sqlite3_stmt *play_activity_db_prepare(sqlite3* game_log_db, char *sql)
+{
+    //LOG_info("play_activity_db_prepare(%s)\n", sql);
+    if (game_log_db == NULL) {
+        printf("DB is not open");
+        return NULL;
+    }
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(game_log_db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        printf("%s: %s\n", sqlite3_errmsg(game_log_db), sql);
+    }
+    return stmt;
+}
+
+// returns the cached statement, reset and ready to be bound
+static sqlite3_stmt *__db_statement(int which)
+{
+    sqlite3 *db = play_activity_db_open();
+    if (db == NULL)
+        return NULL;
+
+    sqlite3_stmt *stmt = statements[which];
+    if (stmt == NULL) {
+        stmt = statements[which] = play_activity_db_prepare(db, (char *)statement_sql[which]);
+    }
+    else {
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+    }
+    return stmt;
+}
+
+// steps stmt once and returns the first column of the row, or fallback.
+// the statement is reset afterwards so it doesnt hold on to its snapshot
+static int __db_query_int(sqlite3_stmt *stmt, int fallback)
+{
+    int value = fallback;
+    if (stmt && sqlite3_step(stmt) == SQLITE_ROW)
+        value = sqlite3_column_int(stmt, 0);
+    sqlite3_reset(stmt);
+    return value;
+}
+
+static int __db_run(sqlite3_stmt *stmt)
+{
+    if (stmt == NULL)
+        return SQLITE_ERROR;
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
 void free_play_activities(PlayActivities *pa_ptr)
 {
     for (int i = 0; i < pa_ptr->count; i++) {
@@ -84,10 +282,21 @@ void get_rom_image_path(char *rom_file, char *out_image_path)
     free(clean_rom_name);
 }
 
+// runs exec_transaction inside a single write transaction, rolling back
+// if it returns anything but SQLITE_OK
 int play_activity_db_transaction(sqlite3* game_log_db, int (*exec_transaction)(sqlite3*))
 {
     int retval;
+    if (game_log_db == NULL)
+        return SQLITE_ERROR;
+    // IMMEDIATE takes the write lock up front, a deferred transaction
+    // that reads first could fail to upgrade with SQLITE_BUSY
+    if ((retval = sqlite3_exec(game_log_db, "BEGIN IMMEDIATE;", NULL, NULL, NULL)) != SQLITE_OK) {
+        printf("%s\n", sqlite3_errmsg(game_log_db));
+        return retval;
+    }
     retval = exec_transaction(game_log_db);
+    sqlite3_exec(game_log_db, retval == SQLITE_OK ? "COMMIT;" : "ROLLBACK;", NULL, NULL, NULL);
     return retval;
 }
 
@@ -95,69 +304,23 @@ int play_activity_db_execute(char *sql)
 {
     //LOG_info("play_activity_db_execute(%s)\n", sql);
     sqlite3* game_log_db = play_activity_db_open();
-    int rc = sqlite3_exec(game_log_db, sql, NULL, NULL, NULL);
-    play_activity_db_close(game_log_db);
-    return rc;
-}
-
-sqlite3_stmt *play_activity_db_prepare(sqlite3* game_log_db, char *sql)
-{
-    //LOG_info("play_activity_db_prepare(%s)\n", sql);
-    if (game_log_db == NULL) {
-        printf("DB is not open");
-        return NULL;
-    }
-    sqlite3_stmt *stmt = NULL;
-    if (sqlite3_prepare_v2(game_log_db, sql, -1, &stmt, NULL) != SQLITE_OK) {
-        printf("%s: %s\n", sqlite3_errmsg(game_log_db), sqlite3_sql(stmt));
-    }
-    return stmt;
+    if (game_log_db == NULL)
+        return SQLITE_ERROR;
+    return sqlite3_exec(game_log_db, sql, NULL, NULL, NULL);
 }
 
 int play_activity_get_total_play_time(void)
 {
-    int total_play_time = 0;
-    char *sql =
-        "SELECT SUM(play_time_total) FROM (SELECT SUM(play_time) AS play_time_total FROM play_activity GROUP BY rom_id) "
-        "WHERE play_time_total > 60;";
-    sqlite3_stmt *stmt;
-
-    sqlite3* game_log_db = play_activity_db_open();
-    stmt = play_activity_db_prepare(game_log_db, sql);
-
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        total_play_time = sqlite3_column_int(stmt, 0);
-    }
-
-    sqlite3_finalize(stmt);
-    play_activity_db_close(game_log_db);
-
-    return total_play_time;
+    return __db_query_int(__db_statement(STMT_TOTAL_PLAY_TIME), 0);
 }
 
 PlayActivities *play_activity_find_all(void)
 {
     PlayActivities *play_activities = NULL;
-    char *sql =
-        "SELECT * FROM ("
-        "    SELECT rom.id, rom.type, rom.name, rom.file_path, "
-        "           COUNT(play_activity.ROWID) AS play_count_total, "
-        "           SUM(play_activity.play_time) AS play_time_total, "
-        "           SUM(play_activity.play_time)/COUNT(play_activity.ROWID) AS play_time_average, "
-        "           datetime(MIN(play_activity.created_at), 'unixepoch') AS first_played_at, "
-        "           datetime(MAX(play_activity.created_at), 'unixepoch') AS last_played_at "
-        "    FROM rom LEFT JOIN play_activity ON rom.id = play_activity.rom_id "
-        "    GROUP BY rom.id) "
-        "WHERE play_time_total > 0 "
-        "ORDER BY play_time_total DESC;";
-    sqlite3_stmt *stmt;
-
-    sqlite3* game_log_db = play_activity_db_open();
-
-    stmt = play_activity_db_prepare(game_log_db, sql);
+    sqlite3_stmt *stmt = __db_statement(STMT_FIND_ALL);
 
     int play_activity_count = 0;
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
+    while (stmt && sqlite3_step(stmt) == SQLITE_ROW) {
         play_activity_count++;
     }
     sqlite3_reset(stmt);
@@ -175,6 +338,8 @@ PlayActivities *play_activity_find_all(void)
         ROM *rom = play_activities->play_activity[i]->rom = (ROM *)malloc(sizeof(ROM));
         entry->first_played_at = NULL;
         entry->last_played_at = NULL;
+        rom->file_path = NULL;
+        rom->image_path = NULL;
 
         rom->id = sqlite3_column_int(stmt, 0);
         rom->type = strdup((const char *)sqlite3_column_text(stmt, 1));
@@ -189,18 +354,17 @@ PlayActivities *play_activity_find_all(void)
         entry->play_count = sqlite3_column_int(stmt, 4);
         entry->play_time_total = sqlite3_column_int(stmt, 5);
         entry->play_time_average = sqlite3_column_int(stmt, 6);
-        if (sqlite3_column_text(stmt, 8) != NULL) {
+        if (sqlite3_column_text(stmt, 7) != NULL) {
             entry->first_played_at = strdup((const char *)sqlite3_column_text(stmt, 7));
         }
-        if (sqlite3_column_text(stmt, 9) != NULL) {
+        if (sqlite3_column_text(stmt, 8) != NULL) {
             entry->last_played_at = strdup((const char *)sqlite3_column_text(stmt, 8));
         }
 
         play_activities->play_time_total += entry->play_time_total;
     }
 
-    sqlite3_finalize(stmt);
-    play_activity_db_close(game_log_db);
+    sqlite3_reset(stmt);
 
     return play_activities;
 }
@@ -217,89 +381,80 @@ void __ensure_rel_path(char *rel_path, const char *rom_path)
     }
 }
 
-int __db_insert_rom(sqlite3* game_log_db, const char *rom_type, const char *rom_name, const char *file_path, const char *image_path)
+int __db_insert_rom(const char *rom_type, const char *rom_name, const char *file_path, const char *image_path)
 {
-    int rom_id = ROM_NOT_FOUND;
-
     char rel_path[MAX_PATH];
     __ensure_rel_path(rel_path, file_path);
 
-    char *sql = sqlite3_mprintf("INSERT INTO rom(type, name, file_path, image_path) VALUES(%Q, %Q, %Q, %Q);",
-                                rom_type, rom_name, rel_path, image_path);
-    sqlite3_exec(game_log_db, sql, NULL, NULL, NULL);
-    sqlite3_free(sql);
-
-    sqlite3_stmt *stmt = play_activity_db_prepare(game_log_db, "SELECT id FROM rom WHERE ROWID = last_insert_rowid()");
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        rom_id = sqlite3_column_int(stmt, 0);
-    }
-    sqlite3_finalize(stmt);
+    sqlite3_stmt *stmt = __db_statement(STMT_INSERT_ROM);
+    if (stmt == NULL)
+        return ROM_NOT_FOUND;
+    sqlite3_bind_text(stmt, 1, rom_type, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, rom_name, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, rel_path, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, image_path, -1, SQLITE_STATIC);
+    if (__db_run(stmt) != SQLITE_OK)
+        return ROM_NOT_FOUND;
 
-    return rom_id;
+    // id is the rowid alias, no need to query it back
+    return (int)sqlite3_last_insert_rowid(game_log_db);
 }
 
-void __db_update_rom(sqlite3* game_log_db, int rom_id, const char *rom_type, const char *rom_name, const char *file_path, const char *image_path)
+void __db_update_rom(int rom_id, const char *rom_type, const char *rom_name, const char *file_path, const char *image_path)
 {
     char rel_path[MAX_PATH];
     __ensure_rel_path(rel_path, file_path);
 
-    char *sql = sqlite3_mprintf("UPDATE rom SET type = %Q, name = %Q, file_path = %Q, image_path = %Q WHERE id = %d;",
-                                rom_type, rom_name, rel_path, image_path, rom_id);
-    sqlite3_exec(game_log_db, sql, NULL, NULL, NULL);
-    sqlite3_free(sql);
+    sqlite3_stmt *stmt = __db_statement(STMT_UPDATE_ROM);
+    if (stmt == NULL)
+        return;
+    sqlite3_bind_text(stmt, 1, rom_type, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, rom_name, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, rel_path, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, image_path, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 5, rom_id);
+    __db_run(stmt);
 }
 
-int __db_get_orphan_rom_id(sqlite3* game_log_db, const char *rom_path)
+int __db_get_orphan_rom_id(const char *rom_path)
 {
-    int rom_id = ROM_NOT_FOUND;
     char *_file_name = strdup(rom_path);
     const char *file_name = baseName(_file_name);
     char *rom_name = removeExtension(file_name);
 
-    char *sql = sqlite3_mprintf("SELECT id FROM rom WHERE (name=%Q OR name=%Q) AND type='ORPHAN' LIMIT 1;", rom_name, file_name);
-    sqlite3_stmt *stmt = play_activity_db_prepare(game_log_db, sql);
-    sqlite3_free(sql);
-    free(rom_name);
-    free(_file_name);
-
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        rom_id = sqlite3_column_int(stmt, 0);
+    sqlite3_stmt *stmt = __db_statement(STMT_ORPHAN_ROM);
+    if (stmt) {
+        sqlite3_bind_text(stmt, 1, rom_name, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 2, file_name, -1, SQLITE_STATIC);
     }
+    int rom_id = __db_query_int(stmt, ROM_NOT_FOUND);
 
-    sqlite3_finalize(stmt);
+    free(rom_name);
+    free(_file_name);
 
     return rom_id;
 }
 
-int __db_get_rom_id_by_path(sqlite3* game_log_db, const char *rom_path)
+int __db_get_rom_id_by_path(const char *rom_path)
 {
-    int rom_id = ROM_NOT_FOUND;
-
     char rel_path[MAX_PATH];
     __ensure_rel_path(rel_path, rom_path);
 
-    char *sql = sqlite3_mprintf("SELECT id FROM rom WHERE file_path=%Q LIMIT 1;", rel_path);
-    sqlite3_stmt *stmt = play_activity_db_prepare(game_log_db, sql);
-    sqlite3_free(sql);
-
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        rom_id = sqlite3_column_int(stmt, 0);
-    }
-
-    sqlite3_finalize(stmt);
-
-    return rom_id;
+    sqlite3_stmt *stmt = __db_statement(STMT_ROM_BY_PATH);
+    if (stmt)
+        sqlite3_bind_text(stmt, 1, rel_path, -1, SQLITE_STATIC);
+    return __db_query_int(stmt, ROM_NOT_FOUND);
 }
 
-int __db_rom_find_by_file_path(sqlite3* game_log_db, const char *rom_path, bool create_or_update)
+int __db_rom_find_by_file_path(const char *rom_path, bool create_or_update)
 {
     //LOG_info("rom_find_by_file_path('%s')\n", rom_path);
 
     bool update_orphan = false;
-    int rom_id = __db_get_rom_id_by_path(game_log_db, rom_path);
+    int rom_id = __db_get_rom_id_by_path(rom_path);
 
     if (rom_id == ROM_NOT_FOUND) {
-        rom_id = __db_get_orphan_rom_id(game_log_db, rom_path);
+        rom_id = __db_get_orphan_rom_id(rom_path);
         if (rom_id != ROM_NOT_FOUND) {
             update_orphan = true;
         }
@@ -307,42 +462,28 @@ int __db_rom_find_by_file_path(sqlite3* game_log_db, const char *rom_path, bool
 
     if (update_orphan) {
         char *rom_name = removeExtension(baseName(rom_path));
-        __db_update_rom(game_log_db, rom_id, "", rom_name, rom_path, "");
+        __db_update_rom(rom_id, "", rom_name, rom_path, "");
         free(rom_name);
     }
     else if (rom_id == ROM_NOT_FOUND && create_or_update) {
         char *rom_name = removeExtension(baseName(rom_path));
-        rom_id = __db_insert_rom(game_log_db, "", rom_name, rom_path, "");
+        rom_id = __db_insert_rom("", rom_name, rom_path, "");
         free(rom_name);
     }
 
     return rom_id;
 }
 
-int play_activity_transaction_rom_find_by_file_path(const char *rom_path, bool create_or_update)
-{
-    int retval;
-    sqlite3* game_log_db = play_activity_db_open();
-    retval = __db_rom_find_by_file_path(game_log_db, rom_path, create_or_update);
-    play_activity_db_close(game_log_db);
-    return retval;
-}
-
 int play_activity_get_play_time(const char *rom_path)
 {
     int play_time = 0;
-    sqlite3* game_log_db = play_activity_db_open();
-    int rom_id = __db_rom_find_by_file_path(game_log_db, rom_path, false);
+    int rom_id = __db_rom_find_by_file_path(rom_path, false);
     if (rom_id != ROM_NOT_FOUND) {
-        char *sql = sqlite3_mprintf("SELECT SUM(play_time) FROM play_activity WHERE rom_id = %d;", rom_id);
-        sqlite3_stmt *stmt = play_activity_db_prepare(game_log_db, sql);
-        sqlite3_free(sql);
-        if (sqlite3_step(stmt) == SQLITE_ROW) {
-            play_time = sqlite3_column_int(stmt, 0);
-        }
-        sqlite3_finalize(stmt);
+        sqlite3_stmt *stmt = __db_statement(STMT_ROM_PLAY_TIME);
+        if (stmt)
+            sqlite3_bind_int(stmt, 1, rom_id);
+        play_time = __db_query_int(stmt, 0);
     }
-    play_activity_db_close(game_log_db);
     return play_time;
 }
 
@@ -369,7 +510,7 @@ bool _get_active_rom_path(char *rom_path_out)
     return false;
 }
 
-int __db_get_active_closed_activity(sqlite3* game_log_db)
+int __db_get_active_closed_activity(void)
 {
     int rom_id = ROM_NOT_FOUND;
 
@@ -380,69 +521,109 @@ int __db_get_active_closed_activity(sqlite3* game_log_db)
 
     //LOG_info("Last closed active rom: %s\n", rom_path);
 
-    if ((rom_id = __db_rom_find_by_file_path(game_log_db, rom_path, false)) == ROM_NOT_FOUND) {
+    if ((rom_id = __db_rom_find_by_file_path(rom_path, false)) == ROM_NOT_FOUND) {
         return ROM_NOT_FOUND;
     }
 
-    char *sql = sqlite3_mprintf("SELECT * FROM play_activity WHERE rom_id = %d AND play_time IS NULL;", rom_id);
-    sqlite3_stmt *stmt = play_activity_db_prepare(game_log_db, sql);
-
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
+    sqlite3_stmt *stmt = __db_statement(STMT_OPEN_ACTIVITY);
+    if (stmt)
+        sqlite3_bind_int(stmt, 1, rom_id);
+    if (__db_query_int(stmt, 0)) {
         // Activity is not closed
         rom_id = ROM_NOT_FOUND;
     }
 
-    sqlite3_free(sql);
-    sqlite3_finalize(stmt);
-
     return rom_id;
 }
 
+// the transactions below carry their arguments through here, the
+// callback signature has no room for them
+static char *transaction_rom_path;
+static int transaction_rom_id;
+
+static int __db_start_activity(int rom_id)
+{
+    sqlite3_stmt *stmt = __db_statement(STMT_START_ACTIVITY);
+    if (stmt)
+        sqlite3_bind_int(stmt, 1, rom_id);
+    return __db_run(stmt);
+}
+
+static int __tx_start(sqlite3* game_log_db)
+{
+    transaction_rom_id = __db_rom_find_by_file_path(transaction_rom_path, true);
+    if (transaction_rom_id == ROM_NOT_FOUND)
+        return SQLITE_NOTFOUND;
+    return __db_start_activity(transaction_rom_id);
+}
+
+static int __tx_resume(sqlite3* game_log_db)
+{
+    transaction_rom_id = __db_get_active_closed_activity();
+    if (transaction_rom_id == ROM_NOT_FOUND)
+        return SQLITE_NOTFOUND;
+    return __db_start_activity(transaction_rom_id);
+}
+
+static int __tx_stop(sqlite3* game_log_db)
+{
+    transaction_rom_id = __db_rom_find_by_file_path(transaction_rom_path, false);
+    if (transaction_rom_id == ROM_NOT_FOUND)
+        return SQLITE_NOTFOUND;
+    sqlite3_stmt *stmt = __db_statement(STMT_STOP_ACTIVITY);
+    if (stmt)
+        sqlite3_bind_int(stmt, 1, transaction_rom_id);
+    return __db_run(stmt);
+}
+
+static int __tx_stop_all(sqlite3* game_log_db)
+{
+    int rc = __db_run(__db_statement(STMT_STOP_ALL_ACTIVITIES));
+    if (rc == SQLITE_OK)
+        rc = __db_run(__db_statement(STMT_PRUNE_ACTIVITIES));
+    return rc;
+}
+
 void play_activity_start(char *rom_file_path)
 {
     //LOG_info("\n:: play_activity_start(%s)\n", rom_file_path);
-    int rom_id = play_activity_transaction_rom_find_by_file_path(rom_file_path, true);
-    if (rom_id == ROM_NOT_FOUND) {
+    transaction_rom_path = rom_file_path;
+    transaction_rom_id = ROM_NOT_FOUND;
+    int rc = play_activity_db_transaction(play_activity_db_open(), __tx_start);
+    if (transaction_rom_id == ROM_NOT_FOUND || rc != SQLITE_OK) {
         exit(1);
     }
-    char *sql = sqlite3_mprintf("INSERT INTO play_activity(rom_id) VALUES(%d);", rom_id);
-    play_activity_db_execute(sql);
-    sqlite3_free(sql);
 }
 
 void play_activity_resume(void)
 {
     //LOG_info("\n:: play_activity_resume()");
-    sqlite3* game_log_db = play_activity_db_open();
-    int rom_id = __db_get_active_closed_activity(game_log_db);
-    play_activity_db_close(game_log_db);
-    if (rom_id == ROM_NOT_FOUND) {
+    transaction_rom_id = ROM_NOT_FOUND;
+    int rc = play_activity_db_transaction(play_activity_db_open(), __tx_resume);
+    if (transaction_rom_id == ROM_NOT_FOUND) {
         printf("Error: no active rom\n");
         exit(1);
     }
-    char *sql = sqlite3_mprintf("INSERT INTO play_activity(rom_id) VALUES(%d);", rom_id);
-    play_activity_db_execute(sql);
-    sqlite3_free(sql);
+    if (rc != SQLITE_OK) {
+        exit(1);
+    }
 }
 
 void play_activity_stop(char *rom_file_path)
 {
     //LOG_info("\n:: play_activity_stop(%s)\n", rom_file_path);
-    int rom_id = play_activity_transaction_rom_find_by_file_path(rom_file_path, false);
-    if (rom_id == ROM_NOT_FOUND) {
+    transaction_rom_path = rom_file_path;
+    transaction_rom_id = ROM_NOT_FOUND;
+    play_activity_db_transaction(play_activity_db_open(), __tx_stop);
+    if (transaction_rom_id == ROM_NOT_FOUND) {
         exit(1);
     }
-    char *sql = sqlite3_mprintf("UPDATE play_activity SET play_time = (strftime('%%s', 'now')) - created_at, updated_at = (strftime('%%s', 'now')) WHERE rom_id = %d AND play_time IS NULL;", rom_id);
-    play_activity_db_execute(sql);
-    sqlite3_free(sql);
 }
 
 void play_activity_stop_all(void)
 {
     //LOG_info("\n:: play_activity_stop_all()");
-    play_activity_db_execute(
-        "UPDATE play_activity SET play_time = (strftime('%s', 'now')) - created_at, updated_at = (strftime('%s', 'now')) WHERE play_time IS NULL;"
-        "DELETE FROM play_activity WHERE play_time < 0;");
+    play_activity_db_transaction(play_activity_db_open(), __tx_stop_all);
 }
 
 void play_activity_list_all(void)
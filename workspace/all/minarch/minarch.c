@@ -9,6 +9,8 @@
 #include <libgen.h>
 #include <time.h>
 #include <sys/stat.h>
+#include <sys/sysinfo.h>
+#include <sys/time.h>
 #include <errno.h>
 #include <zip.h> 
 #include <pthread.h>
@@ -70,6 +72,8 @@ static int max_ff_speed = 3; // 4x
 static int ff_audio = 0;
 static int fast_forward = 0;
 static int overclock = 3; // auto
+#define CPU_BOOST_FRAMES 30 // how long known heavy moments hold the top clock in auto
+static int thread_profile = THREAD_PROFILE_PRIORITY;
 static int has_custom_controllers = 0;
 static int gamepad_type = 0; // index in gamepad_labels/gamepad_values
 static int downsample = 0; // set to 1 to convert from 8888 to 565
@@ -80,6 +84,60 @@ static int DEVICE_PITCH = 0; // FIXED_PITCH;
 
 GFX_Renderer renderer;
 
+///////////////////////////////////////
+// startup trace
+//
+// records how long each startup phase takes (and on which thread) up to
+// the first presented frame, written to STARTUP_TRACE_PATH as
+// "<phase> <thread> <start ms> <end ms> <duration ms>" lines
+
+#define STARTUP_TRACE_PATH "/tmp/minarch_startup.txt"
+#define STARTUP_TRACE_MAX 32
+
+static struct StartupTrace {
+	uint64_t launch;
+	int count;
+	int written;
+	struct {
+		const char* name;
+		const char* thread;
+		uint64_t start;
+		uint64_t end;
+	} phases[STARTUP_TRACE_MAX];
+} startup;
+
+static int Startup_traceBegin(const char* name, const char* thread) {
+	int i = __sync_fetch_and_add(&startup.count, 1);
+	if (i>=STARTUP_TRACE_MAX) return -1;
+	startup.phases[i].name = name;
+	startup.phases[i].thread = thread;
+	startup.phases[i].start = getMicroseconds();
+	return i;
+}
+static void Startup_traceEnd(int i) {
+	if (i<0 || i>=STARTUP_TRACE_MAX) return;
+	startup.phases[i].end = getMicroseconds();
+}
+static void Startup_traceFirstFrame(void) {
+	if (startup.written || !startup.launch) return;
+	startup.written = 1;
+
+	uint64_t now = getMicroseconds();
+	FILE* file = fopen(STARTUP_TRACE_PATH, "w");
+	if (!file) return;
+	int count = startup.count<STARTUP_TRACE_MAX ? startup.count : STARTUP_TRACE_MAX;
+	for (int i=0; i<count; i++) {
+		if (!startup.phases[i].end) continue;
+		fprintf(file, "%s %s %.1f %.1f %.1f\n", startup.phases[i].name, startup.phases[i].thread,
+			(startup.phases[i].start - startup.launch) / 1000.0,
+			(startup.phases[i].end - startup.launch) / 1000.0,
+			(startup.phases[i].end - startup.phases[i].start) / 1000.0);
+	}
+	fprintf(file, "first_frame main 0.0 %.1f %.1f\n", (now - startup.launch) / 1000.0, (now - startup.launch) / 1000.0);
+	fclose(file);
+	LOG_info("launch to first frame %.1fms\n", (now - startup.launch) / 1000.0);
+}
+
 ///////////////////////////////////////
 
 static struct Core {
@@ -141,27 +199,13 @@ static struct Game {
 } game;
 static void Game_open(char* path) {
 	LOG_info("Game_open\n");
-	int skipzip = 0;
 	memset(&game, 0, sizeof(game));
 	
 	strcpy((char*)game.path, path);
 	strcpy((char*)game.name, strrchr(path, '/')+1);
-
-	// check first if the rom already is alive in tmp folder if so skip unzipping shit
-	char tmpfldr[255];
-	snprintf(tmpfldr, sizeof(tmpfldr), "/tmp/nextarch/%s", core.tag);
-	char *tmppath = PLAT_findFileInDir(tmpfldr, game.name);
-	if (tmppath) {
-		printf("File exists skipping unzipping and setting game.tmp_path: %s\n", tmppath);
-		strcpy((char*)game.tmp_path, tmppath);
-		skipzip = 1;
-		free(tmppath);
-	} else {
-		printf("File does not exist in %s\n",tmpfldr);
-	}
 		
 	// if we have a zip file
-	if (suffixMatch(".zip", game.path) && !skipzip) {
+	if (suffixMatch(".zip", game.path)) {
 		LOG_info("is zip file\n");
 		int supports_zip = 0;
 		int i = 0;
@@ -181,7 +225,7 @@ static void Game_open(char* path) {
 		// if the core doesn't support zip files natively
 		if (!supports_zip) {
 			// extract zip file located at game.path to game.tmp_path
-			// game.tmp_path is temp dir generated by mkdtemp
+			// game.tmp_path is kept in the rom cache, see RomCache_*
 			LOG_info("Extracting zip file manually: %s\n", game.path);
 			if(!extract_zip(extensions))
 				return;
@@ -251,7 +295,7 @@ static void Game_open(char* path) {
 static void Game_close(void) {
 	if (game.data) free(game.data);
 	// why delete tempfile? keep it for next time when loading the game its much faster from /tmp ram folder
-	// if (game.tmp_path[0]) remove(game.tmp_path);
+	// the rom cache evicts it once it falls out of its budget
 	game.is_open = 0;
 	VIB_setStrength(0); // just in case
 }
@@ -273,9 +317,218 @@ static void Game_changeDisc(char* path) {
 	putFile(CHANGE_DISC_PATH, path); // NextUI still needs to know this to update recents.txt
 }
 
+///////////////////////////////////////
+// extracted rom cache
+//
+// roms extracted from zips are kept in /tmp/nextarch/<core.tag>/<key>/
+// so relaunching the same game skips unzipping. /tmp is tmpfs (RAM) on
+// these devices so the cache is held to a budget and the least recently
+// launched entries are evicted first. entries are keyed on the zip path,
+// its mtime and the crc of the extracted file so two zips containing the
+// same file name can't collide and a replaced zip is never served stale.
+
+#define ROMCACHE_PATH "/tmp/nextarch"
+#define ROMCACHE_STATS_PATH ROMCACHE_PATH "/stats.txt"
+#define ROMCACHE_BUDGET_PERCENT 25 // of physical RAM
+#define ROMCACHE_MAX_ENTRIES 256
+
+static struct RomCache {
+	uint64_t budget;
+	uint64_t used;
+	int hits;
+	int misses;
+	int evictions;
+} romcache;
+
+typedef struct RomCacheEntry {
+	char path[MAX_PATH];
+	time_t last_used;
+	uint64_t size;
+} RomCacheEntry;
+
+static uint64_t RomCache_key(const char* zip_path, time_t mtime, uint32_t crc, uint64_t size) {
+	// FNV-1a
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (const char* c=zip_path; *c; c++) {
+		hash ^= (uint8_t)*c;
+		hash *= 0x100000001b3ULL;
+	}
+	uint64_t parts[3] = { (uint64_t)mtime, crc, size };
+	for (int i=0; i<3; i++) {
+		for (int b=0; b<8; b++) {
+			hash ^= (parts[i] >> (b * 8)) & 0xff;
+			hash *= 0x100000001b3ULL;
+		}
+	}
+	return hash;
+}
+
+static void RomCache_init(void) {
+	static int initialized = 0;
+	if (initialized) return;
+	initialized = 1;
+
+	struct sysinfo info;
+	if (sysinfo(&info)==0) romcache.budget = (uint64_t)info.totalram * info.mem_unit / 100 * ROMCACHE_BUDGET_PERCENT;
+	else romcache.budget = 256 * 1024 * 1024;
+
+	FILE* file = fopen(ROMCACHE_STATS_PATH, "r");
+	if (file) {
+		fscanf(file, "hits=%i\nmisses=%i\nevictions=%i\n", &romcache.hits, &romcache.misses, &romcache.evictions);
+		fclose(file);
+	}
+}
+
+static void RomCache_writeStats(void) {
+	FILE* file = fopen(ROMCACHE_STATS_PATH, "w");
+	if (file) {
+		fprintf(file, "hits=%i\nmisses=%i\nevictions=%i\nused=%llu\nbudget=%llu\n",
+			romcache.hits, romcache.misses, romcache.evictions,
+			(unsigned long long)romcache.used, (unsigned long long)romcache.budget);
+		fclose(file);
+	}
+	LOG_info("rom cache: %i hits %i misses %i evictions, %lluKB of %lluKB used\n",
+		romcache.hits, romcache.misses, romcache.evictions,
+		(unsigned long long)romcache.used / 1024, (unsigned long long)romcache.budget / 1024);
+}
+
+static uint64_t RomCache_sizeOf(const char* path, struct stat* st) {
+	if (!S_ISDIR(st->st_mode)) return st->st_size;
+
+	uint64_t size = 0;
+	DIR* dir = opendir(path);
+	if (!dir) return 0;
+	struct dirent* dp;
+	while ((dp = readdir(dir))) {
+		if (dp->d_name[0]=='.') continue;
+		char file_path[MAX_PATH];
+		struct stat fst;
+		snprintf(file_path, sizeof(file_path), "%s/%s", path, dp->d_name);
+		if (stat(file_path, &fst)==0) size += fst.st_size;
+	}
+	closedir(dir);
+	return size;
+}
+
+static void RomCache_remove(const char* path) {
+	DIR* dir = opendir(path);
+	if (dir) {
+		struct dirent* dp;
+		while ((dp = readdir(dir))) {
+			if (!strcmp(dp->d_name, ".") || !strcmp(dp->d_name, "..")) continue;
+			char file_path[MAX_PATH];
+			snprintf(file_path, sizeof(file_path), "%s/%s", path, dp->d_name);
+			unlink(file_path);
+		}
+		closedir(dir);
+		rmdir(path);
+	}
+	else unlink(path);
+}
+
+static int RomCache_compareEntries(const void* a, const void* b) {
+	time_t ta = ((const RomCacheEntry*)a)->last_used;
+	time_t tb = ((const RomCacheEntry*)b)->last_used;
+	return (ta > tb) - (ta < tb);
+}
+
+// evicts least recently launched entries (across all cores) until needed bytes fit in the budget
+// and, counting the one being launched, there are no more than ROMCACHE_MAX_ENTRIES
+static void RomCache_evict(uint64_t needed, const char* keep_path) {
+	RomCacheEntry* entries = NULL;
+	int count = 0;
+	int capacity = 0;
+	romcache.used = 0;
+
+	DIR* root = opendir(ROMCACHE_PATH);
+	if (!root) return;
+	struct dirent* tp;
+	while ((tp = readdir(root))) {
+		if (tp->d_name[0]=='.') continue;
+		char tag_path[MAX_PATH];
+		snprintf(tag_path, sizeof(tag_path), "%s/%s", ROMCACHE_PATH, tp->d_name);
+		DIR* tag = opendir(tag_path);
+		if (!tag) continue;
+
+		// each child of a tag dir is an entry, loose files are left over from the old unkeyed layout
+		struct dirent* ep;
+		while ((ep = readdir(tag))) {
+			if (ep->d_name[0]=='.') continue;
+			char entry_path[MAX_PATH];
+			struct stat st;
+			snprintf(entry_path, sizeof(entry_path), "%s/%s", tag_path, ep->d_name);
+			if (stat(entry_path, &st)!=0) continue;
+
+			uint64_t size = RomCache_sizeOf(entry_path, &st);
+			romcache.used += size;
+			if (keep_path && exactMatch(entry_path, (char*)keep_path)) continue;
+			if (count>=capacity) {
+				// every entry has to be listed or the ones past the end could never be evicted
+				int grown_capacity = capacity ? capacity * 2 : 64;
+				RomCacheEntry* grown = realloc(entries, grown_capacity * sizeof(RomCacheEntry));
+				if (!grown) continue;
+				entries = grown;
+				capacity = grown_capacity;
+			}
+
+			RomCacheEntry* entry = &entries[count++];
+			strcpy(entry->path, entry_path);
+			entry->last_used = st.st_mtime;
+			entry->size = size;
+		}
+		closedir(tag);
+	}
+	closedir(root);
+
+	if (count) qsort(entries, count, sizeof(RomCacheEntry), RomCache_compareEntries);
+	for (int i=0; i<count && (romcache.used+needed>romcache.budget || count-i+1>ROMCACHE_MAX_ENTRIES); i++) {
+		LOG_info("rom cache: evicting %s (%lluKB)\n", entries[i].path, (unsigned long long)entries[i].size / 1024);
+		RomCache_remove(entries[i].path);
+		romcache.used -= entries[i].size;
+		romcache.evictions += 1;
+	}
+	romcache.used += needed;
+	free(entries);
+}
+
+static int extract_zip_entry(struct zip* za, zip_uint64_t index, uint64_t size, const char* dst_path) {
+	char part_path[MAX_PATH];
+	snprintf(part_path, sizeof(part_path), "%s.part", dst_path);
+
+	struct zip_file* zf = zip_fopen_index(za, index, 0);
+	if (!zf) {
+		LOG_error("zip_fopen_index failed\n");
+		return 0;
+	}
+	int fd = open(part_path, O_RDWR | O_TRUNC | O_CREAT, 0644);
+	if (fd < 0) {
+		LOG_error("open failed\n");
+		zip_fclose(zf);
+		return 0;
+	}
+
+	static char buf[64 * 1024];
+	uint64_t sum = 0;
+	while (sum != size) {
+		zip_int64_t len = zip_fread(zf, buf, sizeof(buf));
+		if (len <= 0 || write(fd, buf, len)!=len) {
+			LOG_error("zip_fread failed\n");
+			close(fd);
+			zip_fclose(zf);
+			unlink(part_path);
+			return 0;
+		}
+		sum += len;
+	}
+	close(fd);
+	zip_fclose(zf);
+
+	// only complete files ever appear under their real name
+	return rename(part_path, dst_path)==0;
+}
+
 int extract_zip(char** extensions)
 {
-	char buf[100];
 	struct zip *za;
 	int ze;
 	if ((za = zip_open(game.path, 0, &ze)) == NULL) {
@@ -285,79 +538,63 @@ int extract_zip(char** extensions)
 		return 0;
 	}
 
-	// char tmp_template[MAX_PATH];
-	// strcpy(tmp_template, "/tmp/minarch-XXXXXX");
-	
-	mkdir("/tmp/nextarch",0777);
-	char tmp_dirname[255];
-	snprintf(tmp_dirname, sizeof(tmp_dirname), "%s/%s", "/tmp/nextarch",core.tag);
-	mkdir(tmp_dirname,0777);
+	RomCache_init();
 
-	int i, len;
-	int fd;
-	struct zip_file *zf;
+	int found = 0;
 	struct zip_stat sb;
-	long long sum;
-	for (i = 0; i < zip_get_num_entries(za, 0); i++) {
-		if (zip_stat_index(za, i, 0, &sb) == 0) {
-			len = strlen(sb.name);
-			//LOG_info("Name: [%s], ", sb.name);
-			//LOG_info("Size: [%llu], ", sb.size);
-			//LOG_info("mtime: [%u]\n", (unsigned int)sb.mtime);
-			if (sb.name[len - 1] == '/') {
-				sprintf(game.tmp_path, "%s/%s", tmp_dirname, basename((char*)sb.name));
-			} else {
-				int found = 0;
-				char extension[8];
-				for (int e=0; extensions[e]; e++) {
-					sprintf(extension, ".%s", extensions[e]);
-					if (suffixMatch(extension, sb.name)) {
-						found = 1;
-						break;
-					}
-				}
-				if (!found) continue;
-
-				zf = zip_fopen_index(za, i, 0);
-				if (!zf) {
-					LOG_error( "zip_fopen_index failed\n");
-					return 0;
-				}
-
-				sprintf(game.tmp_path, "%s/%s", tmp_dirname, basename((char*)sb.name));
-				fd = open(game.tmp_path, O_RDWR | O_TRUNC | O_CREAT, 0644);
-				if (fd < 0) {
-					LOG_error( "open failed\n");
-					zip_fclose(zf);
-					return 0;
-				}
-				//LOG_info("Writing: %s\n", game.tmp_path);
-
-				sum = 0;
-				while (sum != sb.size) {
-					len = zip_fread(zf, buf, 100);
-					if (len < 0) {
-						LOG_error( "zip_fread failed\n");
-						close(fd);
-						zip_fclose(zf);
-						return 0;
-					}
-					write(fd, buf, len);
-					sum += len;
-				}
-				close(fd);
-				zip_fclose(zf);
-				return 1;
+	for (zip_int64_t i = 0; i < zip_get_num_entries(za, 0); i++) {
+		if (zip_stat_index(za, i, 0, &sb) != 0) continue;
+		int len = strlen(sb.name);
+		if (sb.name[len - 1] == '/') continue;
+
+		char extension[8];
+		for (int e=0; extensions[e]; e++) {
+			sprintf(extension, ".%s", extensions[e]);
+			if (suffixMatch(extension, sb.name)) {
+				found = 1;
+				break;
 			}
 		}
+		if (found) break;
 	}
-	
+	if (!found) {
+		zip_close(za);
+		return 0;
+	}
+
+	struct stat st;
+	time_t mtime = stat(game.path, &st)==0 ? st.st_mtime : 0;
+	uint64_t key = RomCache_key(game.path, mtime, (sb.valid & ZIP_STAT_CRC) ? sb.crc : 0, sb.size);
+
+	char entry_path[MAX_PATH];
+	snprintf(entry_path, sizeof(entry_path), "%s/%s", ROMCACHE_PATH, core.tag);
+	mkdir(ROMCACHE_PATH, 0777);
+	mkdir(entry_path, 0777);
+	snprintf(entry_path, sizeof(entry_path), "%s/%s/%016llx", ROMCACHE_PATH, core.tag, (unsigned long long)key);
+	snprintf(game.tmp_path, sizeof(game.tmp_path), "%s/%s", entry_path, basename((char*)sb.name));
+
+	int ok = 1;
+	if (exists(game.tmp_path) && stat(game.tmp_path, &st)==0 && (uint64_t)st.st_size==sb.size) {
+		LOG_info("rom cache hit: %s\n", game.tmp_path);
+		romcache.hits += 1;
+		utimes(entry_path, NULL); // mark as most recently launched
+		RomCache_evict(0, entry_path); // refreshes used, a lower budget may still need enforcing
+	}
+	else {
+		LOG_info("rom cache miss: %s\n", game.tmp_path);
+		romcache.misses += 1;
+		RomCache_evict(sb.size, entry_path);
+		mkdir(entry_path, 0777);
+		ok = extract_zip_entry(za, sb.index, sb.size, game.tmp_path);
+		if (!ok) RomCache_remove(entry_path);
+	}
+	RomCache_writeStats();
+
 	if (zip_close(za) == -1) {
 		LOG_error("can't close zip archive `%s'\n", game.path);
-		return 0;
 	}
 
-	return 0;
+	return ok;
 }
 
 ///////////////////////////////////////
@@ -785,6 +1022,8 @@ static void State_read(void) { // from picoarch
 	size_t state_size = core.serialize_size();
 	if (!state_size) return;
 
+	PWR_cpuBoost(CPU_BOOST_FRAMES); // reading, decompressing and the core catching up
+
 	int was_ff = fast_forward;
 	fast_forward = 0;
 
@@ -1233,6 +1472,7 @@ enum {
 	FE_OPT_TEARING,
 	FE_OPT_SYNC_REFERENCE,
 	FE_OPT_OVERCLOCK,
+	FE_OPT_THREADS,
 	FE_OPT_DEBUG,
 	FE_OPT_MAXFF,
 	FE_OPT_FF_AUDIO,
@@ -1406,6 +1646,12 @@ static char* overclock_labels[] = {
 	"Auto",
 	NULL,
 };
+static char* thread_profile_labels[] = { // THREAD_PROFILE_*
+	"Off",
+	"Priority",
+	"Pinned",
+	NULL,
+};
 
 // TODO: this should be provided by the core
 static char* gamepad_labels[] = {
@@ -1567,6 +1813,16 @@ static struct Config {
 				.values = overclock_labels,
 				.labels = overclock_labels,
 			},
+			[FE_OPT_THREADS] = {
+				.key	= "minarch_thread_profile",
+				.name	= "Thread Priority",
+				.desc	= "Priority runs audio in realtime and\nbackground work at low priority.\nPinned also gives emulation and audio\ntheir own CPU cores, which can starve\ncores that run many threads of their own.",
+				.default_value = THREAD_PROFILE_PRIORITY,
+				.value = THREAD_PROFILE_PRIORITY,
+				.count = 3,
+				.values = thread_profile_labels,
+				.labels = thread_profile_labels,
+			},
 			[FE_OPT_DEBUG] = {
 				.key	= "minarch_debug_hud",
 				.name	= "Debug HUD",
@@ -1938,8 +2194,14 @@ static void Config_syncFrontend(char* key, int value) {
 		overclock = value;
 		i = FE_OPT_OVERCLOCK;
 	}
+	else if (exactMatch(key,config.frontend.options[FE_OPT_THREADS].key)) {
+		thread_profile = value;
+		THREAD_setProfile(value);
+		i = FE_OPT_THREADS;
+	}
 	else if (exactMatch(key,config.frontend.options[FE_OPT_DEBUG].key)) {
 		show_debug = value;
+		GFX_GL_enableTiming(show_debug);
 		i = FE_OPT_DEBUG;
 	}
 	else if (exactMatch(key,config.frontend.options[FE_OPT_MAXFF].key)) {
@@ -3000,6 +3262,7 @@ static void Menu_saveState(void);
 static void Menu_loadState(void);
 
 static int setFastForward(int enable) {
+	if (enable && !fast_forward) PWR_cpuBoost(CPU_BOOST_FRAMES);
 	fast_forward = enable;
 	return enable;
 }
@@ -3232,11 +3495,84 @@ static void Input_init(const struct retro_input_descriptor *vars) {
 	input_initialized = 1;
 }
 
+///////////////////////////////
+
+// hardware rendering
+// gl cores render on our context into an fbo the platform owns, its size
+// comes from the max geometry once the game is loaded. frames then go
+// through the same shader chain as software frames.
+
+static struct retro_hw_render_callback hw_render;
+
+static uintptr_t HWRender_getFramebuffer(void) {
+	return GFX_GL_getHWFramebuffer();
+}
+static retro_proc_address_t HWRender_getProcAddress(const char* sym) {
+	return (retro_proc_address_t)GFX_GL_getProcAddress(sym);
+}
+
+static bool HWRender_set(struct retro_hw_render_callback* cb) {
+	LOG_info("Core requested GL context type: %d, version %d.%d\n", 
+		cb->context_type, cb->version_major, cb->version_minor);
+
+	// Fallback if version is 0.0 or other unexpected values
+	if (cb->context_type == RETRO_HW_CONTEXT_OPENGLES3 && cb->version_major == 0 && cb->version_minor == 0) {
+		LOG_info("Core requested invalid GL context type or version, defaulting to GLES 3.0\n");
+		cb->version_major = 3;
+		cb->version_minor = 0;
+	}
+
+	int gles, major, minor;
+	switch (cb->context_type) {
+		case RETRO_HW_CONTEXT_OPENGL: gles = 0; major = 2; minor = 1; break;
+		case RETRO_HW_CONTEXT_OPENGL_CORE: gles = 0; major = cb->version_major; minor = cb->version_minor; break;
+		case RETRO_HW_CONTEXT_OPENGLES2: gles = 1; major = 2; minor = 0; break;
+		case RETRO_HW_CONTEXT_OPENGLES3: gles = 1; major = 3; minor = 0; break;
+		case RETRO_HW_CONTEXT_OPENGLES_VERSION: gles = 1; major = cb->version_major; minor = cb->version_minor; break;
+		default:
+			LOG_error("unsupported hw context type %d\n", cb->context_type);
+			return false;
+	}
+	if (!GFX_GL_supportsHWRender(gles, major, minor)) {
+		LOG_error("can't provide %s %i.%i for hw render\n", gles ? "GLES" : "GL", major, minor);
+		return false;
+	}
+
+	cb->get_current_framebuffer = HWRender_getFramebuffer;
+	cb->get_proc_address = HWRender_getProcAddress;
+	hw_render = *cb;
+	return true;
+}
+
+// called once the game is loaded and its geometry is known
+static void HWRender_init(void) {
+	if (!hw_render.context_type) return;
+
+	struct retro_system_av_info av_info = {};
+	core.get_system_av_info(&av_info);
+	int w = av_info.geometry.max_width ? av_info.geometry.max_width : av_info.geometry.base_width;
+	int h = av_info.geometry.max_height ? av_info.geometry.max_height : av_info.geometry.base_height;
+	if (!GFX_GL_initHWRender(w, h, hw_render.depth, hw_render.stencil, hw_render.bottom_left_origin)) {
+		LOG_error("failed to create hw render target\n");
+		return;
+	}
+	if (hw_render.context_reset) hw_render.context_reset();
+}
+
+static void HWRender_quit(void) {
+	if (!hw_render.context_type) return;
+	if (hw_render.context_destroy) hw_render.context_destroy();
+	GFX_GL_quitHWRender();
+	memset(&hw_render, 0, sizeof(hw_render));
+}
+
 static bool set_rumble_state(unsigned port, enum retro_rumble_effect effect, uint16_t strength) {
 	// TODO: handle other args? not sure I can
 	VIB_setStrength(strength);
 	return 1;
 }
+static bool video_software_framebuffer(struct retro_framebuffer* fb);
+
 static bool environment_callback(unsigned cmd, void *data) { // copied from picoarch initially
 	// LOG_info("environment_callback: %i\n", cmd);
 	
@@ -3405,7 +3741,7 @@ static bool environment_callback(unsigned cmd, void *data) { // copied from pico
 	}
 	case RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER: { /* (40 | RETRO_ENVIRONMENT_EXPERIMENTAL) */
 		// puts("RETRO_ENVIRONMENT_GET_CURRENT_SOFTWARE_FRAMEBUFFER");
-		break;
+		return video_software_framebuffer((struct retro_framebuffer*)data);
 	}
 	
 	case RETRO_ENVIRONMENT_GET_AUDIO_VIDEO_ENABLE: {
@@ -3573,23 +3909,8 @@ static bool environment_callback(unsigned cmd, void *data) { // copied from pico
 	// 	puts("RETRO_ENVIRONMENT_GET_FASTFORWARDING"); fflush(stdout);
 	// 	break;
 	// };
-	case RETRO_ENVIRONMENT_SET_HW_RENDER:
-	{
-		struct retro_hw_render_callback *cb = (struct retro_hw_render_callback*)data;
-		
-		// Log the requested context
-		LOG_info("Core requested GL context type: %d, version %d.%d\n", 
-			cb->context_type, cb->version_major, cb->version_minor);
-
-		// Fallback if version is 0.0 or other unexpected values
-		if (cb->context_type == 4 && cb->version_major == 0 && cb->version_minor == 0) {
-			LOG_info("Core requested invalid GL context type or version, defaulting to GLES 2.0\n");
-			cb->context_type = RETRO_HW_CONTEXT_OPENGLES3;
-			cb->version_major = 3;
-			cb->version_minor = 0;
-		}
-
-		return true;
+	case RETRO_ENVIRONMENT_SET_HW_RENDER: { /* 14 */
+		return HWRender_set((struct retro_hw_render_callback*)data);
 	}
 	default:
 		// LOG_debug("Unsupported environment cmd: %u\n", cmd);
@@ -4447,6 +4768,10 @@ void applyCircleReveal(uint32_t **data, size_t pitch, unsigned width, unsigned h
     *data = temp_buffer;
 }
 
+static unsigned lastframe_width = 0;
+static unsigned lastframe_height = 0;
+static int dupe_frame = 0;
+static int lastframe_presented = 0; // the gpu has lastframe, so a dupe can skip the upload
 static void video_refresh_callback_main(const void *data, unsigned width, unsigned height, size_t pitch) {
 	// return;
 	
@@ -4461,7 +4786,10 @@ static void video_refresh_callback_main(const void *data, unsigned width, unsign
 	// 14 will let GB hit 10x but NES and SNES will drop to 1.5x at 30fps (not sure why)
 	// but 10 hurts PS...
 	// TODO: 10 was based on rg35xx, probably different results on other supported platforms
-	if (fast_forward && SDL_GetTicks()-last_flip_time<10) return;
+	if (fast_forward && SDL_GetTicks()-last_flip_time<10) {
+		lastframe_presented = 0;
+		return;
+	}
 	
 	// FFVII menus 
 	// 16: 30/200
@@ -4473,6 +4801,7 @@ static void video_refresh_callback_main(const void *data, unsigned width, unsign
 	// you can squeeze more out of every console by turning prevent tearing off
 	// eg. PS@10 60/240
 	if (!data) {
+		lastframe_presented = 0;
 		return;
 	}
 
@@ -4488,8 +4817,10 @@ static void video_refresh_callback_main(const void *data, unsigned width, unsign
 		GFX_resetShaders();
 	}
 	
-	// debug
-	if (show_debug && !isnan(currentratio) && !isnan(currentfps) && !isnan(currentreqfps)  && !isnan(currentbufferms) &&
+	int from_hw = data==RETRO_HW_FRAME_BUFFER_VALID;
+
+	// debug, drawn into the pixels so not available for hw frames
+	if (show_debug && !from_hw && !isnan(currentratio) && !isnan(currentfps) && !isnan(currentreqfps)  && !isnan(currentbufferms) &&
 	currentbuffersize >= 0  && currentbufferfree >= 0 && SDL_GetTicks() > 5000) {
 		int x = 2 + renderer.src_x;
 		int y = 2 + renderer.src_y;
@@ -4518,6 +4849,17 @@ static void video_refresh_callback_main(const void *data, unsigned width, unsign
 
 		sprintf(debug_text, "%i/%ix%i/%ix%i/%ix%i", currentshaderpass, currentshadersrcw,currentshadersrch,currentshadertexw,currentshadertexh,currentshaderdstw,currentshaderdsth);
 		blitBitmapText(debug_text,x,-y - 14,(uint32_t*)data,pitch / 4, width,height);
+
+		// upload + shader passes + present/effect/overlay, then swap
+		GPUTimings timings;
+		GFX_GL_getTimings(&timings);
+		if (timings.valid) {
+			float passes = 0;
+			for (int i=0; i<timings.passes; i++) passes += timings.pass[i];
+			sprintf(debug_text, "%s %.1f+%.1f+%.1f/%.1fms", timings.timer_query ? "gpu" : "cpu",
+				timings.upload, passes, timings.present + timings.effect + timings.overlay, timings.swap);
+			blitBitmapText(debug_text,x,-y - 28,(uint32_t*)data,pitch / 4, width,height);
+		}
 	
 		double buffer_fill = (double) (currentbuffersize - currentbufferfree) / (double) currentbuffersize;
 		drawGauge(x, y + 30, buffer_fill, width / 2, 8, (uint32_t*)data, pitch / 4);
@@ -4525,7 +4867,7 @@ static void video_refresh_callback_main(const void *data, unsigned width, unsign
 	
 	static int frame_counter = 0;
 	const int max_frames = 8; 
-	if(frame_counter<9) {
+	if(frame_counter<9 && !from_hw) {
 		applyFadeIn((uint32_t **) &data, pitch, width, height, &frame_counter, max_frames);
 	}
 
@@ -4535,9 +4877,13 @@ static void video_refresh_callback_main(const void *data, unsigned width, unsign
 	renderer.src = (void*)data;
 	renderer.dst = screen->pixels;
 	GFX_blitRenderer(&renderer);
+	if (from_hw) GFX_GL_presentHWFrame();
+	if (dupe_frame) GFX_GL_repeatFrame();
+	lastframe_presented = 1;
 
 	screen_flip(screen);
 	last_flip_time = SDL_GetTicks();
+	Startup_traceFirstFrame();
 }
 
 
@@ -4545,34 +4891,102 @@ const void* lastframe = NULL;
 
 static Uint32* rgbaData = NULL;
 static size_t rgbaDataSize = 0;
+static Uint32* lastframe_copy = NULL; // lastframe when the core owns rgbaData again
+static size_t lastframe_copy_size = 0;
+
+// cores that ask for a software framebuffer render straight into rgbaData,
+// in their own pixel format, and it's converted to RGBA8888 in place. 565
+// pixels sit in the back half so the forward conversion never overwrites
+// a pixel it hasn't read yet. either way the core writes each pixel once
+// and the upload reads from the same memory.
+static bool video_software_framebuffer(struct retro_framebuffer* fb) {
+	if (!fb || hw_render.context_type) return false;
+	if (fb->access_flags & RETRO_MEMORY_ACCESS_READ) return false; // last frame has been converted already
+	if (fb->width==0 || fb->height==0) return false;
+
+	size_t size = fb->width * fb->height;
+	if (!rgbaData || rgbaDataSize != size) {
+		// the core can't hold on to the old buffer past this call
+		if (rgbaData) free(rgbaData);
+		rgbaDataSize = size;
+		rgbaData = (Uint32*)malloc(rgbaDataSize * sizeof(Uint32));
+		lastframe = NULL;
+		if (!rgbaData) {
+			rgbaDataSize = 0;
+			return false;
+		}
+	}
+
+	// the core is about to write over the last frame. a dupe of a frame that
+	// reached the gpu is repeated from there without reading it, one that
+	// didn't (skipped under fast forward) has to be kept out of the core's way
+	if (lastframe==rgbaData && !lastframe_presented) {
+		size_t bytes = lastframe_width * lastframe_height * sizeof(Uint32);
+		if (lastframe_copy_size < bytes) {
+			Uint32* grown = (Uint32*)realloc(lastframe_copy, bytes);
+			if (grown) {
+				lastframe_copy = grown;
+				lastframe_copy_size = bytes;
+			}
+		}
+		if (lastframe_copy_size >= bytes) {
+			memcpy(lastframe_copy, rgbaData, bytes);
+			lastframe = lastframe_copy;
+		}
+		else lastframe = NULL;
+	}
+
+	if (fmt == RETRO_PIXEL_FORMAT_XRGB8888) {
+		fb->data = rgbaData;
+		fb->pitch = fb->width * sizeof(uint32_t);
+	}
+	else {
+		fb->data = (uint16_t*)rgbaData + size;
+		fb->pitch = fb->width * sizeof(uint16_t);
+	}
+	fb->format = fmt;
+	fb->memory_flags = RETRO_MEMORY_TYPE_CACHED;
+	return true;
+}
 
 static void video_refresh_callback(const void* data, unsigned width, unsigned height, size_t pitch) {
 
 	// I need to check quit here because sometimes quit is true but callback is still called by the core after and it still runs one more frame and it looks ugly :D
 	if(!quit) {
+		Uint32* stale = NULL; // the core may have rendered this frame into it
 		if (!rgbaData || rgbaDataSize != width * height) {
-			if (rgbaData) free(rgbaData);
+			stale = rgbaData;
 			rgbaDataSize = width * height;
 			rgbaData = (Uint32*)malloc(rgbaDataSize * sizeof(Uint32));
 			if (!rgbaData) {
 				printf("Failed to allocate memory for RGBA8888 data.\n");
+				if (stale) free(stale);
+				rgbaDataSize = 0;
+				lastframe = NULL;
 				return;
 			}
+			if (lastframe==stale) lastframe = NULL;
 		}
 
-		if(!fast_forward && data) {
+		if(!fast_forward && data && data!=RETRO_HW_FRAME_BUFFER_VALID) {
 			if(ambient_mode!=0) {
 				GFX_setAmbientColor(data, width, height,pitch,ambient_mode);
 				LEDS_updateLeds();
 			}
 		}
 
+		dupe_frame = 0;
 		if (!data) {
 			if (lastframe) {
+				// duped frame, the gpu still has it so skip uploading it again
+				dupe_frame = lastframe_presented && lastframe_width==width && lastframe_height==height;
 				data = lastframe;
 			} else {
+				if (stale) free(stale);
 				return; // No data to display
 			}
+		} else if (data == RETRO_HW_FRAME_BUFFER_VALID) {
+			// rendered into the hw fbo, nothing to convert
 		} else if (fmt == RETRO_PIXEL_FORMAT_XRGB8888) {
 			// convert XRGB8888 to RGBA8888
 			const uint32_t* src = (const uint32_t*)data;
@@ -4607,8 +5021,12 @@ static void video_refresh_callback(const void* data, unsigned width, unsigned he
 
 		}
 
+		if (stale) free(stale);
+
 		pitch = width * sizeof(Uint32);
 		lastframe = data;
+		lastframe_width = width;
+		lastframe_height = height;
 		
 		video_refresh_callback_main(data,width,height,pitch);
 	}
@@ -4778,6 +5196,7 @@ void Core_load(void) {
 	// NOTE: must be called after core.load_game!
 	core.set_controller_port_device(0, RETRO_DEVICE_JOYPAD); // set a default, may update after loading configs
 	Core_updateAVInfo();
+	HWRender_init();
 }
 void Core_reset(void) {
 	core.reset();
@@ -4793,6 +5212,7 @@ void Core_quit(void) {
 		SRAM_write();
 		Cheats_free();
 		RTC_write();
+		HWRender_quit();
 		core.unload_game();
 		core.deinit();
 		core.initialized = 0;
@@ -6213,38 +6633,25 @@ static void Menu_updateState(void) {
 	// LOG_info("bmp_path: %s txt_path: %s (%i)\n", menu.bmp_path, menu.txt_path, menu.preview_exists);
 }
 
-typedef struct {
-    char* pixels;
-    char* path;
-	int w;
-	int h;
-} SaveImageArgs;
-
-int save_screenshot_thread(void* data) {
+// the in-game save shortcuts read the frame back without stalling the gpu,
+// it's handed to the preview encoder once it lands a frame or so later
+static char pending_preview_path[256];
+static void Menu_savePreview(unsigned char* pixels, int w, int h, const char* path) {
+	if (!pixels) return;
+	SDL_Surface* capture = SDL_CreateRGBSurfaceWithFormatFrom(pixels, w, h, 32, w * 4, SDL_PIXELFORMAT_ABGR8888);
+	if (capture) GFX_savePreview(capture, pixels, path);
+	else free(pixels);
+}
+static void Menu_finishPreview(int wait) {
+	if (!pending_preview_path[0]) return;
 
-    SaveImageArgs* args = (SaveImageArgs*)data;
-	SDL_Surface* rawSurface = SDL_CreateRGBSurfaceWithFormatFrom(
-		args->pixels, args->w, args->h, 32, args->w * 4, SDL_PIXELFORMAT_ABGR8888
-	);
-	SDL_Surface* converted = SDL_ConvertSurfaceFormat(rawSurface, SDL_PIXELFORMAT_RGBA8888, 0);
-	SDL_FreeSurface(rawSurface);
+	int cw, ch;
+	unsigned char* pixels = GFX_GL_screenCapturePoll(&cw, &ch, wait);
+	if (!pixels && !wait) return;
+	Menu_savePreview(pixels, cw, ch, pending_preview_path);
+	pending_preview_path[0] = '\0';
+}
 
-    SDL_RWops* rw = SDL_RWFromFile(args->path, "wb");
-    if (!rw) {
-        SDL_Log("Failed to open file for writing: %s", SDL_GetError());
-    } else {
-        if (IMG_SavePNG_RW(converted, rw, 1) != 0) {
-            SDL_Log("Failed to save PNG: %s", SDL_GetError());
-        }
-    }
-	LOG_info("saved screenshot\n");
-	SDL_FreeSurface(converted);
-    free(args->path);
-    free(args->pixels);
-    free(args);
-    return 0;
-}
-SDL_Thread* screenshotsavethread;
 static void Menu_saveState(void) {
 	// LOG_info("Menu_saveState\n");
 	Menu_updateState();
@@ -6256,20 +6663,20 @@ static void Menu_saveState(void) {
 	
 	// if already in menu use menu.bitmap instead for saving screenshots otherwise create new one on the fly
 	if (newScreenshot) {
-		int cw, ch;
-		unsigned char* pixels = GFX_GL_screenCapture(&cw, &ch);
-		SaveImageArgs* args = malloc(sizeof(SaveImageArgs));
-		args->pixels = pixels;
-		args->w = cw;
-		args->h = ch;
-		args->path = SDL_strdup(menu.bmp_path); 
-		SDL_WaitThread(screenshotsavethread, NULL);
-		screenshotsavethread = SDL_CreateThread(save_screenshot_thread, "SaveScreenshotThread", args);
+		Menu_finishPreview(1);
+		if (GFX_GL_screenCaptureAsync()) {
+			strcpy(pending_preview_path, menu.bmp_path);
+		}
+		else {
+			int cw, ch;
+			unsigned char* pixels = GFX_GL_screenCapture(&cw, &ch);
+			Menu_savePreview(pixels, cw, ch, menu.bmp_path);
+		}
 		newScreenshot = 0;
 	} else {
-		SDL_RWops* rw = SDL_RWFromFile(menu.bmp_path, "wb");
-		IMG_SavePNG_RW(menu.bitmap, rw,1);
-		LOG_info("saved screenshot\n");
+		// menu.bitmap stays on screen behind the menu, hand the encoder its own copy
+		SDL_Surface* copy = SDL_ConvertSurfaceFormat(menu.bitmap, SDL_PIXELFORMAT_ABGR8888, 0);
+		if (copy) GFX_savePreview(copy, NULL, menu.bmp_path);
 	}
 	
 	state_slot = menu.slot;
@@ -6341,6 +6748,7 @@ static char* getAlias(char* path, char* alias) {
 }
 
 static void Menu_loop(void) {
+	Menu_finishPreview(1); // the slot preview below may be the one still in flight
 
 	int cw, ch;
 	unsigned char* pixels = GFX_GL_screenCapture(&cw, &ch);
@@ -6629,18 +7037,14 @@ static void Menu_loop(void) {
 				
 				if (menu.preview_exists) { // has save, has preview
 					// lotta memory churn here
-					SDL_Surface* bmp = IMG_Load(menu.bmp_path);
-					SDL_Surface* raw_preview = SDL_ConvertSurfaceFormat(bmp, SDL_PIXELFORMAT_RGBA8888,0);
-					if (raw_preview) {
-						SDL_FreeSurface(bmp); 
-						bmp = raw_preview; 
-					}
-					// LOG_info("raw_preview %ix%i\n", raw_preview->w,raw_preview->h);
+					SDL_Surface* bmp = GFX_loadPreview(menu.bmp_path);
 					SDL_Rect preview_rect = {ox,oy,hw,hh};
 					SDL_FillRect(screen, &preview_rect, SDL_MapRGBA(screen->format,0,0,0,255));
-					SDL_BlitScaled(bmp,NULL,preview,NULL);
-					SDL_BlitSurface(preview, NULL, screen, &(SDL_Rect){ox,oy});
-					SDL_FreeSurface(bmp);
+					if (bmp) {
+						SDL_BlitScaled(bmp,NULL,preview,NULL);
+						SDL_BlitSurface(preview, NULL, screen, &(SDL_Rect){ox,oy});
+						SDL_FreeSurface(bmp);
+					}
 				}
 				else {
 					SDL_Rect preview_rect = {ox,oy,hw,hh};
@@ -6691,6 +7095,7 @@ static void Menu_loop(void) {
 		GFX_clear(screen);
 
 		setOverclock(overclock); // restore overclock value
+		PWR_cpuBoost(CPU_BOOST_FRAMES); // the first frames back redraw everything
 		if (rumble_strength) VIB_setStrength(rumble_strength);
 		
 		if (!HAS_POWER_BUTTON) PWR_disableSleep();
@@ -6746,6 +7151,22 @@ static void chooseSyncRef(void) {
 		  use_core_fps ? "yes" : "no");
 }
 
+// the platform governor picks the clock from how long core.run() (emulation
+// plus present) took against the frame budget. it's wall time, so work the
+// core hands to its own threads and waits on still counts, minus the pacing
+// and vsync wait in the present which isn't load.
+static void CPU_frame(uint64_t busy) {
+	double fps = core.fps>0 ? core.fps : SCREEN_FPS;
+	if (fast_forward) {
+		if (!max_ff_speed) {
+			PWR_cpuBoost(1); // unthrottled, as fast as it goes
+			return;
+		}
+		fps *= max_ff_speed + 1;
+	}
+	PWR_cpuFrame(busy, 1000000 / fps);
+}
+
 static void trackFPS(void) {
 	cpu_ticks += 1;
 	static int last_use_ticks = 0;
@@ -6825,8 +7246,38 @@ void onBluetoothAudioChanged(bool bluetooth, int watch_event)
 		LOG_error("asoundrc is not deleted yet!!!\n");
 }
 
+// everything here only touches the filesystem and the core's own (not yet
+// initialized) state so it can overlap with video and shader setup on the
+// main thread, the core itself is still initialized and loaded on the main
+// thread once this has been joined
+typedef struct StartupJob {
+	const char* core_path;
+	const char* tag_name;
+	const char* rom_path;
+} StartupJob;
+static void* Startup_loadThread(void* arg) {
+	StartupJob* job = arg;
+	int t;
+
+	t = Startup_traceBegin("Core_open", "worker");
+	Core_open(job->core_path, job->tag_name);
+	Startup_traceEnd(t);
+
+	t = Startup_traceBegin("Game_open", "worker");
+	Game_open((char*)job->rom_path); // nes tries to load gamegenie setting before this returns ffs
+	Startup_traceEnd(t);
+	if (!game.is_open) return NULL;
+
+	t = Startup_traceBegin("Config_load", "worker");
+	Config_load(); // before init?
+	Startup_traceEnd(t);
+	return NULL;
+}
+
 int main(int argc , char* argv[]) {
+	startup.launch = getMicroseconds();
 	LOG_info("MinArch\n");
+	THREAD_register(THREAD_EMULATION); // core.run() and the video callback run here
 
 	static char asoundpath[MAX_PATH];
 	sprintf(asoundpath, "%s/.asoundrc", getenv("HOME"));
@@ -6836,9 +7287,6 @@ int main(int argc , char* argv[]) {
 	else 
 		LOG_info("asoundrc does not exist at %s\n", asoundpath);
 
-	pthread_t cpucheckthread;
-    pthread_create(&cpucheckthread, NULL, PLAT_cpu_monitor, NULL);
-
 	setOverclock(overclock); // default to normal
 	// force a stack overflow to ensure asan is linked and actually working
 	// char tmp[2];
@@ -6857,10 +7305,20 @@ int main(int argc , char* argv[]) {
 	
 	LOG_info("rom_path: %s\n", rom_path);
 	
+	// open the core, read/extract the rom and parse config while the gl context and default shaders are set up
+	StartupJob startup_job = {core_path, tag_name, rom_path};
+	pthread_t startup_pt;
+	int threaded_startup = pthread_create(&startup_pt, NULL, Startup_loadThread, &startup_job)==0;
+	if (!threaded_startup) Startup_loadThread(&startup_job);
+
+	int t = Startup_traceBegin("GFX_init", "main");
 	screen = GFX_init(MODE_MENU);
+	Startup_traceEnd(t);
 
 	// initialize default shaders
+	t = Startup_traceBegin("GFX_initShaders", "main");
 	GFX_initShaders();
+	Startup_traceEnd(t);
 
 	PAD_init();
 	DEVICE_WIDTH = screen->w;
@@ -6874,39 +7332,51 @@ int main(int argc , char* argv[]) {
 		PWR_disableSleep();
 	MSG_init();
 	IMG_Init(IMG_INIT_PNG);
-	Core_open(core_path, tag_name);
+
+	if (threaded_startup) {
+		t = Startup_traceBegin("join", "main");
+		pthread_join(startup_pt, NULL);
+		Startup_traceEnd(t);
+	}
 
 	fmt = RETRO_PIXEL_FORMAT_XRGB8888;
 	environment_callback(RETRO_ENVIRONMENT_SET_PIXEL_FORMAT, &fmt);
 
-	Game_open(rom_path); // nes tries to load gamegenie setting before this returns ffs
 	if (!game.is_open) goto finish;
 	
 	simple_mode = exists(SIMPLE_MODE_PATH);
 	
-	// restore options
-	Config_load(); // before init?
+	// restore options (loaded by Startup_loadThread)
 	Config_init();
 	Config_readOptions(); // cores with boot logo option (eg. gb) need to load options early
 	setOverclock(overclock);
+	THREAD_setProfile(thread_profile); // the default when the config doesn't set one
 	
+	t = Startup_traceBegin("Core_init", "main");
 	Core_init();
+	Startup_traceEnd(t);
 
 	// TODO: find a better place to do this
 	// mixing static and loaded data is messy
 	// why not move to Core_init()?
 	// ah, because it's defined before options_menu...
 	options_menu.items[1].desc = (char*)core.version;
+	t = Startup_traceBegin("Core_load", "main");
 	Core_load();
+	Startup_traceEnd(t);
 	Input_init(NULL);
 	Config_readOptions(); // but others load and report options later (eg. nes)
 	Config_readControls(); // restore controls (after the core has reported its defaults)
 
+	t = Startup_traceBegin("SND_init", "main");
 	SND_init(core.sample_rate, core.fps);
+	Startup_traceEnd(t);
 	BT_registerDeviceWatcher(onBluetoothAudioChanged);
 	InitSettings(); // after we initialize audio
 	Menu_init();
+	t = Startup_traceBegin("State_resume", "main");
 	State_resume();
+	Startup_traceEnd(t);
 	Menu_initState(); // make ready for state shortcuts
 
 	PWR_warn(1);
@@ -6936,9 +7406,12 @@ int main(int argc , char* argv[]) {
 
 	// then initialize custom  shaders from settings
 	
+	t = Startup_traceBegin("initShaders", "main");
 	initShaders();
 	Config_readOptions();
 	applyShaderSettings();
+	Startup_traceEnd(t);
+	GFX_precompileShaders(); // so switching shaders from the menu doesn't compile
 	// release config when all is loaded
 	Config_free();
 
@@ -6946,9 +7419,14 @@ int main(int argc , char* argv[]) {
 	while (!quit) {
 		GFX_startFrame();
 	
+		uint64_t frame_begin = getMicroseconds();
 		core.run();
+		uint64_t frame_busy = getMicroseconds() - frame_begin;
+		uint64_t frame_waited = GFX_frameWaited();
+		CPU_frame(frame_busy > frame_waited ? frame_busy - frame_waited : 0);
 		limitFF();
 		trackFPS();
+		Menu_finishPreview(0);
 		
 
 		if (has_pending_opt_change) {
@@ -6979,6 +7457,7 @@ int main(int argc , char* argv[]) {
 
 		hdmimon();
 	}
+	Menu_finishPreview(1);
 	int cw, ch;
 	unsigned char* pixels = GFX_GL_screenCapture(&cw, &ch);
 	
@@ -7018,6 +7497,6 @@ finish:
 	//SND_quit();
 	PAD_quit();
 	GFX_quit();
-	SDL_WaitThread(screenshotsavethread, NULL);
+	GFX_waitPreview();
 	return EXIT_SUCCESS;
 }
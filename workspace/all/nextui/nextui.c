@@ -2152,9 +2152,6 @@ int main (int argc, char *argv[]) {
 	int was_online = PLAT_isOnline();
     int had_bt = PLAT_btIsConnected();
 
-	pthread_t cpucheckthread;
-    pthread_create(&cpucheckthread, NULL, PLAT_cpu_monitor, NULL);
-
 	int selected_row = top->selected - top->start;
 	float targetY;
 	float previousY;
@@ -2173,9 +2170,18 @@ int main (int argc, char *argv[]) {
 	SDL_UnlockMutex(animMutex);
 
 	//LOG_info("Start time time %ims\n",SDL_GetTicks());
+	// the whole launcher (loader and animation threads too) against wall time feeds the cpu governor
+	uint64_t frame_cpu = getCPUMicroseconds(CLOCK_PROCESS_CPUTIME_ID);
+	uint64_t frame_wall = getMicroseconds();
 	while (!quit) {
 		GFX_startFrame();
 		unsigned long now = SDL_GetTicks();
+
+		uint64_t cpu = getCPUMicroseconds(CLOCK_PROCESS_CPUTIME_ID);
+		uint64_t wall = getMicroseconds();
+		PWR_cpuFrame(cpu - frame_cpu, wall - frame_wall);
+		frame_cpu = cpu;
+		frame_wall = wall;
 		
 		PAD_poll();
 			
@@ -2703,12 +2709,7 @@ int main (int argc, char *argv[]) {
 					if(has_preview) {
 						// lotta memory churn here
 					
-						SDL_Surface* bmp = IMG_Load(preview_path);
-						SDL_Surface* raw_preview = SDL_ConvertSurfaceFormat(bmp, SDL_PIXELFORMAT_RGBA8888, 0);
-						if (raw_preview) {
-							SDL_FreeSurface(bmp); 
-							bmp = raw_preview; 
-						}
+						SDL_Surface* bmp = GFX_loadPreview(preview_path);
 						if(bmp) {
 							int aw = screen->w;
 							int ah = screen->h;
@@ -0,0 +1,426 @@
+// scalerbench: times every software scaler in scaler.c, the scaleAA blender,
+// the frame copy and the RGBA4444 blit over the source resolutions cores
+// actually produce, scaled into the device's output size. results are one csv
+// row per kernel/source so runs from different builds and devices can be
+// diffed or plotted directly.
+//
+// --verify compares every accelerated kernel against the C reference instead
+// of timing, for every factor and both depths, and exits non-zero on mismatch.
+//
+// usage: scalerbench.elf [--verify] [--ms N] [--size WxH] [--filter name]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "defines.h"
+#include "api.h"
+#include "utils.h"
+#include "scaler.h"
+
+// scaler.c's neon scalers and memcpy_neon are armv7 assembly (HAS_NEON), an
+// aarch64 build like tg5040's has neon but none of those kernels to time
+#if defined(HAS_NEON) && (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(__aarch64__)
+#define BENCH_NEON
+#endif
+
+#define BENCH_MS 250 // per kernel/source, after warmup
+#define BENCH_MIN_FRAMES 10
+#define BENCH_WARMUP 3
+
+static struct {
+	const char* name;
+	int w;
+	int h;
+} sources[] = {
+	{"gb",    160, 144},
+	{"gba",   240, 160},
+	{"snes",  256, 224},
+	{"ps1",   320, 240},
+	{"ps1hi", 640, 480},
+};
+#define SOURCE_COUNT (sizeof(sources) / sizeof(sources[0]))
+
+// the generic C/NEON/x86 entry points all share this signature
+typedef void (*generic_scaler_t)(uint32_t xmul, uint32_t ymul, void* __restrict src, void* __restrict dst, uint32_t sw, uint32_t sh, uint32_t sp, uint32_t dw, uint32_t dh, uint32_t dp);
+
+typedef struct Impl {
+	const char* name;
+	int bpp;
+	generic_scaler_t scaler;
+	int level; // x86 level to pin while running, -1 for none
+} Impl;
+
+static Impl impls[] = {
+	{"c",    16, scaler_c16, -1},
+	{"c",    32, scaler_c32, -1},
+#ifdef BENCH_NEON
+	{"neon", 16, scaler_n16, -1},
+	{"neon", 32, scaler_n32, -1},
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+	{"sse2", 16, scaler_x16, SCALER_X86_SSE2},
+	{"sse2", 32, scaler_x32, SCALER_X86_SSE2},
+	{"avx2", 16, scaler_x16, SCALER_X86_AVX2},
+	{"avx2", 32, scaler_x32, SCALER_X86_AVX2},
+#endif
+};
+#define IMPL_COUNT (sizeof(impls) / sizeof(impls[0]))
+
+static struct {
+	int ms;
+	int out_w;
+	int out_h;
+	const char* filter;
+} bench = { BENCH_MS, 0, 0, NULL };
+
+static uint64_t nowNs(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void fillPattern(void* buffer, size_t size, uint32_t seed) {
+	// xorshift so every row differs and a kernel reading the wrong row shows up in --verify
+	uint32_t* words = buffer;
+	uint32_t x = seed ? seed : 0x9e3779b9;
+	for (size_t i=0; i<size/4; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		words[i] = x;
+	}
+}
+
+// ymul limits per xmul, matching the tables in scaler_c16/c32
+static int maxYmul(int xmul) {
+	return xmul < 5 ? 4 : xmul;
+}
+
+static void pinImpl(Impl* impl) {
+#if defined(__x86_64__) || defined(__i386__)
+	scaler_x86_force(impl->level);
+#endif
+}
+static void unpinImpl(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	scaler_x86_force(-1); // back to picking the widest on next use
+#endif
+}
+
+static int isImplSupported(Impl* impl) {
+#if defined(__x86_64__) || defined(__i386__)
+	if (impl->level>=0) {
+		scaler_x86_force(impl->level);
+		int supported = scaler_x86_level()==impl->level;
+		unpinImpl();
+		return supported;
+	}
+#endif
+	return 1;
+}
+
+// --filter matches any of the kernel, impl or source names
+static int isFiltered(const char* kernel, const char* impl, const char* source) {
+	if (!bench.filter) return 0;
+	return !strstr(kernel, bench.filter) && !strstr(impl, bench.filter) && !strstr(source, bench.filter);
+}
+
+///////////////////////////////
+// timing
+
+typedef struct Job {
+	void (*run)(struct Job* job);
+	void* src;
+	void* dst;
+	int sw, sh, sp;
+	int dw, dh, dp;
+	int xmul, ymul;
+	generic_scaler_t scaler;
+	scaler_t aa;
+	SDL_Surface* surface_src;
+	SDL_Surface* surface_dst;
+	SDL_Rect rect;
+} Job;
+
+static void runScaler(Job* job) {
+	job->scaler(job->xmul, job->ymul, job->src, job->dst, job->sw, job->sh, job->sp, job->dw, job->dh, job->dp);
+}
+static void runAA(Job* job) {
+	job->aa(job->src, job->dst, job->sw, job->sh, job->sp, job->dw, job->dh, job->dp);
+}
+static void runMemcpy(Job* job) {
+	memcpy(job->dst, job->src, job->sp * job->sh);
+}
+#ifdef BENCH_NEON
+static void runMemcpyNeon(Job* job) {
+	memcpy_neon(job->dst, job->src, job->sp * job->sh);
+}
+#endif
+static void runBlit4444(Job* job) {
+	BlitRGBA4444toRGB565(job->surface_src, job->surface_dst, &job->rect);
+}
+
+static void printHeader(void) {
+	printf("kernel,impl,bpp,source,src_w,src_h,dst_w,dst_h,frames,ns_per_frame,min_ns,mpix_per_s\n");
+}
+
+static void timeJob(Job* job, const char* kernel, const char* impl, int bpp, const char* source, int out_w, int out_h) {
+	for (int i=0; i<BENCH_WARMUP; i++) job->run(job);
+
+	uint64_t budget = (uint64_t)bench.ms * 1000000ULL;
+	uint64_t total = 0;
+	uint64_t best = UINT64_MAX;
+	int frames = 0;
+	while (total<budget || frames<BENCH_MIN_FRAMES) {
+		uint64_t start = nowNs();
+		job->run(job);
+		uint64_t elapsed = nowNs() - start;
+		total += elapsed;
+		if (elapsed<best) best = elapsed;
+		frames += 1;
+	}
+
+	double ns = (double)total / frames;
+	double mpix = (double)out_w * out_h / ns * 1000.0; // pixels per ns * 1000 = Mpixels/s
+	printf("%s,%s,%i,%s,%i,%i,%i,%i,%i,%.0f,%llu,%.1f\n", kernel, impl, bpp, source,
+		job->sw, job->sh, out_w, out_h, frames, ns, (unsigned long long)best, mpix);
+	fflush(stdout);
+}
+
+static void benchScalers(void* src, void* dst, int index) {
+	const char* source = sources[index].name;
+	int sw = sources[index].w;
+	int sh = sources[index].h;
+	char kernel[16];
+
+	for (int i=0; i<IMPL_COUNT; i++) {
+		Impl* impl = &impls[i];
+		if (!isImplSupported(impl)) continue;
+		pinImpl(impl);
+
+		int px = impl->bpp / 8;
+		for (int xmul=1; xmul<=6; xmul++) {
+			for (int ymul=1; ymul<=maxYmul(xmul); ymul++) {
+				int dw = sw * xmul;
+				int dh = sh * ymul;
+				if (dw>bench.out_w || dh>bench.out_h) continue;
+
+				sprintf(kernel, "scale%ix%i", xmul, ymul);
+				if (isFiltered(kernel, impl->name, source)) continue;
+
+				Job job = {
+					.run = runScaler, .src = src, .dst = dst,
+					.sw = sw, .sh = sh, .sp = sw * px,
+					.dw = dw, .dh = dh, .dp = bench.out_w * px,
+					.xmul = xmul, .ymul = ymul, .scaler = impl->scaler,
+				};
+				timeJob(&job, kernel, impl->name, impl->bpp, source, dw, dh);
+			}
+		}
+	}
+	unpinImpl();
+}
+
+// the kernel GFX_getAAScaler32 picks at compile time
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define AA32_IMPL "neon"
+#elif defined(__SSE2__)
+#define AA32_IMPL "sse2"
+#else
+#define AA32_IMPL "c"
+#endif
+
+static void benchAA(void* src, void* dst, int index) {
+	// aspect fit like the renderer does for non-integer scaling
+	int sw = sources[index].w;
+	int sh = sources[index].h;
+	int dw = bench.out_w;
+	int dh = bench.out_w * sh / sw;
+	if (dh>bench.out_h) {
+		dh = bench.out_h;
+		dw = bench.out_h * sw / sh;
+	}
+
+	GFX_Renderer renderer = {
+		.src_w = sw, .src_h = sh,
+		.dst_w = dw, .dst_h = dh,
+	};
+	Job job = {
+		.run = runAA, .src = src, .dst = dst,
+		.sw = sw, .sh = sh,
+		.dw = dw, .dh = dh,
+	};
+
+	if (!isFiltered("scaleAA", "c", sources[index].name)) {
+		job.sp = sw * 2;
+		job.dp = bench.out_w * 2;
+		job.aa = GFX_getAAScaler(&renderer);
+		timeJob(&job, "scaleAA", "c", 16, sources[index].name, dw, dh);
+	}
+	if (!isFiltered("scaleAA", AA32_IMPL, sources[index].name)) {
+		job.sp = sw * 4;
+		job.dp = bench.out_w * 4;
+		job.aa = GFX_getAAScaler32(&renderer);
+		if (job.aa) timeJob(&job, "scaleAA", AA32_IMPL, 32, sources[index].name, dw, dh);
+	}
+	GFX_freeAAScaler();
+}
+
+static void benchCopies(void* src, void* dst, int index) {
+	int sw = sources[index].w;
+	int sh = sources[index].h;
+
+	// the per-frame copy of a 32bpp source
+	Job job = {
+		.src = src, .dst = dst,
+		.sw = sw, .sh = sh, .sp = sw * 4,
+	};
+	if (!isFiltered("memcpy", "libc", sources[index].name)) {
+		job.run = runMemcpy;
+		timeJob(&job, "memcpy", "libc", 32, sources[index].name, sw, sh);
+	}
+#ifdef BENCH_NEON
+	if (!isFiltered("memcpy", "neon", sources[index].name)) {
+		job.run = runMemcpyNeon;
+		timeJob(&job, "memcpy", "neon", 32, sources[index].name, sw, sh);
+	}
+#endif
+
+	if (isFiltered("blit4444", "c", sources[index].name)) return;
+	SDL_Surface* from = SDL_CreateRGBSurfaceWithFormat(0, sw, sh, 16, SDL_PIXELFORMAT_RGBA4444);
+	SDL_Surface* to = SDL_CreateRGBSurfaceWithFormat(0, bench.out_w, bench.out_h, 16, SDL_PIXELFORMAT_RGB565);
+	if (!from || !to) {
+		LOG_error("surface alloc failed: %s\n", SDL_GetError());
+	}
+	else {
+		fillPattern(from->pixels, from->pitch * sh, index + 1);
+		job.run = runBlit4444;
+		job.surface_src = from;
+		job.surface_dst = to;
+		job.rect = (SDL_Rect){ (bench.out_w - sw) / 2, (bench.out_h - sh) / 2, sw, sh };
+		timeJob(&job, "blit4444", "c", 16, sources[index].name, sw, sh);
+	}
+	if (from) SDL_FreeSurface(from);
+	if (to) SDL_FreeSurface(to);
+}
+
+///////////////////////////////
+// verification
+
+static int verify(void* src, void* ref, void* out, size_t size) {
+	// odd widths and short heights exercise the scalar tails of the vector kernels
+	static const struct { int w; int h; } extra[] = {
+		{1, 1}, {7, 3}, {33, 5}, {161, 9},
+	};
+	int failures = 0;
+	int checked = 0;
+
+	for (int i=0; i<IMPL_COUNT; i++) {
+		Impl* impl = &impls[i];
+		if (impl->scaler==scaler_c16 || impl->scaler==scaler_c32) continue;
+		if (!isImplSupported(impl)) {
+			printf("verify,%s,%i,skipped (unsupported cpu)\n", impl->name, impl->bpp);
+			continue;
+		}
+		generic_scaler_t reference = impl->bpp==16 ? scaler_c16 : scaler_c32;
+		int px = impl->bpp / 8;
+
+		for (int s=0; s<SOURCE_COUNT+sizeof(extra)/sizeof(extra[0]); s++) {
+			int sw = s<SOURCE_COUNT ? sources[s].w : extra[s-SOURCE_COUNT].w;
+			int sh = s<SOURCE_COUNT ? sources[s].h : extra[s-SOURCE_COUNT].h;
+			for (int xmul=1; xmul<=6; xmul++) {
+				for (int ymul=1; ymul<=maxYmul(xmul); ymul++) {
+					int dw = sw * xmul;
+					int dh = sh * ymul;
+					if (dw>bench.out_w || dh>bench.out_h) continue;
+
+					// identical backgrounds so writes past the scaled area also differ
+					memset(ref, 0xa5, size);
+					memset(out, 0xa5, size);
+					reference(xmul, ymul, src, ref, sw, sh, sw * px, dw, dh, bench.out_w * px);
+					pinImpl(impl);
+					impl->scaler(xmul, ymul, src, out, sw, sh, sw * px, dw, dh, bench.out_w * px);
+					unpinImpl();
+
+					checked += 1;
+					if (memcmp(ref, out, size)) {
+						printf("verify,%s,%i,scale%ix%i %ix%i,FAIL\n", impl->name, impl->bpp, xmul, ymul, sw, sh);
+						failures += 1;
+					}
+				}
+			}
+		}
+	}
+	printf("verify,%i checked,%i failed\n", checked, failures);
+	return failures;
+}
+
+///////////////////////////////
+
+static void usage(const char* name) {
+	fprintf(stderr, "usage: %s [--verify] [--ms N] [--size WxH] [--filter name]\n", name);
+}
+
+int main(int argc, char* argv[]) {
+	// FIXED_WIDTH follows is_brick which is only set once input is up, pass --size to override
+	bench.out_w = FIXED_WIDTH;
+	bench.out_h = FIXED_HEIGHT;
+
+	int verifying = 0;
+	for (int i=1; i<argc; i++) {
+		if (exactMatch(argv[i], "--verify")) verifying = 1;
+		else if (exactMatch(argv[i], "--ms") && i+1<argc) bench.ms = atoi(argv[++i]);
+		else if (exactMatch(argv[i], "--size") && i+1<argc) sscanf(argv[++i], "%ix%i", &bench.out_w, &bench.out_h);
+		else if (exactMatch(argv[i], "--filter") && i+1<argc) bench.filter = argv[++i];
+		else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (bench.ms<=0 || bench.out_w<=0 || bench.out_h<=0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	// big enough for the largest 32bpp source and the full output at 32bpp
+	size_t src_size = 640 * 480 * 4;
+	size_t dst_size = (size_t)bench.out_w * bench.out_h * 4;
+	void* src = malloc(src_size);
+	void* dst = malloc(dst_size);
+	void* ref = verifying ? malloc(dst_size) : NULL;
+	if (!src || !dst || (verifying && !ref)) {
+		LOG_error("buffer alloc failed\n");
+		return 1;
+	}
+	fillPattern(src, src_size, 1);
+	memset(dst, 0, dst_size);
+
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(BENCH_NEON)
+	fprintf(stderr, "neon scalers and memcpy_neon not built, they're armv7 assembly (scaleAA 32bpp still uses neon)\n");
+#endif
+
+	int status = 0;
+	if (verifying) {
+		status = verify(src, ref, dst, dst_size) ? 1 : 0;
+	}
+	else {
+#if defined(__x86_64__) || defined(__i386__)
+		fprintf(stderr, "x86 scaler level %i\n", scaler_x86_level());
+#endif
+		// stdout is kept to csv only
+		fprintf(stderr, "output %ix%i, %ims per kernel\n", bench.out_w, bench.out_h, bench.ms);
+		printHeader();
+		for (int i=0; i<SOURCE_COUNT; i++) {
+			benchScalers(src, dst, i);
+			benchAA(src, dst, i);
+			benchCopies(src, dst, i);
+		}
+	}
+
+	free(src);
+	free(dst);
+	free(ref);
+	return status;
+}
@@ -13,6 +13,12 @@ typedef std::shared_lock<Lock> ReadLock;
 using namespace Bluetooth;
 using namespace std::placeholders;
 
+namespace
+{
+    // the platform callback carries no context, there is only one of these menus
+    Menu *eventTarget = nullptr;
+}
+
 Menu::Menu(const int &globalQuit, int &globalDirty) : MenuList(MenuItemType::Fixed, "Network", {}), globalQuit(globalQuit), globalDirty(globalDirty)
 {
     toggleItem = new MenuItem(ListItemType::Generic, "Bluetooth", "Enable/disable Bluetooth", {false, true}, {"Off", "On"},
@@ -35,19 +41,41 @@ Menu::Menu(const int &globalQuit, int &globalDirty) : MenuList(MenuItemType::Fix
     MenuList::performLayout((SDL_Rect){0, 0, FIXED_WIDTH, FIXED_HEIGHT});
     layout_called = false;
 
+    eventTarget = this;
+    BT_registerEventWatcher(&Menu::onEvent);
     worker = std::thread{&Menu::updater, this};
 }
 
 Menu::~Menu()
 {
-    quit = true;
+    BT_removeEventWatcher();
+    {
+        std::lock_guard<std::mutex> lk(wakeLock);
+        quit = true;
+    }
+    wake.notify_one();
     if (worker.joinable())
         worker.join();
+    eventTarget = nullptr;
 }
 
 InputReactionHint Menu::handleInput(int &dirty, int &quit)
 {
+    // we only get input while on screen
+    if (!visible)
+        setVisible(true);
+
     auto ret = MenuList::handleInput(dirty, quit);
+
+    // list changes are held back while an options submenu is open
+    bool open = anySubmenuOpen();
+    if (submenuOpen && !open)
+        notify();
+    submenuOpen = open;
+
+    if (quit)
+        setVisible(false);
+
     if (selectionDirty)
     {
         dirty = true;
@@ -65,6 +93,7 @@ std::any Menu::getBtToggleState() const
 void Menu::setBtToggleState(const std::any &on)
 {
     BT_enable(std::any_cast<bool>(on));
+    notify();
 }
 
 void Menu::resetBtToggleState()
@@ -102,129 +131,198 @@ void Menu::resetSamplerateMaximum()
     CFG_setBluetoothSamplingrateLimit(CFG_DEFAULT_BLUETOOTH_MAXRATE);
 }
 
-template <typename Map>
-bool key_compare(Map const &lhs, Map const &rhs)
+void Menu::notify()
 {
-    return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin(),
-                                                  [](auto a, auto b)
-                                                  { return a.first == b.first; });
+    {
+        std::lock_guard<std::mutex> lk(wakeLock);
+        pending = true;
+    }
+    wake.notify_one();
 }
 
-void Menu::updater()
+void Menu::setVisible(bool on)
 {
-    int pollSecs = 15;
+    {
+        std::lock_guard<std::mutex> lk(wakeLock);
+        visible = on;
+        pending = true;
+    }
+    wake.notify_one();
+}
 
-    while (!quit && !globalQuit)
+void Menu::onEvent(int event)
+{
+    // rssi changes dont come through here, only devices coming and going
+    // and connection state, which is all the list needs
+    if (eventTarget)
+        eventTarget->notify();
+}
+
+bool Menu::anySubmenuOpen()
+{
+    ReadLock r(itemLock);
+    for (auto i : items)
+        if (i->isDeferred())
+            return true;
+    return false;
+}
+
+void Menu::refresh()
+{
+    std::map<std::string, BT_devicePaired> pairedMap;
+    std::map<std::string, BT_device> scanMap;
+    if (BT_enabled())
+    {
+        if(!BT_discovering())
+            BT_discovery(true);
+
+        std::vector<BT_devicePaired> kl(SCAN_MAX_RESULTS);
+        int known = BT_pairedDevices(kl.data(), SCAN_MAX_RESULTS);
+        for (int i = 0; i < known; i++)
+            pairedMap.emplace(kl[i].remote_name, kl[i]);
+
+        std::vector<BT_device> sr(SCAN_MAX_RESULTS);
+        int cnt = BT_availableDevices(sr.data(), SCAN_MAX_RESULTS);
+        for (int i = 0; i < cnt; i++)
+            scanMap.emplace(sr[i].name, sr[i]);
+    }
+
+    // remember selection and restore
+    std::string selectedName;
+    bool relayout = false;
     {
-        // TODO: pause when menu is not rendered
-        // TODO: improve repaint logic in a way that remembers selection
-        // Scan
-        if (BT_enabled())
+        WriteLock w(itemLock);
+
+        bool menuOpen = false;
+        for (auto i : items)
+            menuOpen |= i->isDeferred();
+        selectedName = getSelectedItemName();
+
+        std::map<std::string, PairableItem *> nextAvailable;
+        for (auto &[s, r] : scanMap)
+        {
+            auto it = available.find(s);
+            if (it != available.end())
+            {
+                if (it->second->update(r))
+                    selectionDirty = true;
+                nextAvailable[s] = it->second;
+                continue;
+            }
+            if (menuOpen)
+                continue;
+
+            MenuList *options;
+            options = new MenuList(MenuItemType::List, "Options", {new PairNewItem(r, selectionDirty)});
+            nextAvailable[s] = new PairableItem{r, options};
+            relayout = true;
+        }
+
+        std::map<std::string, PairedItem *> nextPaired;
+        for (auto &[s, r] : pairedMap)
         {
-            if(!BT_discovering())
-                BT_discovery(true);
-
-            std::map<std::string, BT_devicePaired> pairedMap;
-            std::vector<BT_devicePaired> kl(SCAN_MAX_RESULTS);
-            int known = BT_pairedDevices(kl.data(), SCAN_MAX_RESULTS);
-            for (int i = 0; i < known; i++)
-                pairedMap.emplace(kl[i].remote_name, kl[i]);
-
-            // grab list and compare it to previous result
-            // only relayout the menu if changes happended
-            std::map<std::string, BT_device> scanMap;
-            std::vector<BT_device> sr(SCAN_MAX_RESULTS);
-            int cnt = BT_availableDevices(sr.data(), SCAN_MAX_RESULTS);
-            for (int i = 0; i < cnt; i++)
-                scanMap.emplace(sr[i].name, sr[i]);
-
-            // dont repopulate if any submenu is open
-            bool menuOpen = false;
-            for (auto i : items)
+            // options depend on the connection state, anything else is refreshed in place
+            auto it = paired.find(s);
+            if (it != paired.end() && it->second->isConnected() == r.is_connected)
             {
-                if (i->isDeferred())
-                {
-                    menuOpen = true;
-                    break;
-                }
+                if (it->second->update(r))
+                    selectionDirty = true;
+                nextPaired[s] = it->second;
+                continue;
             }
+            if (menuOpen)
+                continue;
 
-            // something changed?
-            if (!menuOpen)
+            MenuList *options;
+            if (r.is_connected)
             {
-                // remember selection and restore
-                std::string selectedName;
-                bool selectionApplied = false;
-
-                {
-                    WriteLock w(itemLock);
-                    selectedName = getSelectedItemName();
-                    items.clear();
-                    items.push_back(toggleItem);
-                    items.push_back(diagItem);
-                    items.push_back(rateItem);
-                    layout_called = false;
-
-                    for (auto &[s, r] : scanMap)
-                    {
-                        MenuList *options;
-                        options = new MenuList(MenuItemType::List, "Options", {new PairNewItem(r, selectionDirty)});
-                        auto itm = new PairableItem{r, options};
-                        items.push_back(itm);
-                    }
-
-                    for (auto &[s, r] : pairedMap)
-                    {
-                        MenuList *options;
-                        if (r.is_connected)
-                        {
-                            options = new MenuList(MenuItemType::List, "Options", {
-                                                                                    new DisconnectKnownItem(r, selectionDirty),
-                                                                                    new UnpairItem(r, selectionDirty),
-                                                                                });
-                        }
-                        else
-                        {
-                            options = new MenuList(MenuItemType::List, "Options", {
-                                                                                    new ConnectKnownItem(r, selectionDirty),
-                                                                                    new UnpairItem(r, selectionDirty),
-                                                                                });
-                        }
-                        auto itm = new PairedItem{r, options};
-                        itm->setDesc(std::string(r.remote_addr) + " | " + std::to_string(r.rssi));
-                        items.push_back(itm);
-                    }
-                }
-                MenuList::performLayout((SDL_Rect){0, 0, FIXED_WIDTH, FIXED_HEIGHT});
-
-                // Attempt to restore prev selection
-                selectionApplied = selectByName(selectedName);
-                globalDirty |= selectionApplied;
-                // If selection was restored, we already called performLayout internally
-                selectionDirty |= !selectionApplied;
+                options = new MenuList(MenuItemType::List, "Options", {
+                                                                        new DisconnectKnownItem(r, selectionDirty),
+                                                                        new UnpairItem(r, selectionDirty),
+                                                                    });
             }
-            pollSecs = 2;
+            else
+            {
+                options = new MenuList(MenuItemType::List, "Options", {
+                                                                        new ConnectKnownItem(r, selectionDirty),
+                                                                        new UnpairItem(r, selectionDirty),
+                                                                    });
+            }
+            nextPaired[s] = new PairedItem{r, options};
+            relayout = true;
         }
-        else
+
+        // dont touch the list structure while any submenu is open
+        if (menuOpen)
+            return;
+
+        // drop whatever went away or got replaced above
+        for (auto &[s, itm] : available)
+        {
+            auto it = nextAvailable.find(s);
+            if (it == nextAvailable.end() || it->second != itm)
+            {
+                delete itm->getSubMenu();
+                delete itm;
+                relayout = true;
+            }
+        }
+        for (auto &[s, itm] : paired)
+        {
+            auto it = nextPaired.find(s);
+            if (it == nextPaired.end() || it->second != itm)
+            {
+                delete itm->getSubMenu();
+                delete itm;
+                relayout = true;
+            }
+        }
+        available = nextAvailable;
+        paired = nextPaired;
+
+        if (relayout)
         {
-            WriteLock w(itemLock);
             items.clear();
             items.push_back(toggleItem);
             items.push_back(diagItem);
             items.push_back(rateItem);
+            for (auto &[s, itm] : available)
+                items.push_back(itm);
+            for (auto &[s, itm] : paired)
+                items.push_back(itm);
             layout_called = false;
-            selectionDirty = true;
-            pollSecs = 15;
         }
+    }
 
-        // reset selection scope (locks internally)
-        if (selectionDirty)
-        {
+    if (relayout)
+    {
+        // reset selection scope (locks internally), keeping the selected item if it is still around
+        if (!selectByName(selectedName))
             MenuList::performLayout((SDL_Rect){0, 0, FIXED_WIDTH, FIXED_HEIGHT});
-            selectionDirty = false;
+        selectionDirty = true;
+    }
+}
+
+void Menu::updater()
+{
+    std::unique_lock<std::mutex> lk(wakeLock);
+    while (!quit && !globalQuit)
+    {
+        // nothing to do while nobody is looking, and no reason to keep the radio discovering
+        if (!visible)
+        {
+            if (BT_enabled() && BT_discovering())
+                BT_discovery(false);
+            wake.wait(lk, [&] { return quit || visible; });
+            continue;
         }
 
-        std::this_thread::sleep_for(std::chrono::seconds(pollSecs));
+        pending = false;
+        lk.unlock();
+        refresh();
+        lk.lock();
+
+        wake.wait(lk, [&] { return quit || !visible || pending; });
     }
 }
 
@@ -268,6 +366,14 @@ PairableItem::PairableItem(BT_device d, MenuList* submenu)
     : MenuItem(ListItemType::Custom, d.name, d.addr, DeferToSubmenu, submenu), dev(d)
 {}
 
+bool PairableItem::update(const BT_device &d)
+{
+    bool changed = dev.kind != d.kind || strcmp(dev.addr, d.addr) != 0;
+    dev = d;
+    setDesc(d.addr);
+    return changed;
+}
+
 void PairableItem::drawCustomItem(SDL_Surface *surface, const SDL_Rect &dst, const AbstractMenuItem &item, bool selected) const
 {
     SDL_Color text_color = uintToColour(THEME_COLOR4_255);
@@ -309,7 +415,17 @@ void PairableItem::drawCustomItem(SDL_Surface *surface, const SDL_Rect &dst, con
 
 PairedItem::PairedItem(BT_devicePaired d, MenuList* submenu)
     : MenuItem(ListItemType::Custom, d.remote_name, d.remote_addr, DeferToSubmenu, submenu), dev(d)
-{}
+{
+    setDesc(std::string(d.remote_addr) + " | " + std::to_string(d.rssi));
+}
+
+bool PairedItem::update(const BT_devicePaired &d)
+{
+    bool changed = dev.rssi != d.rssi || dev.is_bonded != d.is_bonded || strcmp(dev.remote_addr, d.remote_addr) != 0;
+    dev = d;
+    setDesc(std::string(d.remote_addr) + " | " + std::to_string(d.rssi));
+    return changed;
+}
 
 void PairedItem::drawCustomItem(SDL_Surface *surface, const SDL_Rect &dst, const AbstractMenuItem &item, bool selected) const
 {
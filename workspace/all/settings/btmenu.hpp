@@ -1,10 +1,16 @@
 #pragma once
 
 #include "menu.hpp"
+#include <condition_variable>
+#include <map>
+#include <mutex>
 #include <thread>
 
 namespace Bluetooth
 {
+    class PairableItem;
+    class PairedItem;
+
     class Menu : public MenuList
     {
         const int &globalQuit;
@@ -16,10 +22,22 @@ namespace Bluetooth
         // max sample rate
         MenuItem *rateItem;
 
+        // device items currently in the list, by name
+        std::map<std::string, PairableItem *> available;
+        std::map<std::string, PairedItem *> paired;
+
         std::thread worker;
         bool quit = false;
         bool selectionDirty = false;
 
+        // the updater sleeps on this until woken by a btmanager event,
+        // a toggle, the menu being shown or one of our submenus closing
+        std::mutex wakeLock;
+        std::condition_variable wake;
+        bool pending = false;
+        bool visible = false;
+        bool submenuOpen = false;
+
     public:
         Menu(const int &globalQuit, int &globalDirty);
         ~Menu();
@@ -39,6 +57,12 @@ namespace Bluetooth
         void setSamplerateMaximum(const std::any &on);
         void resetSamplerateMaximum();
 
+        void notify();
+        void setVisible(bool on);
+        static void onEvent(int event);
+        bool anySubmenuOpen();
+
+        void refresh();
         void updater();
     };
 
@@ -49,6 +73,9 @@ namespace Bluetooth
     public:
         PairableItem(BT_device d, MenuList *submenu);
 
+        // returns true if anything visible changed
+        bool update(const BT_device &d);
+
         void drawCustomItem(SDL_Surface *surface, const SDL_Rect &dst, const AbstractMenuItem &item, bool selected) const override;
     };
 
@@ -59,6 +86,10 @@ namespace Bluetooth
     public:
         PairedItem(BT_devicePaired d, MenuList *submenu);
 
+        bool isConnected() const { return dev.is_connected; }
+        // returns true if anything visible changed
+        bool update(const BT_devicePaired &d);
+
         void drawCustomItem(SDL_Surface *surface, const SDL_Rect &dst, const AbstractMenuItem &item, bool selected) const override;
     };
 
@@ -352,8 +352,7 @@ std::string MenuList::getSelectedItemName() const
     if(items.empty())
         return "";
 
-    int selected_row = scope.selected - scope.start;
-    return items.at(selected_row)->getName();
+    return items.at(scope.selected)->getName();
 }
 
 bool MenuList::selectByName(const std::string &name)
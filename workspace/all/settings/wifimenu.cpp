@@ -13,6 +13,29 @@ typedef std::shared_lock<Lock> ReadLock;
 using namespace Wifi;
 using namespace std::placeholders;
 
+namespace
+{
+    // reasons for the updater to wake up
+    enum
+    {
+        Reread = 1 << 0, // read back what the supplicant already knows
+        Rescan = 1 << 1, // ask it for a fresh scan
+    };
+
+    // the supplicant stops scanning on its own once connected, so kick off
+    // a scan every so often while the menu is up to keep the list current
+    constexpr std::chrono::milliseconds rescanInterval{30000};
+    // supplicant not answering yet, or dhcp still running
+    constexpr std::chrono::milliseconds retryInterval{1000};
+    // no event subscription, fall back to polling
+    constexpr std::chrono::milliseconds pollInterval{2000};
+    // sleep until something wakes us
+    constexpr std::chrono::milliseconds untilWoken{0};
+
+    // the platform callback carries no context, there is only one of these menus
+    Menu *eventTarget = nullptr;
+}
+
 Menu::Menu(const int &globalQuit) : MenuList(MenuItemType::Fixed, "Network", {}), globalQuit(globalQuit)
 {
     toggleItem = new MenuItem(ListItemType::Generic, "WiFi", "Enable/disable WiFi", {false, true}, {"Off", "On"},
@@ -30,19 +53,42 @@ Menu::Menu(const int &globalQuit) : MenuList(MenuItemType::Fixed, "Network", {})
     MenuList::performLayout((SDL_Rect){0, 0, FIXED_WIDTH, FIXED_HEIGHT});
     layout_called = false;
 
+    eventTarget = this;
     worker = std::thread{&Menu::updater, this};
 }
 
 Menu::~Menu()
 {
-    quit = true;
+    {
+        std::lock_guard<std::mutex> lk(wakeLock);
+        quit = true;
+    }
+    wake.notify_one();
     if (worker.joinable())
         worker.join();
+
+    if (watching)
+        WIFI_removeEventWatcher();
+    eventTarget = nullptr;
 }
 
 InputReactionHint Menu::handleInput(int &dirty, int &quit)
 {
+    // we only get input while on screen
+    if (!visible)
+        setVisible(true);
+
     auto ret = MenuList::handleInput(dirty, quit);
+
+    // list changes are held back while an options submenu is open
+    bool open = anySubmenuOpen();
+    if (submenuOpen && !open)
+        notify(Reread);
+    submenuOpen = open;
+
+    if (quit)
+        setVisible(false);
+
     if (workerDirty)
     {
         dirty = true;
@@ -60,6 +106,7 @@ std::any Menu::getWifToggleState() const
 void Menu::setWifiToggleState(const std::any &on)
 {
     WIFI_enable(std::any_cast<bool>(on));
+    notify(Rescan);
 }
 
 void Menu::resetWifiToggleState()
@@ -82,115 +129,206 @@ void Menu::resetWifiDiagnosticsState()
     //
 }
 
-template <typename Map>
-bool key_compare(Map const &lhs, Map const &rhs)
+void Menu::notify(int what)
 {
-    return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin(),
-                                                  [](auto a, auto b)
-                                                  { return a.first == b.first; });
+    {
+        std::lock_guard<std::mutex> lk(wakeLock);
+        pending |= what;
+    }
+    wake.notify_one();
 }
 
-void Menu::updater()
+void Menu::setVisible(bool on)
 {
-    int pollSecs = 15;
-    std::map<std::string, WIFI_network> prevScan;
-    std::string prevSsid;
-    while (!quit && !globalQuit)
     {
-        // TODO: pause when menu is not rendered
-        // Scan
-        if (WIFI_enabled())
+        std::lock_guard<std::mutex> lk(wakeLock);
+        visible = on;
+        if (on)
+            pending |= Rescan;
+    }
+    wake.notify_one();
+}
+
+void Menu::onEvent(int event)
+{
+    // scan results and (dis)connects all just mean "have another look"
+    if (eventTarget)
+        eventTarget->notify(Reread);
+}
+
+bool Menu::anySubmenuOpen()
+{
+    ReadLock r(itemLock);
+    for (auto i : items)
+        if (i->isDeferred())
+            return true;
+    return false;
+}
+
+void Menu::sync(const std::vector<WIFI_network> &scan, const WIFI_connection &connection)
+{
+    std::map<std::string, WIFI_network> scanSsids;
+    for (auto &r : scan)
+        scanSsids.emplace(r.ssid, r);
+
+    auto describe = [&](const WIFI_network &r, bool connected) {
+        std::string desc = r.bssid;
+        if (connected && connection.ip[0])
+            desc += " | " + std::string(connection.ip);
+        return desc;
+    };
+
+    std::string selectedName;
+    bool relayout = false;
+    {
+        WriteLock w(itemLock);
+
+        bool menuOpen = false;
+        for (auto i : items)
+            menuOpen |= i->isDeferred();
+        selectedName = getSelectedItemName();
+
+        std::map<std::string, NetworkItem *> next;
+        for (auto &[ssid, r] : scanSsids)
         {
-            // scan for available networks and add a menu item for each
-            WIFI_connection connection;
-            if(WIFI_connectionInfo(&connection) < 0)
-                continue; // try again in a bit
-
-            // grab list and compare it to previous result
-            // only relayout the menu if changes happended
-            std::vector<WIFI_network> scanResults(SCAN_MAX_RESULTS);
-            int cnt = WIFI_scan(scanResults.data(), SCAN_MAX_RESULTS);
-            if(cnt < 0)
-                continue; // try again in a bit
-
-            std::map<std::string, WIFI_network> scanSsids;
-            for (int i = 0; i < cnt; i++)
-                scanSsids.emplace(scanResults[i].ssid, scanResults[i]);
-
-            // dont repopulate if any submenu is open
-            bool menuOpen = false;
-            for(auto i : items){
-                if(i->isDeferred()){
-                    menuOpen = true;
-                    break;
-                }
+            bool connected = strcmp(connection.ssid, r.ssid) == 0;
+            bool known = WIFI_isKnown(r.ssid, r.security);
+
+            auto it = networks.find(ssid);
+            NetworkItem *itm = it != networks.end() ? it->second : nullptr;
+
+            // same network, same options - just refresh what is shown
+            if (itm && itm->isConnected() == connected && itm->isKnown() == known)
+            {
+                if (itm->update(r, describe(r, connected)))
+                    workerDirty = true;
+                next[ssid] = itm;
+                continue;
             }
+            if (menuOpen)
+                continue;
+
+            MenuList *options;
+            if (connected)
+                options = new MenuList(MenuItemType::List, "Options",
+                                       {
+                                           new MenuItem{ListItemType::Button, "Disconnect", "Disconnect from this network.",
+                                                        [&](AbstractMenuItem &item) -> InputReactionHint
+                                                        { WIFI_disconnect(); workerDirty = true; return Exit; }},
+                                           new ForgetItem(r, workerDirty)
+                                       });
+            else 
+            if (known)
+                options = new MenuList(MenuItemType::List, "Options", { new ConnectKnownItem(r, workerDirty), new ForgetItem(r, workerDirty) });
+            else
+                options = new MenuList(MenuItemType::List, "Options", { new ConnectNewItem(r, workerDirty) });
+
+            auto fresh = new NetworkItem{r, connected, known, options};
+            fresh->setDesc(describe(r, connected));
+            next[ssid] = fresh;
+            relayout = true;
+        }
+
+        // dont touch the list structure while any submenu is open
+        if (menuOpen)
+            return;
 
-            // something changed?
-            if (!menuOpen &&
-                (prevSsid != std::string(connection.ssid) 
-                || !key_compare(prevScan, scanSsids)))
+        // drop whatever went away or got replaced above
+        for (auto &[ssid, itm] : networks)
+        {
+            auto it = next.find(ssid);
+            if (it == next.end() || it->second != itm)
             {
-                prevScan = scanSsids;
-                prevSsid = connection.ssid;
-
-                WriteLock w(itemLock);
-                items.clear();
-                items.push_back(toggleItem);
-                items.push_back(diagItem);
-                layout_called = false;
-
-                for (auto &[s, r] : scanSsids)
-                {
-                    bool connected = false;
-                    bool hasCredentials = WIFI_isKnown(r.ssid, r.security);
-
-                    if (strcmp(connection.ssid, r.ssid) == 0)
-                        connected = true;
-
-                    MenuList *options;
-                    if (connected)
-                        options = new MenuList(MenuItemType::List, "Options",
-                                               {
-                                                   new MenuItem{ListItemType::Button, "Disconnect", "Disconnect from this network.",
-                                                                [&](AbstractMenuItem &item) -> InputReactionHint
-                                                                { WIFI_disconnect(); workerDirty = true; return Exit; }},
-                                                   new ForgetItem(r, workerDirty)
-                                               });
-                    else 
-                    if (hasCredentials)
-                        options = new MenuList(MenuItemType::List, "Options", { new ConnectKnownItem(r, workerDirty), new ForgetItem(r, workerDirty) });
-                    else
-                        options = new MenuList(MenuItemType::List, "Options", { new ConnectNewItem(r, workerDirty) });
-
-                    auto itm = new NetworkItem{r, connected, options};
-                    if(connected && !std::string(connection.ip).empty())
-                        itm->setDesc(std::string(r.bssid) + " | " + std::string(connection.ip));
-                    items.push_back(itm);
-                }
-                workerDirty = true;
+                delete itm->getSubMenu();
+                delete itm;
+                relayout = true;
             }
-            pollSecs = 2;
         }
-        else
+        networks = next;
+
+        if (relayout)
         {
-            WriteLock w(itemLock);
             items.clear();
             items.push_back(toggleItem);
             items.push_back(diagItem);
-            prevScan.clear();
+            for (auto &[ssid, itm] : networks)
+                items.push_back(itm);
             layout_called = false;
-            workerDirty = true;
-            pollSecs = 15;
         }
+    }
 
-        // reset selection scope (locks internally)
-        if (workerDirty)
-        {
+    if (relayout)
+    {
+        // reset selection scope (locks internally), keeping the selected item if it is still around
+        if (!selectByName(selectedName))
             MenuList::performLayout((SDL_Rect){0, 0, FIXED_WIDTH, FIXED_HEIGHT});
+        workerDirty = true;
+    }
+}
+
+std::chrono::milliseconds Menu::refresh(int what)
+{
+    if (!WIFI_enabled())
+    {
+        if (watching)
+        {
+            WIFI_removeEventWatcher();
+            watching = false;
+        }
+        sync({}, WIFI_connection{});
+        return untilWoken; // the toggle wakes us
+    }
+
+    if (!watching)
+        watching = WIFI_registerEventWatcher(&Menu::onEvent);
+
+    WIFI_connection connection;
+    if (WIFI_connectionInfo(&connection) < 0)
+        return retryInterval;
+
+    // a scan we start reports back through the watcher, reading the
+    // results then doesnt start another one
+    auto now = std::chrono::steady_clock::now();
+    bool rescan = (what & Rescan) || now - lastScan >= rescanInterval;
+    std::vector<WIFI_network> scanResults(SCAN_MAX_RESULTS);
+    int cnt = rescan ? WIFI_scan(scanResults.data(), SCAN_MAX_RESULTS)
+                     : WIFI_scanResults(scanResults.data(), SCAN_MAX_RESULTS);
+    if (cnt < 0)
+        return retryInterval;
+    if (rescan)
+        lastScan = now;
+    scanResults.resize(cnt);
+
+    sync(scanResults, connection);
+
+    if (connection.ssid[0] && !connection.ip[0])
+        return retryInterval; // still waiting for an address
+    return watching ? rescanInterval : pollInterval;
+}
+
+void Menu::updater()
+{
+    std::unique_lock<std::mutex> lk(wakeLock);
+    while (!quit && !globalQuit)
+    {
+        // nothing to do while nobody is looking
+        if (!visible)
+        {
+            wake.wait(lk, [&] { return quit || visible; });
+            continue;
         }
 
-        std::this_thread::sleep_for(std::chrono::seconds(pollSecs));
+        int what = pending;
+        pending = 0;
+        lk.unlock();
+        auto wait = refresh(what);
+        lk.lock();
+
+        auto woken = [&] { return quit || !visible || pending; };
+        if (wait == untilWoken)
+            wake.wait(lk, woken);
+        else if (!wake.wait_for(lk, wait, woken))
+            pending |= Reread; // timed out, refresh decides whether that means a rescan
     }
 }
 
@@ -221,10 +359,18 @@ ForgetItem::ForgetItem(WIFI_network n, bool& dirty)
 {}
 
 
-NetworkItem::NetworkItem(WIFI_network n, bool connected, MenuList* submenu)
-    : MenuItem(ListItemType::Custom, n.ssid, n.bssid, DeferToSubmenu, submenu), net(n), connected(connected)
+NetworkItem::NetworkItem(WIFI_network n, bool connected, bool known, MenuList* submenu)
+    : MenuItem(ListItemType::Custom, n.ssid, n.bssid, DeferToSubmenu, submenu), net(n), connected(connected), known(known)
 {}
 
+bool NetworkItem::update(const WIFI_network &n, const std::string &desc)
+{
+    bool changed = net.rssi != n.rssi || strcmp(net.bssid, n.bssid) != 0 || getDesc() != desc;
+    net = n;
+    setDesc(desc);
+    return changed;
+}
+
 void NetworkItem::drawCustomItem(SDL_Surface *surface, const SDL_Rect &dst, const AbstractMenuItem &item, bool selected) const
 {
     SDL_Color text_color = uintToColour(THEME_COLOR4_255);
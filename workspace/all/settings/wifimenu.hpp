@@ -1,10 +1,16 @@
 #pragma once
 
 #include "menu.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
 #include <thread>
 
 namespace Wifi
 {
+    class NetworkItem;
+
     class Menu : public MenuList
     {
         const int &globalQuit;
@@ -13,10 +19,23 @@ namespace Wifi
         // diagnostics on/off
         MenuItem *diagItem;
 
+        // network items currently in the list, by ssid
+        std::map<std::string, NetworkItem *> networks;
+
         std::thread worker;
         bool quit = false;
         bool workerDirty = false;
 
+        // the updater sleeps on this until woken by a supplicant event,
+        // a toggle, the menu being shown or one of our submenus closing
+        std::mutex wakeLock;
+        std::condition_variable wake;
+        int pending = 0;
+        bool visible = false;
+        bool submenuOpen = false;
+        bool watching = false;
+        std::chrono::steady_clock::time_point lastScan;
+
     public:
         Menu(const int &globalQuit);
         ~Menu();
@@ -32,6 +51,13 @@ namespace Wifi
         void setWifiDiagnosticsState(const std::any &on);
         void resetWifiDiagnosticsState();
 
+        void notify(int what);
+        void setVisible(bool on);
+        static void onEvent(int event);
+        bool anySubmenuOpen();
+
+        std::chrono::milliseconds refresh(int what);
+        void sync(const std::vector<WIFI_network> &scan, const WIFI_connection &connection);
         void updater();
     };
 
@@ -39,9 +65,15 @@ namespace Wifi
     {
         WIFI_network net;
         bool connected;
+        bool known;
 
     public:
-        NetworkItem(WIFI_network n, bool connected, MenuList *submenu);
+        NetworkItem(WIFI_network n, bool connected, bool known, MenuList *submenu);
+
+        bool isConnected() const { return connected; }
+        bool isKnown() const { return known; }
+        // refreshes signal/bssid in place, returns true if anything visible changed
+        bool update(const WIFI_network &n, const std::string &desc);
 
         void drawCustomItem(SDL_Surface *surface, const SDL_Rect &dst, const AbstractMenuItem &item, bool selected) const override;
     };
@@ -0,0 +1,153 @@
+// shaderwarm: builds every shader into the program cache ahead of time so the
+// first time one is picked in minarch it loads instead of compiling. runs the
+// exact preprocessing and cache path minarch uses, in a headless EGL context,
+// and reports how long each shader took so heavy ones stand out.
+//
+// usage: shaderwarm.elf [shader folder]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <time.h>
+#include <EGL/egl.h>
+
+#include "defines.h"
+#include "api.h"
+#include "utils.h"
+
+#ifndef EGL_OPENGL_ES3_BIT
+#define EGL_OPENGL_ES3_BIT 0x0040
+#endif
+
+// platform.c
+GLuint load_program(const char* path, const char* filename, int* cached);
+
+static struct {
+	EGLDisplay display;
+	EGLContext context;
+	EGLSurface surface;
+} egl = { EGL_NO_DISPLAY, EGL_NO_CONTEXT, EGL_NO_SURFACE };
+
+static int initContext(void) {
+	egl.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (egl.display == EGL_NO_DISPLAY || !eglInitialize(egl.display, NULL, NULL)) {
+		LOG_error("no egl display 0x%x\n", eglGetError());
+		return 0;
+	}
+
+	// match the api the platform's shader preprocessing targets
+#ifdef USE_GLES
+	eglBindAPI(EGL_OPENGL_ES_API);
+	EGLint renderable = EGL_OPENGL_ES3_BIT;
+	EGLint context_attribs[] = { EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE };
+#else
+	eglBindAPI(EGL_OPENGL_API);
+	EGLint renderable = EGL_OPENGL_BIT;
+	EGLint context_attribs[] = { EGL_NONE };
+#endif
+
+	EGLint config_attribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, renderable,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint num_configs = 0;
+	if (!eglChooseConfig(egl.display, config_attribs, &config, 1, &num_configs) || num_configs < 1) {
+		LOG_error("no usable egl config 0x%x\n", eglGetError());
+		return 0;
+	}
+
+	egl.context = eglCreateContext(egl.display, config, EGL_NO_CONTEXT, context_attribs);
+	if (egl.context == EGL_NO_CONTEXT) {
+		LOG_error("eglCreateContext failed 0x%x\n", eglGetError());
+		return 0;
+	}
+
+	// surfaceless if the driver allows it, otherwise a throwaway pbuffer
+	if (!eglMakeCurrent(egl.display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl.context)) {
+		EGLint pbuffer_attribs[] = { EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE };
+		egl.surface = eglCreatePbufferSurface(egl.display, config, pbuffer_attribs);
+		if (egl.surface == EGL_NO_SURFACE || !eglMakeCurrent(egl.display, egl.surface, egl.surface, egl.context)) {
+			LOG_error("eglMakeCurrent failed 0x%x\n", eglGetError());
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void quitContext(void) {
+	if (egl.display == EGL_NO_DISPLAY) return;
+	eglMakeCurrent(egl.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (egl.surface != EGL_NO_SURFACE) eglDestroySurface(egl.display, egl.surface);
+	if (egl.context != EGL_NO_CONTEXT) eglDestroyContext(egl.display, egl.context);
+	eglTerminate(egl.display);
+}
+
+static double now_ms(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static struct {
+	int built;
+	int cached;
+	int failed;
+	double ms;
+} totals;
+
+static void warmShader(const char* path, const char* filename) {
+	int cached = 0;
+	double start = now_ms();
+	GLuint program = load_program(path, filename, &cached);
+	double ms = now_ms() - start;
+
+	GLint success = 0;
+	if (program) glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (program) glDeleteProgram(program);
+
+	const char* status = !success ? "failed" : cached ? "cached" : "built";
+	printf("%-48s %9.1fms  %s\n", filename, ms, status);
+	fflush(stdout);
+
+	if (!success) totals.failed += 1;
+	else if (cached) totals.cached += 1;
+	else totals.built += 1;
+	totals.ms += ms;
+}
+
+int main(int argc, char* argv[]) {
+	const char* folder = argc > 1 ? argv[1] : SHADERS_FOLDER "/glsl";
+
+	if (!initContext()) {
+		quitContext();
+		return EXIT_FAILURE;
+	}
+	printf("%s / %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+
+	// the frontend's own passes first, every game needs those
+	warmShader(SYSSHADERS_FOLDER, "default.glsl");
+	warmShader(SYSSHADERS_FOLDER, "overlay.glsl");
+	warmShader(SYSSHADERS_FOLDER, "noshader.glsl");
+
+	DIR* dir = opendir(folder);
+	if (dir) {
+		struct dirent* dp;
+		while ((dp = readdir(dir))) {
+			if (dp->d_name[0] == '.' || !suffixMatch(".glsl", dp->d_name)) continue;
+			warmShader(folder, dp->d_name);
+		}
+		closedir(dir);
+	}
+	else LOG_error("can't open %s\n", folder);
+
+	printf("%i built, %i cached, %i failed in %.1fms\n", totals.built, totals.cached, totals.failed, totals.ms);
+
+	quitContext();
+	return totals.failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -64,6 +64,7 @@ Shader* shaders[MAXSHADERS] = {
 };
 
 static int nrofshaders = 0; // choose between 1 and 3 pipelines, > pipelines = more cpu usage, but more shader options and shader upscaling stuff
+static void releasePassTarget(GLuint texture);
 
 ///////////////////////////////
 
@@ -151,77 +152,6 @@ int extractPragmaParameters(const char *shaderSource, ShaderParam *params, int m
 }
 
 
-GLuint link_program(GLuint vertex_shader, GLuint fragment_shader, const char* cache_key) {
-    char cache_path[512];
-    snprintf(cache_path, sizeof(cache_path), "/mnt/SDCARD/.shadercache/%s.bin", cache_key);
-	
-
-    GLuint program = glCreateProgram();
-    GLint success;
-
-    // Try to load cached binary first
-    FILE *f = fopen(cache_path, "rb");
-    if (f) {
-        GLint binaryFormat;
-        fread(&binaryFormat, sizeof(GLint), 1, f);
-        fseek(f, 0, SEEK_END);
-        size_t length = ftell(f) - sizeof(GLint);
-        fseek(f, sizeof(GLint), SEEK_SET);
-        void *binary = malloc(length);
-        fread(binary, 1, length, f);
-        fclose(f);
-
-        glProgramBinary(program, binaryFormat, binary, length);
-        free(binary);
-
-        glGetProgramiv(program, GL_LINK_STATUS, &success);
-        if (success) {
-            LOG_info("Loaded shader program from cache: %s\n", cache_key);
-            return program;
-        } else {
-            LOG_info("Cache load failed, falling back to compile.\n");
-            glDeleteProgram(program);
-            program = glCreateProgram();
-        }
-    }
-
-    // Compile and link if cache failed
-    glAttachShader(program, vertex_shader);
-    glAttachShader(program, fragment_shader);
-    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
-    glLinkProgram(program);
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-
-    if (!success) {
-        GLint logLength;
-        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
-        char* log = (char*)malloc(logLength);
-        glGetProgramInfoLog(program, logLength, &logLength, log);
-        printf("Program link error: %s\n", log);
-        free(log);
-        return program;
-    }
-
-    GLint binaryLength;
-    GLenum binaryFormat;
-    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
-    void* binary = malloc(binaryLength);
-    glGetProgramBinary(program, binaryLength, NULL, &binaryFormat, binary);
-
-    mkdir("/mnt/SDCARD/.shadercache", 0755); 
-    f = fopen(cache_path, "wb");
-    if (f) {
-        fwrite(&binaryFormat, sizeof(GLenum), 1, f);
-        fwrite(binary, 1, binaryLength, f);
-        fclose(f);
-        LOG_info("Saved shader program to cache: %s\n", cache_key);
-    }
-    free(binary);
-
-    LOG_info("Program linked and cached\n");
-    return program;
-}
-
 char* load_shader_source(const char* filename) {
 	char filepath[256];
 	snprintf(filepath, sizeof(filepath), "%s", filename);
@@ -248,7 +178,8 @@ char* load_shader_source(const char* filename) {
     return source;
 }
 
-GLuint load_shader_from_file(GLenum type, const char* filename, const char* path) {
+// returns the source as handed to the compiler, caller must free
+char* preprocess_shader_source(GLenum type, const char* filename, const char* path) {
 	char filepath[256];
 	snprintf(filepath, sizeof(filepath), "%s/%s", path,filename);
     char* source = load_shader_source(filepath);
@@ -365,14 +296,99 @@ GLuint load_shader_from_file(GLenum type, const char* filename, const char* path
         strcat(combined, source);
     }
 
+    free(source);
+    return combined;
+}
+
+///////////////////////////////
+
+// shader program cache
+// programs are stored as driver binaries keyed on a hash of the exact source
+// handed to the compiler plus the driver identity, so a hit never compiles
+// anything and an edited shader or updated driver can't load a stale binary.
+
+#define SHADERCACHE_PATH SDCARD_PATH "/.shadercache"
+
+static uint64_t hash_string(uint64_t hash, const char* str) {
+	// FNV-1a, including the terminator so concatenations can't collide
+	do {
+		hash ^= (uint8_t)*str;
+		hash *= 0x100000001b3ULL;
+	} while (*str++);
+	return hash;
+}
+
+static uint64_t program_cache_key(const char* vertex_source, const char* fragment_source) {
+	const char* driver[3] = {
+		(const char*)glGetString(GL_VENDOR),
+		(const char*)glGetString(GL_RENDERER),
+		(const char*)glGetString(GL_VERSION),
+	};
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (int i = 0; i < 3; i++) hash = hash_string(hash, driver[i] ? driver[i] : "");
+	hash = hash_string(hash, vertex_source);
+	hash = hash_string(hash, fragment_source);
+	return hash;
+}
+
+static GLuint load_program_binary(const char* cache_path) {
+	FILE *f = fopen(cache_path, "rb");
+	if (!f) return 0;
+
+	GLenum binaryFormat = 0;
+	fseek(f, 0, SEEK_END);
+	long length = ftell(f) - (long)sizeof(GLenum);
+	rewind(f);
+	void* binary = length > 0 ? malloc(length) : NULL;
+	int ok = binary && fread(&binaryFormat, sizeof(GLenum), 1, f) == 1 && fread(binary, 1, length, f) == (size_t)length;
+	fclose(f);
+
+	GLuint program = 0;
+	if (ok) {
+		program = glCreateProgram();
+		glProgramBinary(program, binaryFormat, binary, length);
+		GLint success = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success) {
+			// driver rejected it, rebuild and overwrite below
+			LOG_info("Cache load failed, falling back to compile.\n");
+			glDeleteProgram(program);
+			program = 0;
+		}
+	}
+	if (binary) free(binary);
+	return program;
+}
+
+static void save_program_binary(GLuint program, const char* cache_path) {
+	GLint binaryLength = 0;
+	GLenum binaryFormat;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+	if (binaryLength <= 0) return;
+
+	void* binary = malloc(binaryLength);
+	if (!binary) return;
+	glGetProgramBinary(program, binaryLength, NULL, &binaryFormat, binary);
+
+	// written aside and renamed so a concurrent reader never sees half a binary
+	char tmp_path[512];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.%i.tmp", cache_path, (int)SDL_ThreadID());
+	mkdir(SHADERCACHE_PATH, 0755);
+	FILE* f = fopen(tmp_path, "wb");
+	if (f) {
+		int ok = fwrite(&binaryFormat, sizeof(GLenum), 1, f) == 1 && fwrite(binary, 1, binaryLength, f) == (size_t)binaryLength;
+		fclose(f);
+		if (ok) rename(tmp_path, cache_path);
+		else unlink(tmp_path);
+	}
+	free(binary);
+}
+
+static GLuint compile_shader(GLenum type, const char* source) {
     GLuint shader = glCreateShader(type);
-    const char* combined_ptr = combined;
-    glShaderSource(shader, 1, &combined_ptr, NULL);
+    glShaderSource(shader, 1, &source, NULL);
     glCompileShader(shader);
 
-    free(source);
-    free(combined);
-
     GLint compiled;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
     if (!compiled) {
@@ -382,33 +398,209 @@ GLuint load_shader_from_file(GLenum type, const char* filename, const char* path
         glDeleteShader(shader);
         return 0;
     }
-	else{
-		fprintf(stdout, "Shader compilation successful\n");
-	}
 
     return shader;
 }
 
+// returns a linked program, on failure the unlinked program is returned so callers can read its log.
+// cached (optional) reports whether it came straight from the program cache
+GLuint load_program(const char* path, const char* filename, int* cached) {
+	if (cached) *cached = 0;
+
+	char* vertex_source = preprocess_shader_source(GL_VERTEX_SHADER, filename, path);
+	char* fragment_source = preprocess_shader_source(GL_FRAGMENT_SHADER, filename, path);
+	if (!vertex_source || !fragment_source) {
+		if (vertex_source) free(vertex_source);
+		if (fragment_source) free(fragment_source);
+		return 0;
+	}
+
+	char cache_path[512];
+	uint64_t key = program_cache_key(vertex_source, fragment_source);
+	snprintf(cache_path, sizeof(cache_path), SHADERCACHE_PATH "/%016llx.bin", (unsigned long long)key);
+
+	GLuint program = load_program_binary(cache_path);
+	if (program) {
+		if (cached) *cached = 1;
+		LOG_info("Loaded shader program from cache: %s (%016llx)\n", filename, (unsigned long long)key);
+		free(vertex_source);
+		free(fragment_source);
+		return program;
+	}
+
+	GLint success;
+	program = glCreateProgram();
+	GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_source);
+	GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_source);
+	free(vertex_source);
+	free(fragment_source);
+
+	if (vertex_shader) glAttachShader(program, vertex_shader);
+	if (fragment_shader) glAttachShader(program, fragment_shader);
+	glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(program);
+	if (vertex_shader) glDeleteShader(vertex_shader);
+	if (fragment_shader) glDeleteShader(fragment_shader);
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+
+	if (!success) {
+		GLint logLength = 0;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+		if (logLength > 0) {
+			char* log = (char*)malloc(logLength);
+			glGetProgramInfoLog(program, logLength, &logLength, log);
+			printf("Program link error: %s\n", log);
+			free(log);
+		}
+		return program;
+	}
+
+	save_program_binary(program, cache_path);
+	LOG_info("Program linked and cached: %s (%016llx)\n", filename, (unsigned long long)key);
+	return program;
+}
+
+
 void PLAT_initShaders() {
 	SDL_GL_MakeCurrent(vid.window, vid.gl_context);
 	glViewport(0, 0, device_width, device_height);
 	
-	GLuint vertex;
-	GLuint fragment;
+	g_shader_default = load_program(SYSSHADERS_FOLDER, "default.glsl", NULL);
+	g_shader_overlay = load_program(SYSSHADERS_FOLDER, "overlay.glsl", NULL);
+	g_noshader = load_program(SYSSHADERS_FOLDER, "noshader.glsl", NULL);
+	
+	LOG_info("default shaders loaded, %i\n\n",g_shader_default);
+}
 
-	vertex = load_shader_from_file(GL_VERTEX_SHADER, "default.glsl",SYSSHADERS_FOLDER);
-	fragment = load_shader_from_file(GL_FRAGMENT_SHADER, "default.glsl",SYSSHADERS_FOLDER);
-	g_shader_default = link_program(vertex, fragment,"defaultv2.glsl");
+void PLAT_precompileShaders(void) {
+	// no headless context to borrow here, shaders build into the cache on first use
+}
 
-	vertex = load_shader_from_file(GL_VERTEX_SHADER, "overlay.glsl",SYSSHADERS_FOLDER);
-	fragment = load_shader_from_file(GL_FRAGMENT_SHADER, "overlay.glsl",SYSSHADERS_FOLDER);
-	g_shader_overlay = link_program(vertex, fragment,"overlay.glsl");
+///////////////////////////////
 
-	vertex = load_shader_from_file(GL_VERTEX_SHADER, "noshader.glsl",SYSSHADERS_FOLDER);
-	fragment = load_shader_from_file(GL_FRAGMENT_SHADER, "noshader.glsl",SYSSHADERS_FOLDER);
-	g_noshader = link_program(vertex, fragment,"noshader.glsl");
-	
-	LOG_info("default shaders loaded, %i\n\n",g_shader_default);
+// effect and overlay images are decoded on a loader thread that sleeps on a
+// condvar until a setter queues a new path. the decoded surface is handed back
+// under the lock and PLAT_GL_Swap turns it into a texture on the render thread.
+
+enum {
+	LAYER_EFFECT,
+	LAYER_OVERLAY,
+	LAYER_COUNT,
+};
+
+typedef struct {
+	char* path; // queued path, NULL or "" clears the texture
+	int requested;
+	SDL_Surface* image; // decoded RGBA32, owned by the slot until taken
+	int ready;
+} AssetSlot;
+
+static struct {
+	SDL_Thread* thread;
+	SDL_mutex* lock;
+	SDL_cond* cond;
+	int quit;
+	AssetSlot slots[LAYER_COUNT];
+} assets;
+
+static int assetLoaderThread(void* data) {
+	THREAD_register(THREAD_HOUSEKEEPING);
+	SDL_LockMutex(assets.lock);
+	while (!assets.quit) {
+		AssetSlot* slot = NULL;
+		for (int i=0; i<LAYER_COUNT; i++) {
+			if (assets.slots[i].requested) {
+				slot = &assets.slots[i];
+				break;
+			}
+		}
+		if (!slot) {
+			SDL_CondWait(assets.cond, assets.lock);
+			continue;
+		}
+
+		char* path = slot->path;
+		slot->path = NULL;
+		slot->requested = 0;
+		SDL_UnlockMutex(assets.lock);
+
+		SDL_Surface* image = NULL;
+		if (path && *path) {
+			image = GFX_loadImage(path, SDL_PIXELFORMAT_RGBA32);
+			if (image) LOG_info("loaded asset %s\n", path);
+			else LOG_error("failed to load asset %s\n", path);
+		}
+		if (path) free(path);
+
+		SDL_LockMutex(assets.lock);
+		if (slot->requested) { // superseded while decoding
+			if (image) SDL_FreeSurface(image);
+			continue;
+		}
+		if (slot->image) SDL_FreeSurface(slot->image);
+		slot->image = image;
+		slot->ready = 1;
+	}
+	SDL_UnlockMutex(assets.lock);
+	THREAD_unregister();
+	return 0;
+}
+
+static void startAssetLoader(void) {
+	if (assets.thread) return;
+	assets.quit = 0;
+	assets.lock = SDL_CreateMutex();
+	assets.cond = SDL_CreateCond();
+	assets.thread = SDL_CreateThread(assetLoaderThread, "AssetLoader", NULL);
+	if (!assets.thread) LOG_error("Error creating asset loader thread: %s\n", SDL_GetError());
+}
+
+static void stopAssetLoader(void) {
+	if (!assets.thread) return;
+	SDL_LockMutex(assets.lock);
+	assets.quit = 1;
+	SDL_CondSignal(assets.cond);
+	SDL_UnlockMutex(assets.lock);
+	SDL_WaitThread(assets.thread, NULL);
+
+	for (int i=0; i<LAYER_COUNT; i++) {
+		if (assets.slots[i].path) free(assets.slots[i].path);
+		if (assets.slots[i].image) SDL_FreeSurface(assets.slots[i].image);
+	}
+	SDL_DestroyCond(assets.cond);
+	SDL_DestroyMutex(assets.lock);
+	memset(&assets, 0, sizeof(assets));
+}
+
+// queues path for decoding, replacing any request the loader hasn't picked up yet
+static void requestAsset(int index, const char* path) {
+	startAssetLoader();
+	if (!assets.thread) return;
+
+	SDL_LockMutex(assets.lock);
+	AssetSlot* slot = &assets.slots[index];
+	if (slot->path) free(slot->path);
+	slot->path = path ? strdup(path) : NULL;
+	slot->requested = 1;
+	SDL_CondSignal(assets.cond);
+	SDL_UnlockMutex(assets.lock);
+}
+
+// render thread only, returns 1 and hands over ownership of image (NULL to clear) when a new one is ready
+static int takeAsset(int index, SDL_Surface** image) {
+	if (!assets.thread) return 0;
+
+	int ready = 0;
+	SDL_LockMutex(assets.lock);
+	AssetSlot* slot = &assets.slots[index];
+	if (slot->ready) {
+		*image = slot->image;
+		slot->image = NULL;
+		slot->ready = 0;
+		ready = 1;
+	}
+	SDL_UnlockMutex(assets.lock);
+	return ready;
 }
 
 SDL_Surface* PLAT_initVideo(void) {
@@ -473,6 +665,7 @@ SDL_Surface* PLAT_initVideo(void) {
 	vid.gl_context = SDL_GL_CreateContext(vid.window);
 	SDL_GL_MakeCurrent(vid.window, vid.gl_context);
 	glViewport(0, 0, w, h);
+	startAssetLoader();
 
 	LOG_info("OpenGL version: %s\n", (char *)glGetString(GL_VERSION));
 
@@ -514,51 +707,6 @@ void PLAT_resetShaders() {
 
 }
 
-char* PLAT_findFileInDir(const char *directory, const char *filename) {
-    char *filename_copy = strdup(filename);
-    if (!filename_copy) {
-        perror("strdup");
-        return NULL;
-    }
-
-    // Strip extension from filename
-    char *dot_pos = strrchr(filename_copy, '.');
-    if (dot_pos) {
-        *dot_pos = '\0';
-    }
-
-    DIR *dir = opendir(directory);
-    if (!dir) {
-        perror("opendir");
-        free(filename_copy);
-        return NULL;
-    }
-
-    struct dirent *entry;
-    char *full_path = NULL;
-
-    while ((entry = readdir(dir)) != NULL) {
-        if (strstr(entry->d_name, filename_copy) == entry->d_name) {
-            full_path = (char *)malloc(strlen(directory) + strlen(entry->d_name) + 2); // +1 for slash, +1 for '\0'
-            if (!full_path) {
-                perror("malloc");
-                closedir(dir);
-                free(filename_copy);
-                return NULL;
-            }
-
-            snprintf(full_path, strlen(directory) + strlen(entry->d_name) + 2, "%s/%s", directory, entry->d_name);
-            closedir(dir);
-            free(filename_copy);
-            return full_path;
-        }
-    }
-
-    closedir(dir);
-    free(filename_copy);
-    return NULL;
-}
-
 
 #define MAX_SHADER_PRAGMAS 32
 void loadShaderPragmas(Shader *shader, const char *shaderSource) {
@@ -589,8 +737,6 @@ void PLAT_updateShader(int i, const char *filename, int *scale, int *filter, int
         snprintf(filepath, sizeof(filepath), SHADERS_FOLDER "/glsl/%s",filename);
         const char *shaderSource  = load_shader_source(filepath);
         loadShaderPragmas(shader,shaderSource);
-         GLuint vertex_shader1 = load_shader_from_file(GL_VERTEX_SHADER, filename,SHADERS_FOLDER "/glsl");
-    GLuint fragment_shader1 = load_shader_from_file(GL_FRAGMENT_SHADER, filename,SHADERS_FOLDER "/glsl");
         
         
         // Link the shader program
@@ -598,7 +744,7 @@ void PLAT_updateShader(int i, const char *filename, int *scale, int *filter, int
 			LOG_info("Deleting previous shader %i\n",shader->shader_p);
 			glDeleteProgram(shader->shader_p);
 		}
-        shader->shader_p = link_program(vertex_shader1, fragment_shader1,filename);
+        shader->shader_p = load_program(SHADERS_FOLDER "/glsl", filename, NULL);
         
 		shader->u_FrameDirection = glGetUniformLocation( shader->shader_p, "FrameDirection");
 		shader->u_FrameCount = glGetUniformLocation( shader->shader_p, "FrameCount");
@@ -654,6 +800,10 @@ void PLAT_updateShader(int i, const char *filename, int *scale, int *filter, int
 
 void PLAT_setShaders(int nr) {
 	LOG_info("set nr of shaders to %i\n",nr);
+	for (int i = nr; i < nrofshaders; i++) {
+		releasePassTarget(shaders[i]->texture);
+		shaders[i]->texture = 0;
+	}
 	nrofshaders = nr;
 	reloadShaderTextures = 1;
 }
@@ -670,6 +820,7 @@ static void clearVideo(void) {
 
 void PLAT_quitVideo(void) {
 	clearVideo();
+	stopAssetLoader();
 
 	glFinish();
 	SDL_GL_DeleteContext(vid.gl_context);
@@ -799,8 +950,6 @@ static void rgb565_to_rgb888(uint32_t rgb565, uint8_t *r, uint8_t *g, uint8_t *b
     *g = (green << 2) | (green >> 4);
     *b = (blue << 3) | (blue >> 2);
 }
-static char* effect_path;
-static int effectUpdated = 0;
 static void updateEffect(void) {
 	if (effect.next_scale==effect.scale && effect.next_type==effect.type && effect.next_color==effect.color) return; // unchanged
 	
@@ -810,9 +959,13 @@ static void updateEffect(void) {
 	effect.type = effect.next_type;
 	effect.color = effect.next_color;
 	
-	if (effect.type==EFFECT_NONE) return; // disabled
+	if (effect.type==EFFECT_NONE) { // disabled
+		requestAsset(LAYER_EFFECT, NULL);
+		return;
+	}
 	if (effect.type==effect.live_type && effect.scale==live_scale && effect.color==live_color) return; // already loaded
 	
+	char* effect_path = NULL;
 	int opacity = 128; // 1 - 1/2 = 50%
 	if (effect.type==EFFECT_LINE) {
 		if (effect.scale<3) {
@@ -865,8 +1018,7 @@ static void updateEffect(void) {
 			opacity = 136; // 1 - 57/121 = ~52%
 		}
 	}
-	effectUpdated = 1;
-	
+	requestAsset(LAYER_EFFECT, effect_path);
 }
 int screenx = 0;
 int screeny = 0;
@@ -880,18 +1032,18 @@ void PLAT_setOffsetY(int y) {
     screeny = y - 64; 
 	LOG_info("screeny: %i %i\n",screeny,y);
 }
-static int overlayUpdated=0;
 void PLAT_setOverlay(const char* filename, const char* tag) {
     if (vid.overlay) {
         SDL_DestroyTexture(vid.overlay);
         vid.overlay = NULL;
     }
+	if (overlay_path) free(overlay_path);
 	overlay_path = NULL;
-	overlayUpdated=1;
 
     if (!filename || strcmp(filename, "") == 0) {
 		overlay_path = strdup("");
         printf("Skipping overlay update.\n");
+		requestAsset(LAYER_OVERLAY, NULL);
         return;
     }
 
@@ -902,11 +1054,13 @@ void PLAT_setOverlay(const char* filename, const char* tag) {
 
     if (!overlay_path) {
         perror("malloc failed");
+		requestAsset(LAYER_OVERLAY, NULL);
         return;
     }
 
     snprintf(overlay_path, path_len, "%s/%s/%s", OVERLAYS_FOLDER, tag, filename);
     printf("Overlay path set to: %s\n", overlay_path);
+	requestAsset(LAYER_OVERLAY, overlay_path);
 
 }
 
@@ -1559,9 +1713,11 @@ void PLAT_present() {
 
 void PLAT_setEffect(int next_type) {
 	effect.next_type = next_type;
+	updateEffect();
 }
 void PLAT_setEffectColor(int next_color) {
 	effect.next_color = next_color;
+	updateEffect();
 }
 void PLAT_vsync(int remaining) {
 	if (remaining>0) SDL_Delay(remaining);
@@ -1570,7 +1726,27 @@ void PLAT_vsync(int remaining) {
 scaler_t PLAT_getScaler(GFX_Renderer* renderer) {
 	// LOG_info("getScaler for scale: %i\n", renderer->scale);
 	effect.next_scale = renderer->scale;
+	updateEffect();
+
+	// non-integer fits blend neighbouring pixels instead of dropping them
+	if (renderer->scale<0) {
+		scaler_t scaler = GFX_getAAScaler32(renderer);
+		if (scaler) return scaler;
+	}
+
+#if defined(__x86_64__) || defined(__i386__)
+	// minarch hands over RGBA8888, these pick SSE2 or AVX2 on first use
+	switch (renderer->scale) {
+		case 2: return scale2x2_x32;
+		case 3: return scale3x3_x32;
+		case 4: return scale4x4_x32;
+		case 5: return scale5x5_x32;
+		case 6: return scale6x6_x32;
+		default: return scale1x1_x32;
+	}
+#else
 	return scale1x1_c16;
+#endif
 }
 
 void setRectToAspectRatio(SDL_Rect* dst_rect) {
@@ -1685,14 +1861,123 @@ void PLAT_flip(SDL_Surface* IGNORED, int ignored) {
 }
 
 static int frame_count = 0;
+
+// intermediate pass targets
+// shader passes render into textures from a small pool keyed on their exact
+// size (passes sample the whole texture, so it can't be rounded up). a core
+// that flips between video modes gets the targets it used last time back
+// instead of reallocating, and each target keeps its own FBO attached.
+#define PASS_TARGETS 12
+
+typedef struct PassTarget {
+	GLuint texture;
+	GLuint fbo;
+	int w;
+	int h;
+	int in_use;
+	int last_used; // frame_count when it was released
+} PassTarget;
+static PassTarget pass_targets[PASS_TARGETS];
+
+static PassTarget* findPassTarget(GLuint texture) {
+	if (!texture) return NULL;
+	for (int i = 0; i < PASS_TARGETS; i++) {
+		if (pass_targets[i].texture == texture) return &pass_targets[i];
+	}
+	return NULL;
+}
+
+// gives a target back to the pool, it keeps its storage until evicted
+static void releasePassTarget(GLuint texture) {
+	PassTarget* target = findPassTarget(texture);
+	if (!target || !target->in_use) return;
+	target->in_use = 0;
+	target->last_used = frame_count;
+}
+
+// returns a texture of exactly w x h with its FBO, reusing current if it already fits
+static GLuint acquirePassTarget(GLuint current, int w, int h, int filter) {
+	PassTarget* target = findPassTarget(current);
+	if (!target || target->w != w || target->h != h) {
+		releasePassTarget(current);
+		target = NULL;
+
+		PassTarget* empty = NULL;
+		PassTarget* oldest = NULL;
+		for (int i = 0; i < PASS_TARGETS; i++) {
+			PassTarget* candidate = &pass_targets[i];
+			if (!candidate->texture) {
+				if (!empty) empty = candidate;
+				continue;
+			}
+			if (candidate->in_use) continue;
+			if (candidate->w == w && candidate->h == h) {
+				target = candidate;
+				break;
+			}
+			if (!oldest || candidate->last_used < oldest->last_used) oldest = candidate;
+		}
+
+		if (!target) {
+			target = empty;
+			if (!target && oldest) {
+				LOG_info("pass target pool full, dropping %ix%i\n", oldest->w, oldest->h);
+				glDeleteFramebuffers(1, &oldest->fbo);
+				glDeleteTextures(1, &oldest->texture);
+				memset(oldest, 0, sizeof(PassTarget));
+				target = oldest;
+			}
+			if (!target) {
+				LOG_error("no free pass target for %ix%i\n", w, h);
+				return current;
+			}
+
+			glGenTextures(1, &target->texture);
+			glBindTexture(GL_TEXTURE_2D, target->texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+			glGenFramebuffers(1, &target->fbo);
+			glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->texture, 0);
+			target->w = w;
+			target->h = h;
+			LOG_info("allocated pass target %ix%i\n", w, h);
+		}
+		target->in_use = 1;
+	}
+
+	// filter is just sampler state, no need to touch the storage for it
+	glBindTexture(GL_TEXTURE_2D, target->texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	return target->texture;
+}
+
+static GLuint passTargetFBO(GLuint texture) {
+	PassTarget* target = findPassTarget(texture);
+	return target ? target->fbo : 0;
+}
+
+// set when something else touched the context, runShaderPass drops its cached bindings
+static int gl_state_lost = 0;
+
 void runShaderPass(GLuint src_texture, GLuint shader_program, GLuint* target_texture,
                    int x, int y, int dst_width, int dst_height, Shader* shader, int alpha, int filter) {
 
 	static GLuint static_VAO = 0, static_VBO = 0;
 	static GLuint last_program = 0;
+	static GLuint lastfbo = -1;
+	static GLuint last_bound_texture = 0;
 	static GLfloat last_texelSize[2] = {-1.0f, -1.0f};
 	static GLfloat texelSize[2] = {-1.0f, -1.0f};
-	static GLuint fbo = 0;
+
+	if (gl_state_lost) {
+		last_program = 0;
+		lastfbo = -1;
+		last_bound_texture = 0;
+		gl_state_lost = 0;
+	}
 	texelSize[0] = 1.0f / shader->texw;
 	texelSize[1] = 1.0f / shader->texh;
 
@@ -1756,34 +2041,19 @@ void runShaderPass(GLuint src_texture, GLuint shader_program, GLuint* target_tex
 		}
 		glBindVertexArray(static_VAO);
 	}
-	static GLuint lastfbo = -1;
 	if (target_texture) {
 		if (*target_texture==0 || shader->updated || reloadShaderTextures) { 
-			
-			// if(target_texture) {
-			// 	glDeleteTextures(1,target_texture);
-			// }
-			if(*target_texture==0)
-				glGenTextures(1, target_texture);
-			glBindTexture(GL_TEXTURE_2D, *target_texture);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dst_width, dst_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+			glActiveTexture(GL_TEXTURE0);
+			*target_texture = acquirePassTarget(*target_texture, dst_width, dst_height, filter);
+			last_bound_texture = *target_texture;
+			lastfbo = -1; // a fresh target leaves its own fbo bound
 			shader->updated = 0;
 		}
-		if (fbo == 0) {
-			glGenFramebuffers(1, &fbo);
+		GLuint target_fbo = passTargetFBO(*target_texture);
+		if (lastfbo != target_fbo) {
+			glBindFramebuffer(GL_FRAMEBUFFER, target_fbo);
 		}
-		
-		if (lastfbo == 0) {
-			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-			
-		}
-		lastfbo = fbo;
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, *target_texture, 0);
-		
+		lastfbo = target_fbo;
     } else {
 		// things like overlays and stuff we don't need to write to another texture so they can be directly written to screen framebuffer
 		if (lastfbo != 0) {
@@ -1799,7 +2069,6 @@ void runShaderPass(GLuint src_texture, GLuint shader_program, GLuint* target_tex
 		glDisable(GL_BLEND);
 	}
 
-	static GLuint last_bound_texture = 0;
 	if (src_texture != last_bound_texture) {
 		glBindTexture(GL_TEXTURE_2D, src_texture);
 		last_bound_texture = src_texture;
@@ -1819,76 +2088,302 @@ void runShaderPass(GLuint src_texture, GLuint shader_program, GLuint* target_tex
 	last_program = shader_program;
 }
 
-typedef struct {
-    SDL_Surface* loaded_effect;
-    SDL_Surface* loaded_overlay;
-    int effect_ready;
-    int overlay_ready;
-} FramePreparation;
-
-static FramePreparation frame_prep = {0};
-
-int prepareFrameThread(void *data) {
-    while (1) {
-		updateEffect();
-
-        if (effectUpdated) {
-			LOG_info("effect updated %s\n",effect_path);
-			if(effect_path) {
-				SDL_Surface* tmp = IMG_Load(effect_path);
-				if (tmp) {
-					frame_prep.loaded_effect = SDL_ConvertSurfaceFormat(tmp, SDL_PIXELFORMAT_RGBA32, 0);
-					SDL_FreeSurface(tmp);
-				} else {
-					frame_prep.loaded_effect = 0;
-				}
-			} else {
-				frame_prep.loaded_effect = 0;
-			}
-			effectUpdated = 0;
-			frame_prep.effect_ready = 1; 
-        }
-		if(effect.type == EFFECT_NONE && frame_prep.loaded_effect !=0) {
-			frame_prep.loaded_effect = 0;
-			frame_prep.effect_ready = 1;
-	
+
+///////////////////////////////
+
+// gpu timing
+// with the debug hud on every section of PLAT_GL_Swap is wrapped in a timer
+// query and the results are read back a few frames later so nothing stalls.
+// drivers without timer queries get cpu timing with a fence wait after each
+// section instead, that serializes the gpu but only while debugging.
+
+#define GPU_TIMING_PATH USERDATA_PATH "/logs/gputiming.txt"
+#define GPU_TIMING_FRAMES 3 // frames of queries in flight
+#define GPU_TIMING_DUMP_FRAMES 300
+
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+
+enum {
+	TIMING_UPLOAD,
+	TIMING_PASS, // one per shader pass
+	TIMING_PRESENT = TIMING_PASS + MAXSHADERS,
+	TIMING_EFFECT,
+	TIMING_OVERLAY,
+	TIMING_COUNT
+};
+
+typedef void (*GetQueryObjectui64v)(GLuint id, GLenum pname, GLuint64* params);
+
+static struct {
+	int enabled;
+	int initialized;
+	int timer_query;
+	GetQueryObjectui64v getQueryObjectui64v;
+	GLuint queries[GPU_TIMING_FRAMES][TIMING_COUNT];
+	int issued[GPU_TIMING_FRAMES][TIMING_COUNT];
+	int slot;
+	Uint64 cpu_start;
+	float avg[TIMING_COUNT]; // ms, moving averages
+	float swap;
+	int samples;
+	int dump_counter;
+} timing;
+
+void PLAT_GL_enableTiming(int enabled) {
+	if (timing.enabled && !enabled) {
+		memset(timing.avg, 0, sizeof(timing.avg));
+		timing.swap = 0;
+		timing.samples = 0;
+	}
+	timing.enabled = enabled;
+}
+
+static float timingElapsed(Uint64 start) {
+	return (float)((SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+}
+
+static void timingAccumulate(float* avg, float ms) {
+	*avg = *avg == 0 ? ms : *avg * 0.95f + ms * 0.05f;
+}
+
+static void timingBeginFrame(void) {
+	if (!timing.enabled) return;
+
+	if (!timing.initialized) {
+		timing.initialized = 1;
+		if (SDL_GL_ExtensionSupported("GL_ARB_timer_query")) {
+			timing.getQueryObjectui64v = (GetQueryObjectui64v)SDL_GL_GetProcAddress("glGetQueryObjectui64v");
 		}
+		timing.timer_query = timing.getQueryObjectui64v != NULL;
+		if (timing.timer_query) glGenQueries(GPU_TIMING_FRAMES * TIMING_COUNT, &timing.queries[0][0]);
+		LOG_info("gpu timing: %s\n", timing.timer_query ? "timer queries" : "fenced cpu timing");
+	}
+	if (!timing.timer_query) return;
 
-        if (overlayUpdated) {
-
-			LOG_info("overlay updated\n");
-			if(overlay_path) {
-				SDL_Surface* tmp = IMG_Load(overlay_path);
-				if (tmp) {
-					frame_prep.loaded_overlay = SDL_ConvertSurfaceFormat(tmp, SDL_PIXELFORMAT_RGBA32, 0);
-					SDL_FreeSurface(tmp);
-				} else {
-					frame_prep.loaded_overlay = 0;
-				}
-			} else {
-				frame_prep.loaded_overlay = 0;
-			}
-			frame_prep.overlay_ready = 1;
-			overlayUpdated=0;
-        }
+	GLint disjoint = 0; // desktop timers don't go disjoint
 
-        SDL_Delay(120); 
-    }
-    return 0;
+	timing.slot = (timing.slot + 1) % GPU_TIMING_FRAMES;
+	for (int i = 0; i < TIMING_COUNT; i++) {
+		if (!timing.issued[timing.slot][i]) continue;
+		timing.issued[timing.slot][i] = 0;
+
+		GLuint query = timing.queries[timing.slot][i];
+		GLuint available = 0;
+		glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available || disjoint) continue; // dropped, the query gets reused below
+
+		GLuint64 ns = 0;
+		timing.getQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+		timingAccumulate(&timing.avg[i], ns / 1000000.0f);
+	}
 }
 
-static SDL_Thread *prepare_thread = NULL;
+static void timingBegin(int section) {
+	if (!timing.enabled) return;
+	if (timing.timer_query) glBeginQuery(GL_TIME_ELAPSED_EXT, timing.queries[timing.slot][section]);
+	else timing.cpu_start = SDL_GetPerformanceCounter();
+}
 
-void PLAT_GL_Swap() {
+static void timingEnd(int section) {
+	if (!timing.enabled) return;
+	if (timing.timer_query) {
+		glEndQuery(GL_TIME_ELAPSED_EXT);
+		timing.issued[timing.slot][section] = 1;
+	}
+	else {
+		GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000); // 1s
+		glDeleteSync(fence);
+		timingAccumulate(&timing.avg[section], timingElapsed(timing.cpu_start));
+	}
+}
 
-	if (prepare_thread == NULL) {
-        prepare_thread = SDL_CreateThread(prepareFrameThread, "PrepareFrameThread", NULL);
+static void timingDump(void) {
+	FILE* file = fopen(GPU_TIMING_PATH, "w");
+	if (!file) return;
+	fprintf(file, "%s / %s (%s)\n", glGetString(GL_RENDERER), glGetString(GL_VERSION), timing.timer_query ? "timer queries" : "fenced cpu timing");
+	fprintf(file, "upload %.3fms %ix%i\n", timing.avg[TIMING_UPLOAD], vid.blit ? vid.blit->src_w : 0, vid.blit ? vid.blit->src_h : 0);
+	for (int i = 0; i < nrofshaders; i++) {
+		fprintf(file, "pass%i %.3fms %s %ix%i\n", i + 1, timing.avg[TIMING_PASS + i], shaders[i]->filename, shaders[i]->texw, shaders[i]->texh);
+	}
+	fprintf(file, "present %.3fms\n", timing.avg[TIMING_PRESENT]);
+	fprintf(file, "effect %.3fms\n", timing.avg[TIMING_EFFECT]);
+	fprintf(file, "overlay %.3fms\n", timing.avg[TIMING_OVERLAY]);
+	fprintf(file, "swap %.3fms (cpu, includes vsync)\n", timing.swap);
+	fclose(file);
+}
+
+static void timingEndFrame(float swap_ms) {
+	if (!timing.enabled) return;
+	timingAccumulate(&timing.swap, swap_ms);
+	timing.samples += 1;
+	if (++timing.dump_counter >= GPU_TIMING_DUMP_FRAMES) {
+		timing.dump_counter = 0;
+		timingDump();
+	}
+}
 
-        if (prepare_thread == NULL) {
-            printf("Error creating background thread: %s\n", SDL_GetError());
-            return; 
-        }
-    }
+void PLAT_GL_getTimings(GPUTimings* out) {
+	memset(out, 0, sizeof(GPUTimings));
+	out->valid = timing.enabled && timing.samples > GPU_TIMING_FRAMES;
+	out->timer_query = timing.timer_query;
+	out->passes = nrofshaders;
+	out->upload = timing.avg[TIMING_UPLOAD];
+	for (int i = 0; i < MAXSHADERS; i++) out->pass[i] = timing.avg[TIMING_PASS + i];
+	out->present = timing.avg[TIMING_PRESENT];
+	out->effect = timing.avg[TIMING_EFFECT];
+	out->overlay = timing.avg[TIMING_OVERLAY];
+	out->swap = timing.swap;
+}
+
+// set when the core duped its frame, the source texture and every pass
+// that doesn't animate on FrameCount already hold this frame's output
+static int repeat_frame = 0;
+void PLAT_GL_repeatFrame(void) {
+	repeat_frame = 1;
+}
+
+///////////////////////////////
+
+// hardware rendering
+// gl cores draw into hw.fbo on our context. each frame PLAT_GL_Swap blits
+// the used part of it into the source texture, flipping it top down like a
+// software frame, so the shader chain runs unchanged and nothing goes
+// through the cpu. the core is free to trash any gl state in between.
+
+static struct {
+	GLuint fbo;
+	GLuint color;
+	GLuint depth;
+	GLuint copy_fbo;
+	int w;
+	int h;
+	int bottom_left;
+} hw;
+
+// set when the frame handed to the next swap was rendered into hw.fbo
+static int hw_frame = 0;
+
+int PLAT_GL_supportsHWRender(int gles, int major, int minor) {
+	if (gles) return 0;
+
+	// a core profile has none of the fixed function api legacy gl cores rely on
+	GLint profile = 0;
+	glGetIntegerv(GL_CONTEXT_PROFILE_MASK, &profile);
+	if ((profile & GL_CONTEXT_CORE_PROFILE_BIT) && major < 3) return 0;
+
+	GLint ctx_major = 0, ctx_minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &ctx_major);
+	glGetIntegerv(GL_MINOR_VERSION, &ctx_minor);
+	return major * 10 + minor <= ctx_major * 10 + ctx_minor;
+}
+
+// (re)allocates storage, the fbo name stays the same so cores can cache it
+int PLAT_GL_initHWRender(int width, int height, int depth, int stencil, int bottom_left) {
+	SDL_GL_MakeCurrent(vid.window, vid.gl_context);
+
+	if (!hw.fbo) {
+		glGenFramebuffers(1, &hw.fbo);
+		glGenRenderbuffers(1, &hw.color);
+	}
+	glBindRenderbuffer(GL_RENDERBUFFER, hw.color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindFramebuffer(GL_FRAMEBUFFER, hw.fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, hw.color);
+
+	if (depth || stencil) {
+		if (!hw.depth) glGenRenderbuffers(1, &hw.depth);
+		glBindRenderbuffer(GL_RENDERBUFFER, hw.depth);
+		glRenderbufferStorage(GL_RENDERBUFFER, stencil ? GL_DEPTH24_STENCIL8 : GL_DEPTH_COMPONENT24, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, hw.depth);
+	}
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		LOG_error("hw render fbo incomplete: 0x%x\n", status);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		PLAT_GL_quitHWRender();
+		return 0;
+	}
+
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	gl_state_lost = 1;
+
+	hw.w = width;
+	hw.h = height;
+	hw.bottom_left = bottom_left;
+	LOG_info("hw render target %ix%i depth:%i stencil:%i\n", width, height, depth, stencil);
+	return 1;
+}
+
+void PLAT_GL_quitHWRender(void) {
+	if (hw.copy_fbo) glDeleteFramebuffers(1, &hw.copy_fbo);
+	if (hw.fbo) glDeleteFramebuffers(1, &hw.fbo);
+	if (hw.color) glDeleteRenderbuffers(1, &hw.color);
+	if (hw.depth) glDeleteRenderbuffers(1, &hw.depth);
+	memset(&hw, 0, sizeof(hw));
+	hw_frame = 0;
+}
+
+uintptr_t PLAT_GL_getHWFramebuffer(void) {
+	return hw.fbo;
+}
+
+void* PLAT_GL_getProcAddress(const char* sym) {
+	return SDL_GL_GetProcAddress(sym);
+}
+
+void PLAT_GL_presentHWFrame(void) {
+	hw_frame = 1;
+}
+
+// puts back whatever the core may have changed that the swap relies on
+static void restoreHWState(void) {
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindSampler(0, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_STENCIL_TEST);
+	glDisable(GL_SCISSOR_TEST);
+	glDisable(GL_CULL_FACE);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glBlendEquation(GL_FUNC_ADD);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	gl_state_lost = 1;
+}
+
+// copies the w x h the core rendered into texture, which must already have that size
+static void blitHWFrame(GLuint texture, int w, int h) {
+	if (w > hw.w) w = hw.w;
+	if (h > hw.h) h = hw.h;
+	if (!hw.copy_fbo) glGenFramebuffers(1, &hw.copy_fbo);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, hw.fbo);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, hw.copy_fbo);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	if (hw.bottom_left) glBlitFramebuffer(0, 0, w, h, 0, h, w, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	else glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	gl_state_lost = 1;
+}
+
+void PLAT_GL_Swap() {
+	int repeat = repeat_frame;
+	repeat_frame = 0;
+	int from_hw = hw_frame && hw.fbo;
+	hw_frame = 0;
+
+	if (hw.fbo) restoreHWState();
 
     static int lastframecount = 0;
     if (reloadShaderTextures) lastframecount = frame_count;
@@ -1903,54 +2398,55 @@ void PLAT_GL_Swap() {
     }
 
 	SDL_GL_MakeCurrent(vid.window, vid.gl_context);
+	timingBeginFrame();
 
     static GLuint effect_tex = 0;
     static int effect_w = 0, effect_h = 0;
     static GLuint overlay_tex = 0;
     static int overlay_w = 0, overlay_h = 0;
-    static int overlayload = 0;
+    SDL_Surface* image;
 
-
-	 if (frame_prep.effect_ready) {
-		if(frame_prep.loaded_effect) {
+	if (takeAsset(LAYER_EFFECT, &image)) {
+		if(image) {
 			if(!effect_tex) glGenTextures(1, &effect_tex);
 			glBindTexture(GL_TEXTURE_2D, effect_tex);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, frame_prep.loaded_effect->w, frame_prep.loaded_effect->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, frame_prep.loaded_effect->pixels);
-			effect_w = frame_prep.loaded_effect->w;
-			effect_h = frame_prep.loaded_effect->h;
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image->w, image->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, image->pixels);
+			gl_state_lost = 1; // bound behind runShaderPass's back
+			effect_w = image->w;
+			effect_h = image->h;
+			SDL_FreeSurface(image);
 		} else {
 			if (effect_tex) {
 				glDeleteTextures(1, &effect_tex);
 			}
 			effect_tex = 0;
 		}
-        frame_prep.effect_ready = 0; 
-    }
+	}
 
-    if (frame_prep.overlay_ready) {
-		if(frame_prep.loaded_overlay) {
+	if (takeAsset(LAYER_OVERLAY, &image)) {
+		if(image) {
 			if(!overlay_tex) glGenTextures(1, &overlay_tex);
 			glBindTexture(GL_TEXTURE_2D, overlay_tex);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, frame_prep.loaded_overlay->w, frame_prep.loaded_overlay->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, frame_prep.loaded_overlay->pixels);
-			overlay_w = frame_prep.loaded_overlay->w;
-			overlay_h = frame_prep.loaded_overlay->h;
-		
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image->w, image->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, image->pixels);
+			gl_state_lost = 1; // bound behind runShaderPass's back
+			overlay_w = image->w;
+			overlay_h = image->h;
+			SDL_FreeSurface(image);
 		} else {
 			if (overlay_tex) {
 				glDeleteTextures(1, &overlay_tex);
 			}
 			overlay_tex = 0;
 		}
-        frame_prep.overlay_ready = 0; 
-    }
+	}
 	
     static GLuint src_texture = 0;
     static int src_w_last = 0, src_h_last = 0;
@@ -1970,20 +2466,48 @@ void PLAT_GL_Swap() {
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     }
 
-    glBindTexture(GL_TEXTURE_2D, src_texture);
-    if (vid.blit->src_w != src_w_last || vid.blit->src_h != src_h_last || reloadShaderTextures) {
+    repeat = repeat && !reloadShaderTextures && vid.blit->src_w == src_w_last && vid.blit->src_h == src_h_last;
+
+    // first pass that has to run again, everything after it consumes its output
+    int first_dirty = nrofshaders;
+    if (repeat) {
+        for (int i = 0; i < nrofshaders; i++) {
+            if (shaders[i]->u_FrameCount >= 0 || shaders[i]->updated) {
+                first_dirty = i;
+                break;
+            }
+        }
+    }
+    else first_dirty = 0;
+
+    // a repeat binds nothing here, runShaderPass's cached binding has to stay true
+    if (!repeat) glBindTexture(GL_TEXTURE_2D, src_texture);
+    timingBegin(TIMING_UPLOAD);
+    if (repeat) {
+        // nothing to upload
+    } else if (from_hw) {
+        if (vid.blit->src_w != src_w_last || vid.blit->src_h != src_h_last || reloadShaderTextures) {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, vid.blit->src_w, vid.blit->src_h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            src_w_last = vid.blit->src_w;
+            src_h_last = vid.blit->src_h;
+        }
+        blitHWFrame(src_texture, vid.blit->src_w, vid.blit->src_h);
+    } else if (vid.blit->src_w != src_w_last || vid.blit->src_h != src_h_last || reloadShaderTextures) {
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, vid.blit->src_w, vid.blit->src_h, 0, GL_RGBA, GL_UNSIGNED_BYTE, vid.blit->src);
         src_w_last = vid.blit->src_w;
         src_h_last = vid.blit->src_h;
     } else {
         glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, vid.blit->src_w, vid.blit->src_h, GL_RGBA, GL_UNSIGNED_BYTE, vid.blit->src);
     }
+    timingEnd(TIMING_UPLOAD);
 
     if (nrofshaders < 1) {
+        timingBegin(TIMING_PRESENT);
         runShaderPass(src_texture, g_shader_default, NULL, dst_rect.x, dst_rect.y,
             dst_rect.w, dst_rect.h,
             &(Shader){.srcw = vid.blit->src_w, .srch = vid.blit->src_h, .texw = vid.blit->src_w, .texh = vid.blit->src_h},
             0, GL_NONE);
+        timingEnd(TIMING_PRESENT);
     }
 
     last_w = vid.blit->src_w;
@@ -2029,6 +2553,13 @@ void PLAT_GL_Swap() {
         }
         shaderinfocount++;
 
+        if (i < first_dirty) {
+            last_w = dst_w;
+            last_h = dst_h;
+            continue;
+        }
+
+        timingBegin(TIMING_PASS + i);
         if (shaders[i]->shader_p) {
             runShaderPass(
                 (i == 0) ? src_texture : shaders[i - 1]->texture,
@@ -2050,12 +2581,14 @@ void PLAT_GL_Swap() {
                 (i == nrofshaders - 1) ? finalScaleFilter : shaders[i + 1]->filter
             );
         }
+        timingEnd(TIMING_PASS + i);
 
         last_w = dst_w;
         last_h = dst_h;
     }
 
     if (nrofshaders > 0) {
+        timingBegin(TIMING_PRESENT);
         runShaderPass(
             shaders[nrofshaders - 1]->texture,
             g_shader_default,
@@ -2064,9 +2597,11 @@ void PLAT_GL_Swap() {
             &(Shader){.srcw = last_w, .srch = last_h, .texw = last_w, .texh = last_h},
             0, GL_NONE
         );
+        timingEnd(TIMING_PRESENT);
     }
 
     if (effect_tex) {
+        timingBegin(TIMING_EFFECT);
         runShaderPass(
             effect_tex,
             g_shader_overlay,
@@ -2075,9 +2610,11 @@ void PLAT_GL_Swap() {
             &(Shader){.srcw = effect_w, .srch = effect_h, .texw = effect_w, .texh = effect_h},
             1, GL_NONE
         );
+        timingEnd(TIMING_EFFECT);
     }
 
     if (overlay_tex) {
+        timingBegin(TIMING_OVERLAY);
         runShaderPass(
             overlay_tex,
             g_shader_overlay,
@@ -2086,9 +2623,12 @@ void PLAT_GL_Swap() {
             &(Shader){.srcw = vid.blit->src_w, .srch = vid.blit->src_h, .texw = overlay_w, .texh = overlay_h},
             1, GL_NONE
         );
+        timingEnd(TIMING_OVERLAY);
     }
 
+    Uint64 swap_start = SDL_GetPerformanceCounter();
     SDL_GL_SwapWindow(vid.window);
+    timingEndFrame(timingElapsed(swap_start));
     frame_count++;
     reloadShaderTextures = 0;
 }
@@ -2119,13 +2659,54 @@ void PLAT_pixelFlipper(uint8_t* pixels, int width, int height) {
     }
 }
 
+// screen captures are blitted upside down into their own renderbuffer first so
+// the rows come back top-down and nothing has to be flipped on the cpu
+static struct {
+	GLuint fbo;
+	GLuint rbo;
+	GLuint pbo;
+	GLsync fence;
+	int w;
+	int h;
+	int pending;
+	int pending_w; // size of the readback in the pbo, the renderbuffer may have moved on
+	int pending_h;
+} capture = {0};
+
+// leaves the flipped copy of the current frame bound as GL_READ_FRAMEBUFFER
+static int captureFlipped(int width, int height) {
+	if (!capture.fbo) {
+		glGenFramebuffers(1, &capture.fbo);
+		glGenRenderbuffers(1, &capture.rbo);
+	}
+	if (capture.w != width || capture.h != height) {
+		glBindRenderbuffer(GL_RENDERBUFFER, capture.rbo);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, capture.fbo);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, capture.rbo);
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			LOG_error("capture framebuffer incomplete: 0x%x\n", status);
+			capture.w = capture.h = 0;
+			return 0;
+		}
+		capture.w = width;
+		capture.h = height;
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, capture.fbo);
+	glBlitFramebuffer(0, 0, width, height, 0, height, width, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, capture.fbo);
+	return 1;
+}
+
 unsigned char* PLAT_GL_screenCapture(int* outWidth, int* outHeight) {
-    glViewport(0, 0, device_width, device_height);
-    GLint viewport[4];
-    glGetIntegerv(GL_VIEWPORT, viewport);
-	
-    int width = viewport[2];
-    int height = viewport[3];
+    int width = device_width;
+    int height = device_height;
 
     if (outWidth) *outWidth = width;
     if (outHeight) *outHeight = height;
@@ -2133,13 +2714,80 @@ unsigned char* PLAT_GL_screenCapture(int* outWidth, int* outHeight) {
     unsigned char* pixels = malloc(width * height * 4); // RGBA
     if (!pixels) return NULL;
 
-    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-
-	PLAT_pixelFlipper(pixels, width, height);
+	if (captureFlipped(width, height)) {
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+	else {
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		PLAT_pixelFlipper(pixels, width, height);
+	}
 
     return pixels; // caller must free
 }
 
+int PLAT_GL_screenCaptureAsync(void) {
+	if (capture.pending) {
+		// only one readback in flight, land the previous one first
+		unsigned char* pixels = PLAT_GL_screenCapturePoll(NULL, NULL, 1);
+		if (pixels) free(pixels);
+	}
+
+	int width = device_width;
+	int height = device_height;
+	if (!captureFlipped(width, height)) return 0;
+
+	if (!capture.pbo) glGenBuffers(1, &capture.pbo);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pbo);
+	glBufferData(GL_PIXEL_PACK_BUFFER, width * height * 4, NULL, GL_STREAM_READ);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	capture.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush(); // make sure the fence actually gets submitted
+	capture.pending = 1;
+	capture.pending_w = width;
+	capture.pending_h = height;
+	return 1;
+}
+
+unsigned char* PLAT_GL_screenCapturePoll(int* outWidth, int* outHeight, int wait) {
+	if (!capture.pending) return NULL;
+
+	GLenum result = glClientWaitSync(capture.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000000 : 0); // 1s
+	if (result == GL_TIMEOUT_EXPIRED && !wait) return NULL;
+	glDeleteSync(capture.fence);
+	capture.fence = 0;
+	capture.pending = 0;
+	if (result == GL_WAIT_FAILED || result == GL_TIMEOUT_EXPIRED) {
+		LOG_error("screen capture readback failed\n");
+		return NULL;
+	}
+
+	int width = capture.pending_w;
+	int height = capture.pending_h;
+	size_t size = width * height * 4;
+	unsigned char* pixels = malloc(size);
+	if (pixels) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pbo);
+		void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+		if (mapped) {
+			memcpy(pixels, mapped, size);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		else {
+			free(pixels);
+			pixels = NULL;
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+
+	if (outWidth) *outWidth = width;
+	if (outHeight) *outHeight = height;
+	return pixels; // caller must free
+}
+
 ///////////////////////////////
 
 // TODO: 
@@ -71,6 +71,13 @@ if [ -f "$UPDATE_PATH" ]; then
 	if [ -f $SYSTEM_PATH/$PLATFORM/bin/install.sh ]; then
 		$SYSTEM_PATH/$PLATFORM/bin/install.sh # &> $SDCARD_PATH/log.txt
 	fi
+
+	# build the shader program cache for the new binaries while the ui starts up
+	WARM_PATH="$SYSTEM_PATH/$PLATFORM/bin/shaderwarm.elf"
+	if [ -f "$WARM_PATH" ]; then
+		mkdir -p "$SDCARD_PATH/.userdata/$PLATFORM/logs"
+		LD_LIBRARY_PATH="$SYSTEM_PATH/$PLATFORM/lib:$LD_LIBRARY_PATH" nice -n 19 "$WARM_PATH" > "$SDCARD_PATH/.userdata/$PLATFORM/logs/shaderwarm.txt" 2>&1 &
+	fi
 fi
 
 LAUNCH_PATH="$SYSTEM_PATH/$PLATFORM/paks/MinUI.pak/launch.sh"
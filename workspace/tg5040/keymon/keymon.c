@@ -7,12 +7,16 @@
 #include <dirent.h>
 #include <linux/input.h>
 #include <pthread.h>
+#include <errno.h>
+#include <time.h>
 
 #include <msettings.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
 
 // #include "defines.h"
 
@@ -40,8 +44,13 @@
 
 #define MUTE_STATE_PATH "/sys/class/gpio/gpio243/value"
 
+#define REPEAT_DELAY_MS		300
+#define REPEAT_INTERVAL_MS	100
+#define IGNORE_AFTER_SLEEP_MS	1000
+
 #define INPUT_COUNT 4
 static int inputs[INPUT_COUNT] = {};
+static int stamped[INPUT_COUNT] = {}; // events carry boottime timestamps
 static struct input_event ev;
 
 static int getInt(char* path) {
@@ -72,150 +81,177 @@ static void* watchMute(void *arg) {
 	return 0;
 }
 
+static uint64_t getMilliseconds(clockid_t clock) {
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint32_t menu_pressed = 0;
+static uint32_t menu2_pressed = 0;
+
+// plus and minus step whichever setting the held menu button selects, and
+// repeat while held off a timerfd that's only armed while they are
+static struct {
+	int code;
+	int dir;
+	uint32_t pressed;
+	int timer;
+} repeats[] = {
+	{CODE_PLUS,   1},
+	{CODE_MINUS, -1},
+};
+#define REPEAT_COUNT (sizeof(repeats) / sizeof(repeats[0]))
+
+static void step(int dir) {
+	int val;
+	if (menu_pressed) {
+		val = GetBrightness() + dir;
+		if (val>=BRIGHTNESS_MIN && val<=BRIGHTNESS_MAX) SetBrightness(val);
+	}
+	else if (menu2_pressed) {
+		val = GetColortemp() + dir;
+		if (val>=COLORTEMP_MIN && val<=COLORTEMP_MAX) SetColortemp(val);
+	}
+	else {
+		val = GetVolume() + dir;
+		if (val>=VOLUME_MIN && val<=VOLUME_MAX) SetVolume(val);
+	}
+}
+
+static void setRepeat(int i, uint32_t pressed) {
+	repeats[i].pressed = pressed;
+	struct itimerspec spec = {};
+	if (pressed) {
+		spec.it_value.tv_nsec = REPEAT_DELAY_MS * 1000000;
+		spec.it_interval.tv_nsec = REPEAT_INTERVAL_MS * 1000000;
+	}
+	timerfd_settime(repeats[i].timer, 0, &spec, NULL); // zero disarms
+}
+
+// releases were lost with everything else
+static void releaseAll(void) {
+	menu_pressed = 0;
+	menu2_pressed = 0;
+	for (int r=0; r<REPEAT_COUNT; r++) setRepeat(r, 0);
+}
+
+static void readInput(int i, uint64_t now, int ignore_all) {
+	uint32_t val;
+	int dropped = 0;
+	while(read(inputs[i], &ev, sizeof(ev))==sizeof(ev)) {
+		if (ignore_all && !stamped[i]) continue;
+		// anything that sat in the queue this long was pressed while we were
+		// suspended or stopped (PWR_enterSleep stops us rather than suspending)
+		if (stamped[i] && (uint64_t)ev.time.tv_sec * 1000 + ev.time.tv_usec / 1000 + IGNORE_AFTER_SLEEP_MS < now) {
+			if (!dropped++) releaseAll();
+			continue;
+		}
+		val = ev.value;
+		if (ev.type==EV_SW) {
+			//printf("switch: %i\n", ev.code);
+			if (ev.code==CODE_JACK) {
+				//printf("jack: %i\n", val);
+				SetJack(val);
+			}
+			else if (ev.code==CODE_MUTE) {
+				// swallow mute val -1 on shutdown
+				if(val < 0)
+					continue;
+				// printf("mute: %i\n", val);
+				SetMute(val);
+				if (val) {
+					// tmp solution
+					system("echo 1500000 > /sys/class/motor/voltage");
+					system("echo 1 > /sys/class/gpio/gpio227/value");
+					usleep(100000);
+					system("echo 0 > /sys/class/gpio/gpio227/value");
+					usleep(100000);
+					system("echo 1 > /sys/class/gpio/gpio227/value");
+					usleep(100000);
+					system("echo 0 > /sys/class/gpio/gpio227/value");
+				}
+			}
+		}
+		if (( ev.type != EV_KEY ) || ( val > REPEAT )) continue;
+		//printf("code: %i (%i)\n", ev.code, val); fflush(stdout);
+		switch (ev.code) {
+			case CODE_MENU2:
+				menu_pressed = val;
+			break;
+			case CODE_MENU0:
+				menu2_pressed = val;
+			break;
+			default:
+				for (int r=0; r<REPEAT_COUNT; r++) {
+					if (ev.code!=repeats[r].code) continue;
+					if (val) step(repeats[r].dir);
+					setRepeat(r, val);
+				}
+			break;
+		}
+	}
+}
+
 int main (int argc, char *argv[]) {
 	InitSettings();
 	// pthread_create(&mute_pt, NULL, &watchMute, NULL);
 
-	
+	int epfd = epoll_create1(EPOLL_CLOEXEC);
+	struct epoll_event event = { .events = EPOLLIN };
+
 	char path[32];
 	for (int i=0; i<INPUT_COUNT; i++) {
 		sprintf(path, "/dev/input/event%i", i);
 		inputs[i] = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+		if (inputs[i]<0) continue;
+
+		int clock = CLOCK_BOOTTIME;
+		stamped[i] = ioctl(inputs[i], EVIOCSCLOCKID, &clock)==0;
+		event.data.u32 = i;
+		epoll_ctl(epfd, EPOLL_CTL_ADD, inputs[i], &event);
 	}
-	
-	uint32_t input;
-	uint32_t val;
-	uint32_t menu_pressed = 0;
-	uint32_t menu2_pressed = 0;
-	
-	uint32_t up_pressed = 0;
-	uint32_t up_just_pressed = 0;
-	uint32_t up_repeat_at = 0;
-	
-	uint32_t down_pressed = 0;
-	uint32_t down_just_pressed = 0;
-	uint32_t down_repeat_at = 0;
-	
-	uint8_t ignore;
-	uint32_t then;
-	uint32_t now;
-	struct timeval tod;
-	
-	gettimeofday(&tod, NULL);
-	then = tod.tv_sec * 1000 + tod.tv_usec / 1000; // essential SDL_GetTicks()
-	ignore = 0;
-	
+	for (int i=0; i<REPEAT_COUNT; i++) {
+		repeats[i].timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+		event.data.u32 = INPUT_COUNT + i;
+		epoll_ctl(epfd, EPOLL_CTL_ADD, repeats[i].timer, &event);
+	}
+
+	// boottime keeps counting through suspend and monotonic doesn't, so the gap
+	// between them grows by however long we slept. inputs that can't stamp
+	// their events with boottime have no other way to tell what's stale, so
+	// everything they queued before a suspend is dropped
+	uint64_t suspended = getMilliseconds(CLOCK_BOOTTIME) - getMilliseconds(CLOCK_MONOTONIC);
+
+	struct epoll_event events[INPUT_COUNT + REPEAT_COUNT];
 	while (1) {
-		// watchMute();
-		gettimeofday(&tod, NULL);
-		now = tod.tv_sec * 1000 + tod.tv_usec / 1000;
-		if (now-then>1000) ignore = 1; // ignore input that arrived during sleep
-		
-		for (int i=0; i<INPUT_COUNT; i++) {
-			input = inputs[i];
-			while(read(input, &ev, sizeof(ev))==sizeof(ev)) {
-				if (ignore) continue;
-				val = ev.value;
-				if (ev.type==EV_SW) {
-					//printf("switch: %i\n", ev.code);
-					if (ev.code==CODE_JACK) {
-						//printf("jack: %i\n", val);
-						SetJack(val);
-					}
-					else if (ev.code==CODE_MUTE) {
-						// swallow mute val -1 on shutdown
-						if(val < 0)
-							continue;
-						// printf("mute: %i\n", val);
-						SetMute(val);
-						if (val) {
-							// tmp solution
-							system("echo 1500000 > /sys/class/motor/voltage");
-							system("echo 1 > /sys/class/gpio/gpio227/value");
-							usleep(100000);
-							system("echo 0 > /sys/class/gpio/gpio227/value");
-							usleep(100000);
-							system("echo 1 > /sys/class/gpio/gpio227/value");
-							usleep(100000);
-							system("echo 0 > /sys/class/gpio/gpio227/value");
-						}
-					}
-				}
-				if (( ev.type != EV_KEY ) || ( val > REPEAT )) continue;
-				//printf("code: %i (%i)\n", ev.code, val); fflush(stdout);
-				switch (ev.code) {
-					case CODE_MENU2:
-						menu_pressed = val;
-					break;
-					case CODE_MENU0:
-						menu2_pressed = val;
-					break;
-					case CODE_PLUS:
-						up_pressed = up_just_pressed = val;
-						if (val) up_repeat_at = now + 300;
-					break;
-					case CODE_MINUS:
-						down_pressed = down_just_pressed = val;
-						if (val) down_repeat_at = now + 300;
-					break;
-					default:
-					break;
-				}
-			}
+		int count = epoll_wait(epfd, events, INPUT_COUNT + REPEAT_COUNT, -1);
+		if (count<0) {
+			if (errno==EINTR) continue;
+			break;
 		}
-		
-		if (ignore) {
-			menu_pressed = 0;
-			menu2_pressed = 0;
-			up_pressed = up_just_pressed = 0;
-			down_pressed = down_just_pressed = 0;
-			up_repeat_at = 0;
-			down_repeat_at = 0;
-		}
-		
-		if (up_just_pressed || (up_pressed && now>=up_repeat_at)) {
-			if (menu_pressed) {
-				val = GetBrightness();
-				if (val<BRIGHTNESS_MAX) SetBrightness(++val);
-			}
-			else if (menu2_pressed) {
-				val = GetColortemp();
-				if (val<COLORTEMP_MAX) {
-					SetColortemp(++val);
-				}
-			}
-			else {
-				val = GetVolume();
-				if (val<VOLUME_MAX) SetVolume(++val);
-			}
-			
-			if (up_just_pressed) up_just_pressed = 0;
-			else up_repeat_at += 100;
-		}
-		
-		if (down_just_pressed || (down_pressed && now>=down_repeat_at)) {
-			if (menu_pressed) {
-				val = GetBrightness();
-				if (val>BRIGHTNESS_MIN) SetBrightness(--val);
-			}
-			else if (menu2_pressed) {
-				val = GetColortemp();
-				if (val>COLORTEMP_MIN) {
-					SetColortemp(--val);
-				}
-			}
-			else {
-				val = GetVolume();
-				if (val>VOLUME_MIN) SetVolume(--val);
+
+		uint64_t now = getMilliseconds(CLOCK_BOOTTIME);
+		uint64_t now_suspended = now - getMilliseconds(CLOCK_MONOTONIC);
+		int ignore = (int64_t)(now_suspended - suspended) > IGNORE_AFTER_SLEEP_MS; // both truncated to ms, can come out 1 under
+		if (ignore) releaseAll();
+		suspended = now_suspended;
+
+		for (int e=0; e<count; e++) {
+			uint32_t id = events[e].data.u32;
+			if (id<INPUT_COUNT) {
+				readInput(id, now, ignore);
+				continue;
 			}
-			
-			if (down_just_pressed) down_just_pressed = 0;
-			else down_repeat_at += 100;
+
+			uint64_t expirations = 0;
+			int r = id - INPUT_COUNT;
+			if (read(repeats[r].timer, &expirations, sizeof(expirations))!=sizeof(expirations)) continue;
+			if (expirations>1) expirations = 1; // a backlog means we were stopped, not that the button was held
+			while (repeats[r].pressed && expirations--) step(repeats[r].dir);
 		}
-		
-		then = now;
-		ignore = 0;
-		
-		usleep(16666); // 60fps
 	}
+
+	close(epfd);
+	return 0;
 }
@@ -23,6 +23,8 @@
 #include <pthread.h>
 
 #include <dirent.h>
+#include <sys/resource.h>
+#include <EGL/egl.h>
 
 static int finalScaleFilter=GL_LINEAR;
 static int reloadShaderTextures = 1;
@@ -66,6 +68,7 @@ Shader* shaders[MAXSHADERS] = {
 };
 
 static int nrofshaders = 0; // choose between 1 and 3 pipelines, > pipelines = more cpu usage, but more shader options and shader upscaling stuff
+static void releasePassTarget(GLuint texture);
 ///////////////////////////////
 
 int is_brick = 0;
@@ -218,76 +221,6 @@ int extractPragmaParameters(const char *shaderSource, ShaderParam *params, int m
     return paramCount; // number of parameters found
 }
 
-GLuint link_program(GLuint vertex_shader, GLuint fragment_shader, const char* cache_key) {
-    char cache_path[512];
-    snprintf(cache_path, sizeof(cache_path), "/mnt/SDCARD/.shadercache/%s.bin", cache_key);
-
-    GLuint program = glCreateProgram();
-    GLint success;
-
-    // Try to load cached binary first
-    FILE *f = fopen(cache_path, "rb");
-    if (f) {
-        GLint binaryFormat;
-        fread(&binaryFormat, sizeof(GLint), 1, f);
-        fseek(f, 0, SEEK_END);
-        size_t length = ftell(f) - sizeof(GLint);
-        fseek(f, sizeof(GLint), SEEK_SET);
-        void *binary = malloc(length);
-        fread(binary, 1, length, f);
-        fclose(f);
-
-        glProgramBinary(program, binaryFormat, binary, length);
-        free(binary);
-
-        glGetProgramiv(program, GL_LINK_STATUS, &success);
-        if (success) {
-            LOG_info("Loaded shader program from cache: %s\n", cache_key);
-            return program;
-        } else {
-            LOG_info("Cache load failed, falling back to compile.\n");
-            glDeleteProgram(program);
-            program = glCreateProgram();
-        }
-    }
-
-    // Compile and link if cache failed
-    glAttachShader(program, vertex_shader);
-    glAttachShader(program, fragment_shader);
-    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
-    glLinkProgram(program);
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-
-    if (!success) {
-        GLint logLength;
-        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
-        char* log = (char*)malloc(logLength);
-        glGetProgramInfoLog(program, logLength, &logLength, log);
-        printf("Program link error: %s\n", log);
-        free(log);
-        return program;
-    }
-
-    GLint binaryLength;
-    GLenum binaryFormat;
-    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
-    void* binary = malloc(binaryLength);
-    glGetProgramBinary(program, binaryLength, NULL, &binaryFormat, binary);
-
-    mkdir("/mnt/SDCARD/.shadercache", 0755); 
-    f = fopen(cache_path, "wb");
-    if (f) {
-        fwrite(&binaryFormat, sizeof(GLenum), 1, f);
-        fwrite(binary, 1, binaryLength, f);
-        fclose(f);
-        LOG_info("Saved shader program to cache: %s\n", cache_key);
-    }
-    free(binary);
-
-    LOG_info("Program linked and cached\n");
-    return program;
-}
-
 char* load_shader_source(const char* filename) {
 	char filepath[256];
 	snprintf(filepath, sizeof(filepath), "%s", filename);
@@ -314,7 +247,8 @@ char* load_shader_source(const char* filename) {
     return source;
 }
 
-GLuint load_shader_from_file(GLenum type, const char* filename, const char* path) {
+// returns the source as handed to the compiler, caller must free
+char* preprocess_shader_source(GLenum type, const char* filename, const char* path) {
     char filepath[256];
     snprintf(filepath, sizeof(filepath), "%s/%s", path, filename);
     char* source = load_shader_source(filepath);
@@ -331,13 +265,15 @@ GLuint load_shader_from_file(GLenum type, const char* filename, const char* path
     }
     cleaned[0] = '\0';
 
-    char* line = strtok(source, "\n");
+    // the precompile thread runs this too, so no strtok
+    char* saveptr = NULL;
+    char* line = strtok_r(source, "\n", &saveptr);
     while (line) {
         if (strncmp(line, "#pragma parameter", 17) != 0) {
             strcat(cleaned, line);
             strcat(cleaned, "\n");
         }
-        line = strtok(NULL, "\n");
+        line = strtok_r(NULL, "\n", &saveptr);
     }
 
     const char* define = NULL;
@@ -450,14 +386,99 @@ GLuint load_shader_from_file(GLenum type, const char* filename, const char* path
         strcat(combined, cleaned);
     }
 
-    GLuint shader = glCreateShader(type);
-    const char* combined_ptr = combined;
-    glShaderSource(shader, 1, &combined_ptr, NULL);
-    glCompileShader(shader);
-
     free(source);
     free(cleaned);
-    free(combined);
+    return combined;
+}
+
+///////////////////////////////
+
+// shader program cache
+// programs are stored as driver binaries keyed on a hash of the exact source
+// handed to the compiler plus the driver identity, so a hit never compiles
+// anything and an edited shader or updated driver can't load a stale binary.
+
+#define SHADERCACHE_PATH SDCARD_PATH "/.shadercache"
+
+static uint64_t hash_string(uint64_t hash, const char* str) {
+	// FNV-1a, including the terminator so concatenations can't collide
+	do {
+		hash ^= (uint8_t)*str;
+		hash *= 0x100000001b3ULL;
+	} while (*str++);
+	return hash;
+}
+
+static uint64_t program_cache_key(const char* vertex_source, const char* fragment_source) {
+	const char* driver[3] = {
+		(const char*)glGetString(GL_VENDOR),
+		(const char*)glGetString(GL_RENDERER),
+		(const char*)glGetString(GL_VERSION),
+	};
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (int i = 0; i < 3; i++) hash = hash_string(hash, driver[i] ? driver[i] : "");
+	hash = hash_string(hash, vertex_source);
+	hash = hash_string(hash, fragment_source);
+	return hash;
+}
+
+static GLuint load_program_binary(const char* cache_path) {
+	FILE *f = fopen(cache_path, "rb");
+	if (!f) return 0;
+
+	GLenum binaryFormat = 0;
+	fseek(f, 0, SEEK_END);
+	long length = ftell(f) - (long)sizeof(GLenum);
+	rewind(f);
+	void* binary = length > 0 ? malloc(length) : NULL;
+	int ok = binary && fread(&binaryFormat, sizeof(GLenum), 1, f) == 1 && fread(binary, 1, length, f) == (size_t)length;
+	fclose(f);
+
+	GLuint program = 0;
+	if (ok) {
+		program = glCreateProgram();
+		glProgramBinary(program, binaryFormat, binary, length);
+		GLint success = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success) {
+			// driver rejected it, rebuild and overwrite below
+			LOG_info("Cache load failed, falling back to compile.\n");
+			glDeleteProgram(program);
+			program = 0;
+		}
+	}
+	if (binary) free(binary);
+	return program;
+}
+
+static void save_program_binary(GLuint program, const char* cache_path) {
+	GLint binaryLength = 0;
+	GLenum binaryFormat;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+	if (binaryLength <= 0) return;
+
+	void* binary = malloc(binaryLength);
+	if (!binary) return;
+	glGetProgramBinary(program, binaryLength, NULL, &binaryFormat, binary);
+
+	// written aside and renamed so a concurrent reader never sees half a binary
+	char tmp_path[512];
+	snprintf(tmp_path, sizeof(tmp_path), "%s.%i.tmp", cache_path, (int)SDL_ThreadID());
+	mkdir(SHADERCACHE_PATH, 0755);
+	FILE* f = fopen(tmp_path, "wb");
+	if (f) {
+		int ok = fwrite(&binaryFormat, sizeof(GLenum), 1, f) == 1 && fwrite(binary, 1, binaryLength, f) == (size_t)binaryLength;
+		fclose(f);
+		if (ok) rename(tmp_path, cache_path);
+		else unlink(tmp_path);
+	}
+	free(binary);
+}
+
+static GLuint compile_shader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
 
     GLint compiled;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
@@ -472,28 +493,442 @@ GLuint load_shader_from_file(GLenum type, const char* filename, const char* path
     return shader;
 }
 
+// key (optional) gets the program cache key, so the precompile pass knows which binaries are current
+static GLuint load_program_keyed(const char* path, const char* filename, int* cached, uint64_t* key_out) {
+	if (cached) *cached = 0;
+
+	char* vertex_source = preprocess_shader_source(GL_VERTEX_SHADER, filename, path);
+	char* fragment_source = preprocess_shader_source(GL_FRAGMENT_SHADER, filename, path);
+	if (!vertex_source || !fragment_source) {
+		if (vertex_source) free(vertex_source);
+		if (fragment_source) free(fragment_source);
+		return 0;
+	}
+
+	char cache_path[512];
+	uint64_t key = program_cache_key(vertex_source, fragment_source);
+	if (key_out) *key_out = key;
+	snprintf(cache_path, sizeof(cache_path), SHADERCACHE_PATH "/%016llx.bin", (unsigned long long)key);
+
+	GLuint program = load_program_binary(cache_path);
+	if (program) {
+		if (cached) *cached = 1;
+		LOG_info("Loaded shader program from cache: %s (%016llx)\n", filename, (unsigned long long)key);
+		free(vertex_source);
+		free(fragment_source);
+		return program;
+	}
+
+	GLint success;
+	program = glCreateProgram();
+	GLuint vertex_shader = compile_shader(GL_VERTEX_SHADER, vertex_source);
+	GLuint fragment_shader = compile_shader(GL_FRAGMENT_SHADER, fragment_source);
+	free(vertex_source);
+	free(fragment_source);
+
+	if (vertex_shader) glAttachShader(program, vertex_shader);
+	if (fragment_shader) glAttachShader(program, fragment_shader);
+	glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(program);
+	if (vertex_shader) glDeleteShader(vertex_shader);
+	if (fragment_shader) glDeleteShader(fragment_shader);
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+
+	if (!success) {
+		GLint logLength = 0;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+		if (logLength > 0) {
+			char* log = (char*)malloc(logLength);
+			glGetProgramInfoLog(program, logLength, &logLength, log);
+			printf("Program link error: %s\n", log);
+			free(log);
+		}
+		return program;
+	}
+
+	save_program_binary(program, cache_path);
+	LOG_info("Program linked and cached: %s (%016llx)\n", filename, (unsigned long long)key);
+	return program;
+}
+
+// returns a linked program, on failure the unlinked program is returned so callers can read its log.
+// cached (optional) reports whether it came straight from the program cache
+GLuint load_program(const char* path, const char* filename, int* cached) {
+	return load_program_keyed(path, filename, cached, NULL);
+}
+
+static uint64_t system_program_keys[3]; // kept when the precompile pass prunes the cache
+
+
 void PLAT_initShaders() {
 	SDL_GL_MakeCurrent(vid.window, vid.gl_context);
 	glViewport(0, 0, device_width, device_height);
 	
-	GLuint vertex;
-	GLuint fragment;
+	g_shader_default = load_program_keyed(SYSSHADERS_FOLDER, "default.glsl", NULL, &system_program_keys[0]);
+	g_shader_overlay = load_program_keyed(SYSSHADERS_FOLDER, "overlay.glsl", NULL, &system_program_keys[1]);
+	g_noshader = load_program_keyed(SYSSHADERS_FOLDER, "noshader.glsl", NULL, &system_program_keys[2]);
+	
+	LOG_info("default shaders loaded, %i\n\n",g_shader_default);
+}
 
-	vertex = load_shader_from_file(GL_VERTEX_SHADER, "default.glsl",SYSSHADERS_FOLDER);
-	fragment = load_shader_from_file(GL_FRAGMENT_SHADER, "default.glsl",SYSSHADERS_FOLDER);
-	g_shader_default = link_program(vertex, fragment,"defaultv2.glsl");
+// builds every shader in the shaders folder into the program cache on a
+// low priority thread with its own headless context, so picking one from
+// the menu later is just a cache hit. nothing is shared with the main
+// context, the results only travel through the cache files.
+//
+// the cache key needs the preprocessed source, so rather than doing all that
+// (and loading every binary) on each launch just to find it's all there, a
+// warm list remembers which shader files, by name, size and mtime on this
+// driver, made it into the cache and under which program key. only the ones
+// that don't match are built, and when there are none no context is created
+// at all. whenever the list changes, binaries that no listed shader (or the
+// frontend's own) uses anymore are deleted so edits and driver updates don't
+// pile up in the cache.
 
-	vertex = load_shader_from_file(GL_VERTEX_SHADER, "overlay.glsl",SYSSHADERS_FOLDER);
-	fragment = load_shader_from_file(GL_FRAGMENT_SHADER, "overlay.glsl",SYSSHADERS_FOLDER);
-	g_shader_overlay = link_program(vertex, fragment,"overlay.glsl");
+#define SHADERCACHE_WARM_PATH SHADERCACHE_PATH "/warm.txt"
 
-	vertex = load_shader_from_file(GL_VERTEX_SHADER, "noshader.glsl",SYSSHADERS_FOLDER);
-	fragment = load_shader_from_file(GL_FRAGMENT_SHADER, "noshader.glsl",SYSSHADERS_FOLDER);
-	g_noshader = link_program(vertex, fragment,"noshader.glsl");
-	
-	LOG_info("default shaders loaded, %i\n\n",g_shader_default);
+typedef struct {
+	char* name;
+	uint64_t hash; // driver, name, size and mtime
+	uint64_t key; // program cache key, once warm
+	int warm;
+} PrecompileEntry;
+
+static SDL_Thread* precompile_thread = NULL;
+static volatile int precompile_cancel = 0;
+static EGLDisplay precompile_display = EGL_NO_DISPLAY;
+static EGLConfig precompile_config = NULL;
+static PrecompileEntry* precompile_entries = NULL;
+static int precompile_count = 0;
+static int precompile_stale = 0; // warm list has shaders that changed or are gone
+
+static int precompileScan(uint64_t driver) {
+	uint64_t (*warm)[2] = NULL; // hash, key
+	int warm_count = 0;
+	FILE* f = fopen(SHADERCACHE_WARM_PATH, "r");
+	if (f) {
+		char line[64];
+		unsigned long long hash, key;
+		while (fgets(line, sizeof(line), f)) {
+			if (sscanf(line, "%llx %llx", &hash, &key) != 2) continue; // lists from before keys were kept just go cold
+			uint64_t (*grown)[2] = realloc(warm, (warm_count + 1) * sizeof(*warm));
+			if (!grown) break;
+			warm = grown;
+			warm[warm_count][0] = hash;
+			warm[warm_count][1] = key;
+			warm_count += 1;
+		}
+		fclose(f);
+	}
+	int matched = 0;
+
+	int cold = 0;
+	DIR* dir = opendir(SHADERS_FOLDER "/glsl");
+	if (dir) {
+		struct dirent* dp;
+		while ((dp = readdir(dir))) {
+			if (dp->d_name[0] == '.' || !suffixMatch(".glsl", dp->d_name)) continue;
+
+			char path[512];
+			struct stat st;
+			snprintf(path, sizeof(path), SHADERS_FOLDER "/glsl/%s", dp->d_name);
+			if (stat(path, &st) != 0) continue;
+			char stamp[64];
+			snprintf(stamp, sizeof(stamp), "%lld:%lld", (long long)st.st_size, (long long)st.st_mtime);
+			uint64_t hash = hash_string(hash_string(driver, dp->d_name), stamp);
+
+			PrecompileEntry* grown = realloc(precompile_entries, (precompile_count + 1) * sizeof(PrecompileEntry));
+			if (!grown) break;
+			precompile_entries = grown;
+			PrecompileEntry* entry = &precompile_entries[precompile_count++];
+			entry->name = strdup(dp->d_name);
+			entry->hash = hash;
+			entry->key = 0;
+			entry->warm = 0;
+			for (int i = 0; i < warm_count; i++) {
+				if (warm[i][0] == hash) {
+					entry->key = warm[i][1];
+					entry->warm = 1;
+					matched += 1;
+					break;
+				}
+			}
+			if (!entry->warm) cold += 1;
+		}
+		closedir(dir);
+	}
+	if (warm) free(warm);
+	precompile_stale = matched < warm_count;
+	return cold;
+}
+
+static int precompileKeeps(uint64_t key) {
+	for (int i = 0; i < 3; i++) {
+		if (system_program_keys[i] == key) return 1;
+	}
+	for (int i = 0; i < precompile_count; i++) {
+		if (precompile_entries[i].warm && precompile_entries[i].key == key) return 1;
+	}
+	return 0;
+}
+
+static void precompilePrune(void) {
+	DIR* dir = opendir(SHADERCACHE_PATH);
+	if (!dir) return;
+	int pruned = 0;
+	struct dirent* dp;
+	while ((dp = readdir(dir))) {
+		// only finished binaries, another process may be writing a .tmp
+		if (strlen(dp->d_name) != 20 || !suffixMatch(".bin", dp->d_name)) continue;
+		char* end = NULL;
+		uint64_t key = strtoull(dp->d_name, &end, 16);
+		if (end != dp->d_name + 16 || precompileKeeps(key)) continue;
+
+		char path[512];
+		snprintf(path, sizeof(path), SHADERCACHE_PATH "/%s", dp->d_name);
+		if (unlink(path) == 0) pruned += 1;
+	}
+	closedir(dir);
+	if (pruned) LOG_info("precompile: pruned %i stale programs from the cache\n", pruned);
+}
+
+// save writes the warm list, prune (only after a full pass) drops binaries nothing listed uses
+static void precompileFinish(int save, int prune) {
+	if (prune) precompilePrune();
+
+	// written aside and renamed like the binaries, deleted entries drop out
+	FILE* f = NULL;
+	if (save) {
+		mkdir(SHADERCACHE_PATH, 0755);
+		f = fopen(SHADERCACHE_WARM_PATH ".tmp", "w");
+	}
+	if (f) {
+		for (int i = 0; i < precompile_count; i++) {
+			if (precompile_entries[i].warm) fprintf(f, "%016llx %016llx\n", (unsigned long long)precompile_entries[i].hash, (unsigned long long)precompile_entries[i].key);
+		}
+		if (fclose(f) == 0) rename(SHADERCACHE_WARM_PATH ".tmp", SHADERCACHE_WARM_PATH);
+	}
+
+	for (int i = 0; i < precompile_count; i++) free(precompile_entries[i].name);
+	free(precompile_entries);
+	precompile_entries = NULL;
+	precompile_count = 0;
 }
 
+static int precompileShadersThread(void* data) {
+	setpriority(PRIO_PROCESS, 0, 10); // only affects this thread on linux
+
+	EGLint context_attribs[] = { EGL_CONTEXT_CLIENT_VERSION, 3, EGL_NONE };
+	EGLContext context = eglCreateContext(precompile_display, precompile_config, EGL_NO_CONTEXT, context_attribs);
+	if (context == EGL_NO_CONTEXT) {
+		LOG_error("precompile: eglCreateContext failed 0x%x\n", eglGetError());
+		precompileFinish(0, 0);
+		return 0;
+	}
+
+	// surfaceless if the driver allows it, otherwise a throwaway pbuffer
+	EGLSurface surface = EGL_NO_SURFACE;
+	if (!eglMakeCurrent(precompile_display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+		EGLint pbuffer_attribs[] = { EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE };
+		surface = eglCreatePbufferSurface(precompile_display, precompile_config, pbuffer_attribs);
+		if (surface == EGL_NO_SURFACE || !eglMakeCurrent(precompile_display, surface, surface, context)) {
+			LOG_error("precompile: no headless context available 0x%x\n", eglGetError());
+			if (surface != EGL_NO_SURFACE) eglDestroySurface(precompile_display, surface);
+			eglDestroyContext(precompile_display, context);
+			precompileFinish(0, 0);
+			return 0;
+		}
+	}
+
+	int count = 0;
+	Uint32 start = SDL_GetTicks();
+	for (int i = 0; !precompile_cancel && i < precompile_count; i++) {
+		PrecompileEntry* entry = &precompile_entries[i];
+		if (entry->warm) continue;
+		GLuint program = load_program_keyed(SHADERS_FOLDER "/glsl", entry->name, NULL, &entry->key);
+		if (program) {
+			GLint success = 0;
+			glGetProgramiv(program, GL_LINK_STATUS, &success);
+			entry->warm = success; // a broken shader is retried next launch in case it's been fixed
+			glDeleteProgram(program);
+		}
+		count += 1;
+	}
+	LOG_info("precompile: %i shaders checked in %ims%s\n", count, SDL_GetTicks() - start, precompile_cancel ? " (cancelled)" : "");
+
+	eglMakeCurrent(precompile_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (surface != EGL_NO_SURFACE) eglDestroySurface(precompile_display, surface);
+	eglDestroyContext(precompile_display, context);
+	eglReleaseThread();
+	precompileFinish(count > 0 || precompile_stale, !precompile_cancel);
+	return 0;
+}
+
+void PLAT_precompileShaders(void) {
+	if (precompile_thread) return;
+
+	// borrow the display and config sdl picked for the main context
+	SDL_GL_MakeCurrent(vid.window, vid.gl_context);
+	precompile_display = eglGetCurrentDisplay();
+	EGLContext current = eglGetCurrentContext();
+	EGLint config_id = 0;
+	EGLint num_configs = 0;
+	if (precompile_display == EGL_NO_DISPLAY || current == EGL_NO_CONTEXT
+		|| !eglQueryContext(precompile_display, current, EGL_CONFIG_ID, &config_id)
+		|| !eglChooseConfig(precompile_display, (EGLint[]){ EGL_CONFIG_ID, config_id, EGL_NONE }, &precompile_config, 1, &num_configs)
+		|| num_configs < 1) {
+		LOG_info("precompile: no egl context to borrow a config from, skipping\n");
+		return;
+	}
+
+	// same driver identity the cache keys use, from the main context
+	uint64_t driver = program_cache_key("", "");
+	int cold = precompileScan(driver);
+	if (!cold) {
+		LOG_info("precompile: all %i shaders already cached\n", precompile_count);
+		precompileFinish(precompile_stale, precompile_stale);
+		return;
+	}
+
+	precompile_cancel = 0;
+	precompile_thread = SDL_CreateThread(precompileShadersThread, "PrecompileShaders", NULL);
+	if (!precompile_thread) precompileFinish(0, 0);
+}
+
+static void stopPrecompile(void) {
+	if (!precompile_thread) return;
+	precompile_cancel = 1; // finishes the shader it's on
+	SDL_WaitThread(precompile_thread, NULL);
+	precompile_thread = NULL;
+}
+
+
+///////////////////////////////
+
+// effect and overlay images are decoded on a loader thread that sleeps on a
+// condvar until a setter queues a new path. the decoded surface is handed back
+// under the lock and PLAT_GL_Swap turns it into a texture on the render thread.
+
+enum {
+	LAYER_EFFECT,
+	LAYER_OVERLAY,
+	LAYER_COUNT,
+};
+
+typedef struct {
+	char* path; // queued path, NULL or "" clears the texture
+	int requested;
+	SDL_Surface* image; // decoded RGBA32, owned by the slot until taken
+	int ready;
+} AssetSlot;
+
+static struct {
+	SDL_Thread* thread;
+	SDL_mutex* lock;
+	SDL_cond* cond;
+	int quit;
+	AssetSlot slots[LAYER_COUNT];
+} assets;
+
+static int assetLoaderThread(void* data) {
+	THREAD_register(THREAD_HOUSEKEEPING);
+	SDL_LockMutex(assets.lock);
+	while (!assets.quit) {
+		AssetSlot* slot = NULL;
+		for (int i=0; i<LAYER_COUNT; i++) {
+			if (assets.slots[i].requested) {
+				slot = &assets.slots[i];
+				break;
+			}
+		}
+		if (!slot) {
+			SDL_CondWait(assets.cond, assets.lock);
+			continue;
+		}
+
+		char* path = slot->path;
+		slot->path = NULL;
+		slot->requested = 0;
+		SDL_UnlockMutex(assets.lock);
+
+		SDL_Surface* image = NULL;
+		if (path && *path) {
+			image = GFX_loadImage(path, SDL_PIXELFORMAT_RGBA32);
+			if (image) LOG_info("loaded asset %s\n", path);
+			else LOG_error("failed to load asset %s\n", path);
+		}
+		if (path) free(path);
+
+		SDL_LockMutex(assets.lock);
+		if (slot->requested) { // superseded while decoding
+			if (image) SDL_FreeSurface(image);
+			continue;
+		}
+		if (slot->image) SDL_FreeSurface(slot->image);
+		slot->image = image;
+		slot->ready = 1;
+	}
+	SDL_UnlockMutex(assets.lock);
+	THREAD_unregister();
+	return 0;
+}
+
+static void startAssetLoader(void) {
+	if (assets.thread) return;
+	assets.quit = 0;
+	assets.lock = SDL_CreateMutex();
+	assets.cond = SDL_CreateCond();
+	assets.thread = SDL_CreateThread(assetLoaderThread, "AssetLoader", NULL);
+	if (!assets.thread) LOG_error("Error creating asset loader thread: %s\n", SDL_GetError());
+}
+
+static void stopAssetLoader(void) {
+	if (!assets.thread) return;
+	SDL_LockMutex(assets.lock);
+	assets.quit = 1;
+	SDL_CondSignal(assets.cond);
+	SDL_UnlockMutex(assets.lock);
+	SDL_WaitThread(assets.thread, NULL);
+
+	for (int i=0; i<LAYER_COUNT; i++) {
+		if (assets.slots[i].path) free(assets.slots[i].path);
+		if (assets.slots[i].image) SDL_FreeSurface(assets.slots[i].image);
+	}
+	SDL_DestroyCond(assets.cond);
+	SDL_DestroyMutex(assets.lock);
+	memset(&assets, 0, sizeof(assets));
+}
+
+// queues path for decoding, replacing any request the loader hasn't picked up yet
+static void requestAsset(int index, const char* path) {
+	startAssetLoader();
+	if (!assets.thread) return;
+
+	SDL_LockMutex(assets.lock);
+	AssetSlot* slot = &assets.slots[index];
+	if (slot->path) free(slot->path);
+	slot->path = path ? strdup(path) : NULL;
+	slot->requested = 1;
+	SDL_CondSignal(assets.cond);
+	SDL_UnlockMutex(assets.lock);
+}
+
+// render thread only, returns 1 and hands over ownership of image (NULL to clear) when a new one is ready
+static int takeAsset(int index, SDL_Surface** image) {
+	if (!assets.thread) return 0;
+
+	int ready = 0;
+	SDL_LockMutex(assets.lock);
+	AssetSlot* slot = &assets.slots[index];
+	if (slot->ready) {
+		*image = slot->image;
+		slot->image = NULL;
+		slot->ready = 0;
+		ready = 1;
+	}
+	SDL_UnlockMutex(assets.lock);
+	return ready;
+}
 
 SDL_Surface* PLAT_initVideo(void) {
 	char* device = getenv("DEVICE");
@@ -556,6 +991,7 @@ SDL_Surface* PLAT_initVideo(void) {
 	vid.gl_context = SDL_GL_CreateContext(vid.window);
 	SDL_GL_MakeCurrent(vid.window, vid.gl_context);
 	glViewport(0, 0, w, h);
+	startAssetLoader();
 
 	vid.stream_layer1 = SDL_CreateTexture(vid.renderer,SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, w,h);
 	vid.target_layer1 = SDL_CreateTexture(vid.renderer,SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET , w,h);
@@ -594,51 +1030,6 @@ void PLAT_resetShaders() {
 
 }
 
-char* PLAT_findFileInDir(const char *directory, const char *filename) {
-    char *filename_copy = strdup(filename);
-    if (!filename_copy) {
-        perror("strdup");
-        return NULL;
-    }
-
-    // Strip extension from filename
-    char *dot_pos = strrchr(filename_copy, '.');
-    if (dot_pos) {
-        *dot_pos = '\0';
-    }
-
-    DIR *dir = opendir(directory);
-    if (!dir) {
-        perror("opendir");
-        free(filename_copy);
-        return NULL;
-    }
-
-    struct dirent *entry;
-    char *full_path = NULL;
-
-    while ((entry = readdir(dir)) != NULL) {
-        if (strstr(entry->d_name, filename_copy) == entry->d_name) {
-            full_path = (char *)malloc(strlen(directory) + strlen(entry->d_name) + 2); // +1 for slash, +1 for '\0'
-            if (!full_path) {
-                perror("malloc");
-                closedir(dir);
-                free(filename_copy);
-                return NULL;
-            }
-
-            snprintf(full_path, strlen(directory) + strlen(entry->d_name) + 2, "%s/%s", directory, entry->d_name);
-            closedir(dir);
-            free(filename_copy);
-            return full_path;
-        }
-    }
-
-    closedir(dir);
-    free(filename_copy);
-    return NULL;
-}
-
 #define MAX_SHADER_PRAGMAS 32
 void loadShaderPragmas(Shader *shader, const char *shaderSource) {
 	shader->pragmas = calloc(MAX_SHADER_PRAGMAS, sizeof(ShaderParam));
@@ -669,15 +1060,13 @@ void PLAT_updateShader(int i, const char *filename, int *scale, int *filter, int
 		const char *shaderSource  = load_shader_source(filepath);
 		loadShaderPragmas(shader,shaderSource);
 
-		GLuint vertex_shader1 = load_shader_from_file(GL_VERTEX_SHADER, filename,SHADERS_FOLDER "/glsl");
-		GLuint fragment_shader1 = load_shader_from_file(GL_FRAGMENT_SHADER, filename,SHADERS_FOLDER "/glsl");
 			
         // Link the shader program
 		if (shader->shader_p != 0) {
 			LOG_info("Deleting previous shader %i\n",shader->shader_p);
 			glDeleteProgram(shader->shader_p);
 		}
-        shader->shader_p = link_program(vertex_shader1, fragment_shader1,filename);
+        shader->shader_p = load_program(SHADERS_FOLDER "/glsl", filename, NULL);
         
 		shader->u_FrameDirection = glGetUniformLocation( shader->shader_p, "FrameDirection");
 		shader->u_FrameCount = glGetUniformLocation( shader->shader_p, "FrameCount");
@@ -734,6 +1123,10 @@ void PLAT_updateShader(int i, const char *filename, int *scale, int *filter, int
 
 void PLAT_setShaders(int nr) {
 	LOG_info("set nr of shaders to %i\n",nr);
+	for (int i = nr; i < nrofshaders; i++) {
+		releasePassTarget(shaders[i]->texture);
+		shaders[i]->texture = 0;
+	}
 	nrofshaders = nr;
 	reloadShaderTextures = 1;
 }
@@ -807,8 +1200,9 @@ static void clearVideo(void) {
 }
 
 void PLAT_quitVideo(void) {
+	stopPrecompile();
 	clearVideo();
-
+	stopAssetLoader();
 
 	glFinish();
 	SDL_GL_DeleteContext(vid.gl_context);
@@ -935,8 +1329,6 @@ static void rgb565_to_rgb888(uint32_t rgb565, uint8_t *r, uint8_t *g, uint8_t *b
     *g = (green << 2) | (green >> 4);
     *b = (blue << 3) | (blue >> 2);
 }
-static char* effect_path;
-static int effectUpdated = 0;
 static void updateEffect(void) {
 	if (effect.next_scale==effect.scale && effect.next_type==effect.type && effect.next_color==effect.color) return; // unchanged
 	
@@ -946,9 +1338,13 @@ static void updateEffect(void) {
 	effect.type = effect.next_type;
 	effect.color = effect.next_color;
 	
-	if (effect.type==EFFECT_NONE) return; // disabled
+	if (effect.type==EFFECT_NONE) { // disabled
+		requestAsset(LAYER_EFFECT, NULL);
+		return;
+	}
 	if (effect.type==effect.live_type && effect.scale==live_scale && effect.color==live_color) return; // already loaded
 	
+	char* effect_path = NULL;
 	int opacity = 128; // 1 - 1/2 = 50%
 	if (effect.type==EFFECT_LINE) {
 		if (effect.scale<3) {
@@ -1001,8 +1397,7 @@ static void updateEffect(void) {
 			opacity = 136; // 1 - 57/121 = ~52%
 		}
 	}
-	effectUpdated = 1;
-	
+	requestAsset(LAYER_EFFECT, effect_path);
 }
 int screenx = 0;
 int screeny = 0;
@@ -1016,18 +1411,18 @@ void PLAT_setOffsetY(int y) {
     screeny = y - 64; 
 	LOG_info("screeny: %i %i\n",screeny,y);
 }
-static int overlayUpdated=0;
 void PLAT_setOverlay(const char* filename, const char* tag) {
     if (vid.overlay) {
         SDL_DestroyTexture(vid.overlay);
         vid.overlay = NULL;
     }
+	if (overlay_path) free(overlay_path);
 	overlay_path = NULL;
-	overlayUpdated=1;
 
     if (!filename || strcmp(filename, "") == 0) {
 		overlay_path = strdup("");
         printf("Skipping overlay update.\n");
+		requestAsset(LAYER_OVERLAY, NULL);
         return;
     }
 
@@ -1038,11 +1433,13 @@ void PLAT_setOverlay(const char* filename, const char* tag) {
 
     if (!overlay_path) {
         perror("malloc failed");
+		requestAsset(LAYER_OVERLAY, NULL);
         return;
     }
 
     snprintf(overlay_path, path_len, "%s/%s/%s", OVERLAYS_FOLDER, tag, filename);
     printf("Overlay path set to: %s\n", overlay_path);
+	requestAsset(LAYER_OVERLAY, overlay_path);
 
 }
 
@@ -1694,9 +2091,11 @@ void PLAT_present() {
 }
 void PLAT_setEffect(int next_type) {
 	effect.next_type = next_type;
+	updateEffect();
 }
 void PLAT_setEffectColor(int next_color) {
 	effect.next_color = next_color;
+	updateEffect();
 }
 void PLAT_vsync(int remaining) {
 	if (remaining>0) SDL_Delay(remaining);
@@ -1705,6 +2104,14 @@ void PLAT_vsync(int remaining) {
 scaler_t PLAT_getScaler(GFX_Renderer* renderer) {
 	// LOG_info("getScaler for scale: %i\n", renderer->scale);
 	effect.next_scale = renderer->scale;
+	updateEffect();
+
+	// non-integer fits blend neighbouring pixels instead of dropping them
+	if (renderer->scale<0) {
+		scaler_t scaler = GFX_getAAScaler32(renderer);
+		if (scaler) return scaler;
+	}
+
 	return scale1x1_c16;
 }
 
@@ -1820,14 +2227,123 @@ void PLAT_flip(SDL_Surface* IGNORED, int ignored) {
 }
 
 static int frame_count = 0;
+
+// intermediate pass targets
+// shader passes render into textures from a small pool keyed on their exact
+// size (passes sample the whole texture, so it can't be rounded up). a core
+// that flips between video modes gets the targets it used last time back
+// instead of reallocating, and each target keeps its own FBO attached.
+#define PASS_TARGETS 12
+
+typedef struct PassTarget {
+	GLuint texture;
+	GLuint fbo;
+	int w;
+	int h;
+	int in_use;
+	int last_used; // frame_count when it was released
+} PassTarget;
+static PassTarget pass_targets[PASS_TARGETS];
+
+static PassTarget* findPassTarget(GLuint texture) {
+	if (!texture) return NULL;
+	for (int i = 0; i < PASS_TARGETS; i++) {
+		if (pass_targets[i].texture == texture) return &pass_targets[i];
+	}
+	return NULL;
+}
+
+// gives a target back to the pool, it keeps its storage until evicted
+static void releasePassTarget(GLuint texture) {
+	PassTarget* target = findPassTarget(texture);
+	if (!target || !target->in_use) return;
+	target->in_use = 0;
+	target->last_used = frame_count;
+}
+
+// returns a texture of exactly w x h with its FBO, reusing current if it already fits
+static GLuint acquirePassTarget(GLuint current, int w, int h, int filter) {
+	PassTarget* target = findPassTarget(current);
+	if (!target || target->w != w || target->h != h) {
+		releasePassTarget(current);
+		target = NULL;
+
+		PassTarget* empty = NULL;
+		PassTarget* oldest = NULL;
+		for (int i = 0; i < PASS_TARGETS; i++) {
+			PassTarget* candidate = &pass_targets[i];
+			if (!candidate->texture) {
+				if (!empty) empty = candidate;
+				continue;
+			}
+			if (candidate->in_use) continue;
+			if (candidate->w == w && candidate->h == h) {
+				target = candidate;
+				break;
+			}
+			if (!oldest || candidate->last_used < oldest->last_used) oldest = candidate;
+		}
+
+		if (!target) {
+			target = empty;
+			if (!target && oldest) {
+				LOG_info("pass target pool full, dropping %ix%i\n", oldest->w, oldest->h);
+				glDeleteFramebuffers(1, &oldest->fbo);
+				glDeleteTextures(1, &oldest->texture);
+				memset(oldest, 0, sizeof(PassTarget));
+				target = oldest;
+			}
+			if (!target) {
+				LOG_error("no free pass target for %ix%i\n", w, h);
+				return current;
+			}
+
+			glGenTextures(1, &target->texture);
+			glBindTexture(GL_TEXTURE_2D, target->texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+			glGenFramebuffers(1, &target->fbo);
+			glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->texture, 0);
+			target->w = w;
+			target->h = h;
+			LOG_info("allocated pass target %ix%i\n", w, h);
+		}
+		target->in_use = 1;
+	}
+
+	// filter is just sampler state, no need to touch the storage for it
+	glBindTexture(GL_TEXTURE_2D, target->texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	return target->texture;
+}
+
+static GLuint passTargetFBO(GLuint texture) {
+	PassTarget* target = findPassTarget(texture);
+	return target ? target->fbo : 0;
+}
+
+// set when something else touched the context, runShaderPass drops its cached bindings
+static int gl_state_lost = 0;
+
 void runShaderPass(GLuint src_texture, GLuint shader_program, GLuint* target_texture,
                    int x, int y, int dst_width, int dst_height, Shader* shader, int alpha, int filter) {
 
 	static GLuint static_VAO = 0, static_VBO = 0;
 	static GLuint last_program = 0;
+	static GLuint lastfbo = -1;
+	static GLuint last_bound_texture = 0;
 	static GLfloat last_texelSize[2] = {-1.0f, -1.0f};
 	static GLfloat texelSize[2] = {-1.0f, -1.0f};
-	static GLuint fbo = 0;
+
+	if (gl_state_lost) {
+		last_program = 0;
+		lastfbo = -1;
+		last_bound_texture = 0;
+		gl_state_lost = 0;
+	}
 
 	texelSize[0] = 1.0f / shader->texw;
 	texelSize[1] = 1.0f / shader->texh;
@@ -1888,35 +2404,19 @@ void runShaderPass(GLuint src_texture, GLuint shader_program, GLuint* target_tex
 		}
 		glBindVertexArray(static_VAO);
 	}
-	static GLuint lastfbo = -1;
 	if (target_texture) {
 		if (*target_texture==0 || shader->updated || reloadShaderTextures) { 
-			
-			// if(target_texture) {
-			// 	glDeleteTextures(1,target_texture);
-			// }
-			if(*target_texture==0)
-				glGenTextures(1, target_texture);
-			glActiveTexture(GL_TEXTURE0);	
-			glBindTexture(GL_TEXTURE_2D, *target_texture);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dst_width, dst_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+			glActiveTexture(GL_TEXTURE0);
+			*target_texture = acquirePassTarget(*target_texture, dst_width, dst_height, filter);
+			last_bound_texture = *target_texture;
+			lastfbo = -1; // a fresh target leaves its own fbo bound
 			shader->updated = 0;
 		}
-		if (fbo == 0) {
-			glGenFramebuffers(1, &fbo);
-		}
-		
-		if (lastfbo == 0) {
-			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-			
+		GLuint target_fbo = passTargetFBO(*target_texture);
+		if (lastfbo != target_fbo) {
+			glBindFramebuffer(GL_FRAMEBUFFER, target_fbo);
 		}
-		lastfbo = fbo;
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, *target_texture, 0);
-		
+		lastfbo = target_fbo;
     } else {
 		// things like overlays and stuff we don't need to write to another texture so they can be directly written to screen framebuffer
 		if (lastfbo != 0) {
@@ -1932,7 +2432,6 @@ void runShaderPass(GLuint src_texture, GLuint shader_program, GLuint* target_tex
 		glDisable(GL_BLEND);
 	}
 
-	static GLuint last_bound_texture = 0;
 	if (src_texture != last_bound_texture) {
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, src_texture);
@@ -1952,76 +2451,301 @@ void runShaderPass(GLuint src_texture, GLuint shader_program, GLuint* target_tex
 	last_program = shader_program;
 }
 
-typedef struct {
-    SDL_Surface* loaded_effect;
-    SDL_Surface* loaded_overlay;
-    int effect_ready;
-    int overlay_ready;
-} FramePreparation;
-
-static FramePreparation frame_prep = {0};
-
-int prepareFrameThread(void *data) {
-    while (1) {
-		updateEffect();
-
-        if (effectUpdated) {
-			LOG_info("effect updated %s\n",effect_path);
-			if(effect_path) {
-				SDL_Surface* tmp = IMG_Load(effect_path);
-				if (tmp) {
-					frame_prep.loaded_effect = SDL_ConvertSurfaceFormat(tmp, SDL_PIXELFORMAT_RGBA32, 0);
-					SDL_FreeSurface(tmp);
-				} else {
-					frame_prep.loaded_effect = 0;
-				}
-			} else {
-				frame_prep.loaded_effect = 0;
-			}
-			effectUpdated = 0;
-			frame_prep.effect_ready = 1; 
-        }
-		if(effect.type == EFFECT_NONE && frame_prep.loaded_effect !=0) {
-			frame_prep.loaded_effect = 0;
-			frame_prep.effect_ready = 1;
-	
+
+///////////////////////////////
+
+// gpu timing
+// with the debug hud on every section of PLAT_GL_Swap is wrapped in a timer
+// query and the results are read back a few frames later so nothing stalls.
+// drivers without timer queries get cpu timing with a fence wait after each
+// section instead, that serializes the gpu but only while debugging.
+
+#define GPU_TIMING_PATH USERDATA_PATH "/logs/gputiming.txt"
+#define GPU_TIMING_FRAMES 3 // frames of queries in flight
+#define GPU_TIMING_DUMP_FRAMES 300
+
+#ifndef GL_TIME_ELAPSED_EXT
+#define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+#ifndef GL_GPU_DISJOINT_EXT
+#define GL_GPU_DISJOINT_EXT 0x8FBB
+#endif
+
+enum {
+	TIMING_UPLOAD,
+	TIMING_PASS, // one per shader pass
+	TIMING_PRESENT = TIMING_PASS + MAXSHADERS,
+	TIMING_EFFECT,
+	TIMING_OVERLAY,
+	TIMING_COUNT
+};
+
+typedef void (*GetQueryObjectui64v)(GLuint id, GLenum pname, GLuint64* params);
+
+static struct {
+	int enabled;
+	int initialized;
+	int timer_query;
+	GetQueryObjectui64v getQueryObjectui64v;
+	GLuint queries[GPU_TIMING_FRAMES][TIMING_COUNT];
+	int issued[GPU_TIMING_FRAMES][TIMING_COUNT];
+	int slot;
+	Uint64 cpu_start;
+	float avg[TIMING_COUNT]; // ms, moving averages
+	float swap;
+	int samples;
+	int dump_counter;
+} timing;
+
+void PLAT_GL_enableTiming(int enabled) {
+	if (timing.enabled && !enabled) {
+		memset(timing.avg, 0, sizeof(timing.avg));
+		timing.swap = 0;
+		timing.samples = 0;
+	}
+	timing.enabled = enabled;
+}
+
+static float timingElapsed(Uint64 start) {
+	return (float)((SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+}
+
+static void timingAccumulate(float* avg, float ms) {
+	*avg = *avg == 0 ? ms : *avg * 0.95f + ms * 0.05f;
+}
+
+static void timingBeginFrame(void) {
+	if (!timing.enabled) return;
+
+	if (!timing.initialized) {
+		timing.initialized = 1;
+		if (SDL_GL_ExtensionSupported("GL_EXT_disjoint_timer_query")) {
+			timing.getQueryObjectui64v = (GetQueryObjectui64v)SDL_GL_GetProcAddress("glGetQueryObjectui64vEXT");
 		}
+		timing.timer_query = timing.getQueryObjectui64v != NULL;
+		if (timing.timer_query) glGenQueries(GPU_TIMING_FRAMES * TIMING_COUNT, &timing.queries[0][0]);
+		LOG_info("gpu timing: %s\n", timing.timer_query ? "timer queries" : "fenced cpu timing");
+	}
+	if (!timing.timer_query) return;
 
-        if (overlayUpdated) {
+	// reading the disjoint flag clears it, anything in flight across one is unreliable
+	GLint disjoint = 0;
+	glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
 
-			LOG_info("overlay updated\n");
-			if(overlay_path) {
-				SDL_Surface* tmp = IMG_Load(overlay_path);
-				if (tmp) {
-					frame_prep.loaded_overlay = SDL_ConvertSurfaceFormat(tmp, SDL_PIXELFORMAT_RGBA32, 0);
-					SDL_FreeSurface(tmp);
-				} else {
-					frame_prep.loaded_overlay = 0;
-				}
-			} else {
-				frame_prep.loaded_overlay = 0;
-			}
-			frame_prep.overlay_ready = 1;
-			overlayUpdated=0;
-        }
+	timing.slot = (timing.slot + 1) % GPU_TIMING_FRAMES;
+	for (int i = 0; i < TIMING_COUNT; i++) {
+		if (!timing.issued[timing.slot][i]) continue;
+		timing.issued[timing.slot][i] = 0;
 
-        SDL_Delay(120); 
-    }
-    return 0;
+		GLuint query = timing.queries[timing.slot][i];
+		GLuint available = 0;
+		glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available || disjoint) continue; // dropped, the query gets reused below
+
+		GLuint64 ns = 0;
+		timing.getQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+		timingAccumulate(&timing.avg[i], ns / 1000000.0f);
+	}
 }
 
-static SDL_Thread *prepare_thread = NULL;
+static void timingBegin(int section) {
+	if (!timing.enabled) return;
+	if (timing.timer_query) glBeginQuery(GL_TIME_ELAPSED_EXT, timing.queries[timing.slot][section]);
+	else timing.cpu_start = SDL_GetPerformanceCounter();
+}
 
-void PLAT_GL_Swap() {
+static void timingEnd(int section) {
+	if (!timing.enabled) return;
+	if (timing.timer_query) {
+		glEndQuery(GL_TIME_ELAPSED_EXT);
+		timing.issued[timing.slot][section] = 1;
+	}
+	else {
+		GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000); // 1s
+		glDeleteSync(fence);
+		timingAccumulate(&timing.avg[section], timingElapsed(timing.cpu_start));
+	}
+}
 
-	if (prepare_thread == NULL) {
-        prepare_thread = SDL_CreateThread(prepareFrameThread, "PrepareFrameThread", NULL);
+static void timingDump(void) {
+	FILE* file = fopen(GPU_TIMING_PATH, "w");
+	if (!file) return;
+	fprintf(file, "%s / %s (%s)\n", glGetString(GL_RENDERER), glGetString(GL_VERSION), timing.timer_query ? "timer queries" : "fenced cpu timing");
+	fprintf(file, "upload %.3fms %ix%i\n", timing.avg[TIMING_UPLOAD], vid.blit ? vid.blit->src_w : 0, vid.blit ? vid.blit->src_h : 0);
+	for (int i = 0; i < nrofshaders; i++) {
+		fprintf(file, "pass%i %.3fms %s %ix%i\n", i + 1, timing.avg[TIMING_PASS + i], shaders[i]->filename, shaders[i]->texw, shaders[i]->texh);
+	}
+	fprintf(file, "present %.3fms\n", timing.avg[TIMING_PRESENT]);
+	fprintf(file, "effect %.3fms\n", timing.avg[TIMING_EFFECT]);
+	fprintf(file, "overlay %.3fms\n", timing.avg[TIMING_OVERLAY]);
+	fprintf(file, "swap %.3fms (cpu, includes vsync)\n", timing.swap);
+	fclose(file);
+}
+
+static void timingEndFrame(float swap_ms) {
+	if (!timing.enabled) return;
+	timingAccumulate(&timing.swap, swap_ms);
+	timing.samples += 1;
+	if (++timing.dump_counter >= GPU_TIMING_DUMP_FRAMES) {
+		timing.dump_counter = 0;
+		timingDump();
+	}
+}
 
-        if (prepare_thread == NULL) {
-            printf("Error creating background thread: %s\n", SDL_GetError());
-            return; 
-        }
-    }
+void PLAT_GL_getTimings(GPUTimings* out) {
+	memset(out, 0, sizeof(GPUTimings));
+	out->valid = timing.enabled && timing.samples > GPU_TIMING_FRAMES;
+	out->timer_query = timing.timer_query;
+	out->passes = nrofshaders;
+	out->upload = timing.avg[TIMING_UPLOAD];
+	for (int i = 0; i < MAXSHADERS; i++) out->pass[i] = timing.avg[TIMING_PASS + i];
+	out->present = timing.avg[TIMING_PRESENT];
+	out->effect = timing.avg[TIMING_EFFECT];
+	out->overlay = timing.avg[TIMING_OVERLAY];
+	out->swap = timing.swap;
+}
+
+// set when the core duped its frame, the source texture and every pass
+// that doesn't animate on FrameCount already hold this frame's output
+static int repeat_frame = 0;
+void PLAT_GL_repeatFrame(void) {
+	repeat_frame = 1;
+}
+
+///////////////////////////////
+
+// hardware rendering
+// gl cores draw into hw.fbo on our context. each frame PLAT_GL_Swap blits
+// the used part of it into the source texture, flipping it top down like a
+// software frame, so the shader chain runs unchanged and nothing goes
+// through the cpu. the core is free to trash any gl state in between.
+
+static struct {
+	GLuint fbo;
+	GLuint color;
+	GLuint depth;
+	GLuint copy_fbo;
+	int w;
+	int h;
+	int bottom_left;
+} hw;
+
+// set when the frame handed to the next swap was rendered into hw.fbo
+static int hw_frame = 0;
+
+int PLAT_GL_supportsHWRender(int gles, int major, int minor) {
+	if (!gles) return 0;
+	GLint ctx_major = 0, ctx_minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &ctx_major);
+	glGetIntegerv(GL_MINOR_VERSION, &ctx_minor);
+	return major * 10 + minor <= ctx_major * 10 + ctx_minor;
+}
+
+// (re)allocates storage, the fbo name stays the same so cores can cache it
+int PLAT_GL_initHWRender(int width, int height, int depth, int stencil, int bottom_left) {
+	SDL_GL_MakeCurrent(vid.window, vid.gl_context);
+
+	if (!hw.fbo) {
+		glGenFramebuffers(1, &hw.fbo);
+		glGenRenderbuffers(1, &hw.color);
+	}
+	glBindRenderbuffer(GL_RENDERBUFFER, hw.color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindFramebuffer(GL_FRAMEBUFFER, hw.fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, hw.color);
+
+	if (depth || stencil) {
+		if (!hw.depth) glGenRenderbuffers(1, &hw.depth);
+		glBindRenderbuffer(GL_RENDERBUFFER, hw.depth);
+		glRenderbufferStorage(GL_RENDERBUFFER, stencil ? GL_DEPTH24_STENCIL8 : GL_DEPTH_COMPONENT24, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, hw.depth);
+	}
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		LOG_error("hw render fbo incomplete: 0x%x\n", status);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		PLAT_GL_quitHWRender();
+		return 0;
+	}
+
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	gl_state_lost = 1;
+
+	hw.w = width;
+	hw.h = height;
+	hw.bottom_left = bottom_left;
+	LOG_info("hw render target %ix%i depth:%i stencil:%i\n", width, height, depth, stencil);
+	return 1;
+}
+
+void PLAT_GL_quitHWRender(void) {
+	if (hw.copy_fbo) glDeleteFramebuffers(1, &hw.copy_fbo);
+	if (hw.fbo) glDeleteFramebuffers(1, &hw.fbo);
+	if (hw.color) glDeleteRenderbuffers(1, &hw.color);
+	if (hw.depth) glDeleteRenderbuffers(1, &hw.depth);
+	memset(&hw, 0, sizeof(hw));
+	hw_frame = 0;
+}
+
+uintptr_t PLAT_GL_getHWFramebuffer(void) {
+	return hw.fbo;
+}
+
+void* PLAT_GL_getProcAddress(const char* sym) {
+	return SDL_GL_GetProcAddress(sym);
+}
+
+void PLAT_GL_presentHWFrame(void) {
+	hw_frame = 1;
+}
+
+// puts back whatever the core may have changed that the swap relies on
+static void restoreHWState(void) {
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindSampler(0, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_STENCIL_TEST);
+	glDisable(GL_SCISSOR_TEST);
+	glDisable(GL_CULL_FACE);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glBlendEquation(GL_FUNC_ADD);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	gl_state_lost = 1;
+}
+
+// copies the w x h the core rendered into texture, which must already have that size
+static void blitHWFrame(GLuint texture, int w, int h) {
+	if (w > hw.w) w = hw.w;
+	if (h > hw.h) h = hw.h;
+	if (!hw.copy_fbo) glGenFramebuffers(1, &hw.copy_fbo);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, hw.fbo);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, hw.copy_fbo);
+	glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	if (hw.bottom_left) glBlitFramebuffer(0, 0, w, h, 0, h, w, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	else glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	gl_state_lost = 1;
+}
+
+void PLAT_GL_Swap() {
+	int repeat = repeat_frame;
+	repeat_frame = 0;
+	int from_hw = hw_frame && hw.fbo;
+	hw_frame = 0;
+
+	if (hw.fbo) restoreHWState();
 
     static int lastframecount = 0;
     if (reloadShaderTextures) lastframecount = frame_count;
@@ -2036,54 +2760,55 @@ void PLAT_GL_Swap() {
     }
 
 	SDL_GL_MakeCurrent(vid.window, vid.gl_context);
+	timingBeginFrame();
 
     static GLuint effect_tex = 0;
     static int effect_w = 0, effect_h = 0;
     static GLuint overlay_tex = 0;
     static int overlay_w = 0, overlay_h = 0;
-    static int overlayload = 0;
+    SDL_Surface* image;
 
-
-	 if (frame_prep.effect_ready) {
-		if(frame_prep.loaded_effect) {
+	if (takeAsset(LAYER_EFFECT, &image)) {
+		if(image) {
 			if(!effect_tex) glGenTextures(1, &effect_tex);
 			glBindTexture(GL_TEXTURE_2D, effect_tex);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, frame_prep.loaded_effect->w, frame_prep.loaded_effect->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, frame_prep.loaded_effect->pixels);
-			effect_w = frame_prep.loaded_effect->w;
-			effect_h = frame_prep.loaded_effect->h;
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image->w, image->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, image->pixels);
+			gl_state_lost = 1; // bound behind runShaderPass's back
+			effect_w = image->w;
+			effect_h = image->h;
+			SDL_FreeSurface(image);
 		} else {
 			if (effect_tex) {
 				glDeleteTextures(1, &effect_tex);
 			}
 			effect_tex = 0;
 		}
-        frame_prep.effect_ready = 0; 
-    }
+	}
 
-    if (frame_prep.overlay_ready) {
-		if(frame_prep.loaded_overlay) {
+	if (takeAsset(LAYER_OVERLAY, &image)) {
+		if(image) {
 			if(!overlay_tex) glGenTextures(1, &overlay_tex);
 			glBindTexture(GL_TEXTURE_2D, overlay_tex);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, frame_prep.loaded_overlay->w, frame_prep.loaded_overlay->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, frame_prep.loaded_overlay->pixels);
-			overlay_w = frame_prep.loaded_overlay->w;
-			overlay_h = frame_prep.loaded_overlay->h;
-		
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image->w, image->h, 0, GL_RGBA, GL_UNSIGNED_BYTE, image->pixels);
+			gl_state_lost = 1; // bound behind runShaderPass's back
+			overlay_w = image->w;
+			overlay_h = image->h;
+			SDL_FreeSurface(image);
 		} else {
 			if (overlay_tex) {
 				glDeleteTextures(1, &overlay_tex);
 			}
 			overlay_tex = 0;
 		}
-        frame_prep.overlay_ready = 0; 
-    }
+	}
 	
     static GLuint src_texture = 0;
     static int src_w_last = 0, src_h_last = 0;
@@ -2103,20 +2828,48 @@ void PLAT_GL_Swap() {
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     }
 
-    glBindTexture(GL_TEXTURE_2D, src_texture);
-    if (vid.blit->src_w != src_w_last || vid.blit->src_h != src_h_last || reloadShaderTextures) {
+    repeat = repeat && !reloadShaderTextures && vid.blit->src_w == src_w_last && vid.blit->src_h == src_h_last;
+
+    // first pass that has to run again, everything after it consumes its output
+    int first_dirty = nrofshaders;
+    if (repeat) {
+        for (int i = 0; i < nrofshaders; i++) {
+            if (shaders[i]->u_FrameCount >= 0 || shaders[i]->updated) {
+                first_dirty = i;
+                break;
+            }
+        }
+    }
+    else first_dirty = 0;
+
+    // a repeat binds nothing here, runShaderPass's cached binding has to stay true
+    if (!repeat) glBindTexture(GL_TEXTURE_2D, src_texture);
+    timingBegin(TIMING_UPLOAD);
+    if (repeat) {
+        // nothing to upload
+    } else if (from_hw) {
+        if (vid.blit->src_w != src_w_last || vid.blit->src_h != src_h_last || reloadShaderTextures) {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, vid.blit->src_w, vid.blit->src_h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            src_w_last = vid.blit->src_w;
+            src_h_last = vid.blit->src_h;
+        }
+        blitHWFrame(src_texture, vid.blit->src_w, vid.blit->src_h);
+    } else if (vid.blit->src_w != src_w_last || vid.blit->src_h != src_h_last || reloadShaderTextures) {
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, vid.blit->src_w, vid.blit->src_h, 0, GL_RGBA, GL_UNSIGNED_BYTE, vid.blit->src);
         src_w_last = vid.blit->src_w;
         src_h_last = vid.blit->src_h;
     } else {
         glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, vid.blit->src_w, vid.blit->src_h, GL_RGBA, GL_UNSIGNED_BYTE, vid.blit->src);
     }
+    timingEnd(TIMING_UPLOAD);
 
     if (nrofshaders < 1) {
+        timingBegin(TIMING_PRESENT);
         runShaderPass(src_texture, g_shader_default, NULL, dst_rect.x, dst_rect.y,
             dst_rect.w, dst_rect.h,
             &(Shader){.srcw = vid.blit->src_w, .srch = vid.blit->src_h, .texw = vid.blit->src_w, .texh = vid.blit->src_h},
             0, GL_NONE);
+        timingEnd(TIMING_PRESENT);
     }
 
     last_w = vid.blit->src_w;
@@ -2162,6 +2915,13 @@ void PLAT_GL_Swap() {
         }
         shaderinfocount++;
 
+        if (i < first_dirty) {
+            last_w = dst_w;
+            last_h = dst_h;
+            continue;
+        }
+
+        timingBegin(TIMING_PASS + i);
         if (shaders[i]->shader_p) {
             runShaderPass(
                 (i == 0) ? src_texture : shaders[i - 1]->texture,
@@ -2183,12 +2943,14 @@ void PLAT_GL_Swap() {
                 (i == nrofshaders - 1) ? finalScaleFilter : shaders[i + 1]->filter
             );
         }
+        timingEnd(TIMING_PASS + i);
 
         last_w = dst_w;
         last_h = dst_h;
     }
 
     if (nrofshaders > 0) {
+        timingBegin(TIMING_PRESENT);
         runShaderPass(
             shaders[nrofshaders - 1]->texture,
             g_shader_default,
@@ -2197,9 +2959,11 @@ void PLAT_GL_Swap() {
             &(Shader){.srcw = last_w, .srch = last_h, .texw = last_w, .texh = last_h},
             0, GL_NONE
         );
+        timingEnd(TIMING_PRESENT);
     }
 
     if (effect_tex) {
+        timingBegin(TIMING_EFFECT);
         runShaderPass(
             effect_tex,
             g_shader_overlay,
@@ -2208,9 +2972,11 @@ void PLAT_GL_Swap() {
             &(Shader){.srcw = effect_w, .srch = effect_h, .texw = effect_w, .texh = effect_h},
             1, GL_NONE
         );
+        timingEnd(TIMING_EFFECT);
     }
 
     if (overlay_tex) {
+        timingBegin(TIMING_OVERLAY);
         runShaderPass(
             overlay_tex,
             g_shader_overlay,
@@ -2219,9 +2985,12 @@ void PLAT_GL_Swap() {
             &(Shader){.srcw = vid.blit->src_w, .srch = vid.blit->src_h, .texw = overlay_w, .texh = overlay_h},
             1, GL_NONE
         );
+        timingEnd(TIMING_OVERLAY);
     }
 
+    Uint64 swap_start = SDL_GetPerformanceCounter();
     SDL_GL_SwapWindow(vid.window);
+    timingEndFrame(timingElapsed(swap_start));
     frame_count++;
     reloadShaderTextures = 0;
 }
@@ -2254,13 +3023,54 @@ void PLAT_pixelFlipper(uint8_t* pixels, int width, int height) {
     }
 }
 
+// screen captures are blitted upside down into their own renderbuffer first so
+// the rows come back top-down and nothing has to be flipped on the cpu
+static struct {
+	GLuint fbo;
+	GLuint rbo;
+	GLuint pbo;
+	GLsync fence;
+	int w;
+	int h;
+	int pending;
+	int pending_w; // size of the readback in the pbo, the renderbuffer may have moved on
+	int pending_h;
+} capture = {0};
+
+// leaves the flipped copy of the current frame bound as GL_READ_FRAMEBUFFER
+static int captureFlipped(int width, int height) {
+	if (!capture.fbo) {
+		glGenFramebuffers(1, &capture.fbo);
+		glGenRenderbuffers(1, &capture.rbo);
+	}
+	if (capture.w != width || capture.h != height) {
+		glBindRenderbuffer(GL_RENDERBUFFER, capture.rbo);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, capture.fbo);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, capture.rbo);
+		GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (status != GL_FRAMEBUFFER_COMPLETE) {
+			LOG_error("capture framebuffer incomplete: 0x%x\n", status);
+			capture.w = capture.h = 0;
+			return 0;
+		}
+		capture.w = width;
+		capture.h = height;
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, capture.fbo);
+	glBlitFramebuffer(0, 0, width, height, 0, height, width, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, capture.fbo);
+	return 1;
+}
+
 unsigned char* PLAT_GL_screenCapture(int* outWidth, int* outHeight) {
-    glViewport(0, 0, device_width, device_height);
-    GLint viewport[4];
-    glGetIntegerv(GL_VIEWPORT, viewport);
-	
-    int width = viewport[2];
-    int height = viewport[3];
+    int width = device_width;
+    int height = device_height;
 
     if (outWidth) *outWidth = width;
     if (outHeight) *outHeight = height;
@@ -2268,13 +3078,80 @@ unsigned char* PLAT_GL_screenCapture(int* outWidth, int* outHeight) {
     unsigned char* pixels = malloc(width * height * 4); // RGBA
     if (!pixels) return NULL;
 
-    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-
-	PLAT_pixelFlipper(pixels, width, height);
+	if (captureFlipped(width, height)) {
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+	else {
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		PLAT_pixelFlipper(pixels, width, height);
+	}
 
     return pixels; // caller must free
 }
 
+int PLAT_GL_screenCaptureAsync(void) {
+	if (capture.pending) {
+		// only one readback in flight, land the previous one first
+		unsigned char* pixels = PLAT_GL_screenCapturePoll(NULL, NULL, 1);
+		if (pixels) free(pixels);
+	}
+
+	int width = device_width;
+	int height = device_height;
+	if (!captureFlipped(width, height)) return 0;
+
+	if (!capture.pbo) glGenBuffers(1, &capture.pbo);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pbo);
+	glBufferData(GL_PIXEL_PACK_BUFFER, width * height * 4, NULL, GL_STREAM_READ);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	capture.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush(); // make sure the fence actually gets submitted
+	capture.pending = 1;
+	capture.pending_w = width;
+	capture.pending_h = height;
+	return 1;
+}
+
+unsigned char* PLAT_GL_screenCapturePoll(int* outWidth, int* outHeight, int wait) {
+	if (!capture.pending) return NULL;
+
+	GLenum result = glClientWaitSync(capture.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000000 : 0); // 1s
+	if (result == GL_TIMEOUT_EXPIRED && !wait) return NULL;
+	glDeleteSync(capture.fence);
+	capture.fence = 0;
+	capture.pending = 0;
+	if (result == GL_WAIT_FAILED || result == GL_TIMEOUT_EXPIRED) {
+		LOG_error("screen capture readback failed\n");
+		return NULL;
+	}
+
+	int width = capture.pending_w;
+	int height = capture.pending_h;
+	size_t size = width * height * 4;
+	unsigned char* pixels = malloc(size);
+	if (pixels) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.pbo);
+		void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+		if (mapped) {
+			memcpy(pixels, mapped, size);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		else {
+			free(pixels);
+			pixels = NULL;
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+
+	if (outWidth) *outWidth = width;
+	if (outHeight) *outHeight = height;
+	return pixels; // caller must free
+}
+
 ///////////////////////////////
 
 // TODO: 
@@ -2397,158 +3274,134 @@ int PLAT_supportsDeepSleep(void) { return 1; }
 
 ///////////////////////////////
 
-double get_time_sec() {
-    struct timespec ts;
-    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
-    return ts.tv_sec + ts.tv_nsec / 1e9; // Convert to seconds
-}
-double get_process_cpu_time_sec() {
-	// this gives cpu time in nanoseconds needed to accurately calculate cpu usage in very short time frames. 
-	// unfortunately about 20ms between meassures seems the lowest i can go to get accurate results
-	// maybe in the future i will find and even more granual way to get cpu time, but might just be a limit of C or Linux alltogether
-    struct timespec ts;
-    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
-    return ts.tv_sec + ts.tv_nsec / 1e9; // Convert to seconds
-}
+// cpu governor
+// minarch reports how long each frame took to emulate and present, less the
+// vsync wait, against the time the frame had. a frame that gets close to its
+// budget steps the clock straight up to where that frame would have fit,
+// stepping down waits for a second of frames that would all still fit at the
+// lower clock. the gap between the two is the hysteresis that keeps it from
+// bouncing. known heavy moments (leaving the menu, loading a state, fast
+// forward) boost ahead of time instead of dropping a frame to find out. the
+// sysfs file stays open and is only written when the speed actually changes.
 
-static pthread_mutex_t currentcpuinfo;
-// a roling average for the display values of about 2 frames, otherwise they are unreadable jumping too fast up and down and stuff to read
-#define ROLLING_WINDOW 120  
+#define GOVERNOR_PATH "/sys/devices/system/cpu/cpu0/cpufreq/scaling_setspeed"
+#define GOVERNOR_TARGET 75 // % of the frame budget to settle at
+#define GOVERNOR_HIGH 90 // a frame above this steps up right away
+#define GOVERNOR_DOWN_FRAMES 60 // frames that must fit the lower clock before stepping down
+
+static const int cpu_frequencies[] = {408,450,500,550,  600,650,700,750, 800,850,900,950, 1000,1050,1100,1150, 1200,1250,1300,1350, 1400,1450,1500,1550, 1600,1650,1700,1750, 1800,1850,1900,1950, 2000};
+#define CPU_FREQ_COUNT (int)(sizeof(cpu_frequencies) / sizeof(cpu_frequencies[0]))
+
+static struct {
+	int fd;
+	int freq; // kHz, last written
+	int index; // into cpu_frequencies
+	int peak; // highest load since the clock last changed
+	int calm; // frames in a row that fit the next clock down
+	int boost; // frames left at the top clock
+	float load; // smoothed for the debug hud
+} governor = { .fd = -1, .index = CPU_FREQ_COUNT - 1 };
 
 volatile int useAutoCpu = 1;
-void *PLAT_cpu_monitor(void *arg) {
-    struct timespec start_time, curr_time;
-    clock_gettime(CLOCK_MONOTONIC_RAW, &start_time);
-
-    long clock_ticks_per_sec = sysconf(_SC_CLK_TCK);
-
-    double prev_real_time = get_time_sec();
-    double prev_cpu_time = get_process_cpu_time_sec();
-
-	const int cpu_frequencies[] = {408,450,500,550,  600,650,700,750, 800,850,900,950, 1000,1050,1100,1150, 1200,1250,1300,1350, 1400,1450,1500,1550, 1600,1650,1700,1750, 1800,1850,1900,1950, 2000};
-    const int num_freqs = sizeof(cpu_frequencies) / sizeof(cpu_frequencies[0]);
-    int current_index = 5; 
-
-    double cpu_usage_history[ROLLING_WINDOW] = {0};
-    double cpu_speed_history[ROLLING_WINDOW] = {0};
-    int history_index = 0;
-    int history_count = 0; 
-
-    while (true) {
-        if (useAutoCpu) {
-            double curr_real_time = get_time_sec();
-            double curr_cpu_time = get_process_cpu_time_sec();
-
-            double elapsed_real_time = curr_real_time - prev_real_time;
-            double elapsed_cpu_time = curr_cpu_time - prev_cpu_time;
-            double cpu_usage = 0;
-
-            if (elapsed_real_time > 0) {
-                cpu_usage = (elapsed_cpu_time / elapsed_real_time) * 100.0;
-            }
-
-            pthread_mutex_lock(&currentcpuinfo);
-
-			// the goal here is is to keep cpu usage between 75% and 85% at the lowest possible speed so device stays cool and battery usage is at a minimum
-			// if usage falls out of this range it will either scale a step down or up 
-			// but if usage hits above 95% we need that max boost and we instant scale up to 2000mhz as long as needed
-			// all this happens very fast like 60 times per second, so i'm applying roling averages to display values, so debug screen is readable and gives a good estimate on whats happening cpu wise
-			// the roling averages are purely for displaying, the actual scaling is happening realtime each run. 
-            if (cpu_usage > 95) {
-                current_index = num_freqs - 1; // Instant power needed, cpu is above 95% Jump directly to max boost 2000MHz
-            }
-            else if (cpu_usage > 85 && current_index < num_freqs - 1) { // otherwise try to keep between 75 and 85 at lowest clock speed
-                current_index++; 
-            } 
-            else if (cpu_usage < 75 && current_index > 0) {
-                current_index--; 
-            }
-
-            PLAT_setCustomCPUSpeed(cpu_frequencies[current_index] * 1000);
-
-            cpu_usage_history[history_index] = cpu_usage;
-            cpu_speed_history[history_index] = cpu_frequencies[current_index];
 
-            history_index = (history_index + 1) % ROLLING_WINDOW;
-            if (history_count < ROLLING_WINDOW) {
-                history_count++; 
-            }
-
-            double sum_cpu_usage = 0, sum_cpu_speed = 0;
-            for (int i = 0; i < history_count; i++) {
-                sum_cpu_usage += cpu_usage_history[i];
-                sum_cpu_speed += cpu_speed_history[i];
-            }
-
-            currentcpuse = sum_cpu_usage / history_count;
-            currentcpuspeed = sum_cpu_speed / history_count;
-
-            pthread_mutex_unlock(&currentcpuinfo);
-
-            prev_real_time = curr_real_time;
-            prev_cpu_time = curr_cpu_time;
-			// 20ms really seems lowest i can go, anything lower it becomes innacurate, maybe one day I will find another even more granual way to calculate usage accurately and lower this shit to 1ms haha, altough anything lower than 10ms causes cpu usage in itself so yeah
-			// Anyways screw it 20ms is pretty much on a frame by frame basis anyways, so will anything lower really make a difference specially if that introduces cpu usage by itself? 
-			// Who knows, maybe some CPU engineer will find my comment here one day and can explain, maybe this is looking for the limits of C and needs Assambler or whatever to call CPU instructions directly to go further, but all I know is PUSH and MOV, how did the orignal Roller Coaster Tycoon developer wrote a whole game like this anyways? Its insane..
-            usleep(20000);
-        } else {
-            // Just measure CPU usage without changing frequency
-            double curr_real_time = get_time_sec();
-            double curr_cpu_time = get_process_cpu_time_sec();
-
-            double elapsed_real_time = curr_real_time - prev_real_time;
-            double elapsed_cpu_time = curr_cpu_time - prev_cpu_time;
+static void setGovernorFreq(int freq) {
+	if (freq==governor.freq) return;
 
-            if (elapsed_real_time > 0) {
-                double cpu_usage = (elapsed_cpu_time / elapsed_real_time) * 100.0;
-
-                pthread_mutex_lock(&currentcpuinfo);
-
-                cpu_usage_history[history_index] = cpu_usage;
-
-                history_index = (history_index + 1) % ROLLING_WINDOW;
-                if (history_count < ROLLING_WINDOW) {
-                    history_count++;
-                }
+	if (governor.fd<0) {
+		governor.fd = open(GOVERNOR_PATH, O_WRONLY | O_CLOEXEC);
+		if (governor.fd<0) {
+			LOG_error("governor: can't open %s: %s\n", GOVERNOR_PATH, strerror(errno));
+			return;
+		}
+	}
 
-                double sum_cpu_usage = 0;
-                for (int i = 0; i < history_count; i++) {
-                    sum_cpu_usage += cpu_usage_history[i];
-                }
+	char value[16];
+	int len = snprintf(value, sizeof(value), "%d\n", freq);
+	if (pwrite(governor.fd, value, len, 0)!=len) {
+		LOG_error("governor: writing %d failed: %s\n", freq, strerror(errno));
+		close(governor.fd); // reopened on the next change
+		governor.fd = -1;
+		return;
+	}
+	governor.freq = freq;
+	currentcpuspeed = freq / 1000;
+}
 
-                currentcpuse = sum_cpu_usage / history_count;
+static void setGovernorIndex(int index, const char* reason, int load) {
+	if (index<0) index = 0;
+	if (index>=CPU_FREQ_COUNT) index = CPU_FREQ_COUNT - 1;
+	if (index!=governor.index) {
+		LOG_info("governor: %i -> %iMHz (%s, load %i%%)\n", cpu_frequencies[governor.index], cpu_frequencies[index], reason, load);
+	}
+	governor.index = index;
+	governor.peak = 0;
+	governor.calm = 0;
+	setGovernorFreq(cpu_frequencies[index] * 1000);
+}
+
+void PLAT_cpuFrame(int busy, int budget) {
+	if (budget<=0) return;
+	int load = (int64_t)busy * 100 / budget;
+	governor.load = governor.load ? governor.load * 0.95f + load * 0.05f : load;
+	currentcpuse = governor.load;
+	if (!useAutoCpu) return;
+
+	if (governor.boost>0) {
+		governor.boost -= 1;
+		setGovernorIndex(CPU_FREQ_COUNT - 1, "boost", load);
+		return;
+	}
 
-                pthread_mutex_unlock(&currentcpuinfo);
-            }
+	int current = cpu_frequencies[governor.index];
+	if (load>=GOVERNOR_HIGH) {
+		// straight to the clock this frame would have needed to land on target
+		int needed = current * load / GOVERNOR_TARGET;
+		int index = governor.index + 1;
+		while (index<CPU_FREQ_COUNT - 1 && cpu_frequencies[index]<needed) index++;
+		setGovernorIndex(index, load>100 ? "missed" : "up", load);
+		return;
+	}
 
-            prev_real_time = curr_real_time;
-            prev_cpu_time = curr_cpu_time;
-            usleep(100000); 
-        }
-    }
+	if (load>governor.peak) governor.peak = load;
+	if (governor.index>0 && governor.peak * current < GOVERNOR_TARGET * cpu_frequencies[governor.index - 1]) {
+		if (++governor.calm>=GOVERNOR_DOWN_FRAMES) {
+			// lowest clock the whole window would have fit
+			int index = governor.index - 1;
+			while (index>0 && governor.peak * current < GOVERNOR_TARGET * cpu_frequencies[index - 1]) index--;
+			setGovernorIndex(index, "down", governor.peak);
+		}
+	}
+	else {
+		governor.calm = 0;
+		governor.peak = load;
+	}
 }
 
+void PLAT_cpuBoost(int frames) {
+	if (!useAutoCpu) return;
+	if (frames>governor.boost) governor.boost = frames;
+	setGovernorIndex(CPU_FREQ_COUNT - 1, "boost", governor.load); // now, the heavy part may come before the next frame
+}
 
-#define GOVERNOR_PATH "/sys/devices/system/cpu/cpu0/cpufreq/scaling_setspeed"
 void PLAT_setCustomCPUSpeed(int speed) {
-    FILE *fp = fopen(GOVERNOR_PATH, "w");
-    if (fp == NULL) {
-        perror("Failed to open scaling_setspeed");
-        return;
-    }
-
-    fprintf(fp, "%d\n", speed);
-    fclose(fp);
+	setGovernorFreq(speed);
 }
 void PLAT_setCPUSpeed(int speed) {
 	int freq = 0;
 	switch (speed) {
-		case CPU_SPEED_MENU: 		freq =  600000; currentcpuspeed = 600; break;
-		case CPU_SPEED_POWERSAVE:	freq = 1200000; currentcpuspeed = 1200; break;
-		case CPU_SPEED_NORMAL: 		freq = 1608000; currentcpuspeed = 1600; break;
-		case CPU_SPEED_PERFORMANCE: freq = 2000000; currentcpuspeed = 2000; break;
+		case CPU_SPEED_MENU: 		freq =  600000; break;
+		case CPU_SPEED_POWERSAVE:	freq = 1200000; break;
+		case CPU_SPEED_NORMAL: 		freq = 1608000; break;
+		case CPU_SPEED_PERFORMANCE: freq = 2000000; break;
 	}
-	putInt(GOVERNOR_PATH, freq);
+	setGovernorFreq(freq);
+
+	// the governor carries on from here when auto is (re)enabled
+	int index = 0;
+	while (index<CPU_FREQ_COUNT - 1 && cpu_frequencies[index + 1] * 1000<=freq) index++;
+	governor.index = index;
+	governor.peak = 0;
+	governor.calm = 0;
 }
 
 #define MAX_STRENGTH 0xFFFF
@@ -3068,13 +3921,14 @@ void PLAT_initTimezones() {
             continue;
         }
         
-        char *token = strtok(line, "\t"); // Skip country code
+        char *saveptr = NULL;
+        char *token = strtok_r(line, "\t", &saveptr); // Skip country code
         if (!token) continue;
         
-        token = strtok(NULL, "\t"); // Skip latitude/longitude
+        token = strtok_r(NULL, "\t", &saveptr); // Skip latitude/longitude
         if (!token) continue;
         
-        token = strtok(NULL, "\t\n"); // Extract timezone
+        token = strtok_r(NULL, "\t\n", &saveptr); // Extract timezone
         if (!token) continue;
         
         // Check for duplicates before adding
@@ -3218,6 +4072,9 @@ bool PLAT_wifiEnabled() {
 
 #include "wmg_debug.h"
 #include "wifid_cmd.h"
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 void PLAT_wifiEnable(bool on) {
 	if (on)
@@ -3255,21 +4112,8 @@ void PLAT_wifiEnable(bool on) {
 	}
 }
 
-int PLAT_wifiScan(struct WIFI_network *networks, int max)
+static int wifi_parseScanResults(const char *results, struct WIFI_network *networks, int max)
 {
-    if(!CFG_getWifi()) {
-        LOG_error("PLAT_wifiScan: wifi is currently disabled.\n");
-        return -1;
-    }
-
-    char results[SCAN_MAX];
-    int ret = aw_wifid_get_scan_results(results, SCAN_MAX);
-    if (ret < 0) {
-        //LOG_error("PLAT_wifiScan: failed to get wifi scan results (%i).\n", ret);
-        return -1;
-    }
-    results[SCAN_MAX - 1] = '\0'; // ensure null termination
-
 	// Results will be in this form:
 	//[INFO] bssid / frequency / signal level / flags / ssid
 	//04:b4:fe:32:f9:73	2462	-63	[WPA2-PSK-CCMP][WPS][ESS]	frynet
@@ -3351,6 +4195,163 @@ int PLAT_wifiScan(struct WIFI_network *networks, int max)
     return count;
 }
 
+int PLAT_wifiScan(struct WIFI_network *networks, int max)
+{
+    if(!CFG_getWifi()) {
+        LOG_error("PLAT_wifiScan: wifi is currently disabled.\n");
+        return -1;
+    }
+
+    char results[SCAN_MAX];
+    int ret = aw_wifid_get_scan_results(results, SCAN_MAX);
+    if (ret < 0) {
+        //LOG_error("PLAT_wifiScan: failed to get wifi scan results (%i).\n", ret);
+        return -1;
+    }
+    results[SCAN_MAX - 1] = '\0'; // ensure null termination
+
+    return wifi_parseScanResults(results, networks, max);
+}
+
+// supplicant events
+// the settings menu used to rescan every couple of seconds to notice changes.
+// it listens on wpa_supplicant's control socket instead and reads back the
+// results of scans the supplicant already ran (the same protocol wpa_cli speaks).
+
+#define WPA_CTRL_PATH "/var/sockets/wlan0"
+#define WPA_REPLY_TIMEOUT_MS 2000
+
+static int wpa_open(char *local_path, size_t len)
+{
+	static int counter = 0;
+	int sock = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if (sock < 0)
+		return -1;
+
+	struct sockaddr_un local = { .sun_family = AF_UNIX };
+	snprintf(local.sun_path, sizeof(local.sun_path), "/tmp/wpa_ctrl_%i-%i", getpid(), counter++);
+	snprintf(local_path, len, "%s", local.sun_path);
+	unlink(local.sun_path);
+
+	struct sockaddr_un dest = { .sun_family = AF_UNIX };
+	snprintf(dest.sun_path, sizeof(dest.sun_path), "%s", WPA_CTRL_PATH);
+	if (bind(sock, (struct sockaddr *)&local, sizeof(local)) < 0 || connect(sock, (struct sockaddr *)&dest, sizeof(dest)) < 0) {
+		close(sock);
+		unlink(local_path);
+		return -1;
+	}
+	return sock;
+}
+
+static void wpa_close(int sock, const char *local_path)
+{
+	close(sock);
+	unlink(local_path);
+}
+
+static int wpa_request(int sock, const char *cmd, char *reply, size_t len)
+{
+	if (send(sock, cmd, strlen(cmd), 0) < 0)
+		return -1;
+	while (1) {
+		struct pollfd pfd = { .fd = sock, .events = POLLIN };
+		if (poll(&pfd, 1, WPA_REPLY_TIMEOUT_MS) <= 0)
+			return -1;
+		ssize_t n = recv(sock, reply, len - 1, 0);
+		if (n < 0)
+			return -1;
+		reply[n] = '\0';
+		if (reply[0] != '<') // not an unsolicited event
+			return n;
+	}
+}
+
+int PLAT_wifiScanResults(struct WIFI_network *networks, int max)
+{
+	if(!CFG_getWifi())
+		return -1;
+
+	char path[MAX_PATH];
+	int sock = wpa_open(path, sizeof(path));
+	if (sock < 0)
+		return -1;
+
+	char *results = malloc(SCAN_MAX);
+	int ret = results ? wpa_request(sock, "SCAN_RESULTS", results, SCAN_MAX) : -1;
+	wpa_close(sock, path);
+	if (ret >= 0)
+		ret = wifi_parseScanResults(results, networks, max);
+	free(results);
+	return ret;
+}
+
+static struct {
+	pthread_mutex_t lock;
+	int sock;
+	int task;
+	char path[MAX_PATH];
+	void (*callback)(int event);
+} wpa_monitor = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.sock = -1,
+	.task = -1,
+};
+
+static void wpa_monitorEvent(void *arg)
+{
+	char event[512];
+	ssize_t n;
+	while ((n = recv(wpa_monitor.sock, event, sizeof(event) - 1, MSG_DONTWAIT)) > 0) {
+		event[n] = '\0';
+		// "<3>CTRL-EVENT-CONNECTED - Connection to ..."
+		char *name = event[0] == '<' && strchr(event, '>') ? strchr(event, '>') + 1 : event;
+		int type = -1;
+		if (prefixMatch("CTRL-EVENT-SCAN-RESULTS", name))
+			type = WIFI_EVENT_SCAN_RESULTS;
+		else if (prefixMatch("CTRL-EVENT-CONNECTED", name))
+			type = WIFI_EVENT_CONNECTED;
+		else if (prefixMatch("CTRL-EVENT-DISCONNECTED", name))
+			type = WIFI_EVENT_DISCONNECTED;
+		if (type >= 0 && wpa_monitor.callback)
+			wpa_monitor.callback(type);
+	}
+}
+
+bool PLAT_wifiWatchRegister(void (*cb)(int event))
+{
+	pthread_mutex_lock(&wpa_monitor.lock);
+	wpa_monitor.callback = cb;
+	if (wpa_monitor.sock < 0) {
+		char reply[16];
+		int sock = wpa_open(wpa_monitor.path, sizeof(wpa_monitor.path));
+		if (sock >= 0 && wpa_request(sock, "ATTACH", reply, sizeof(reply)) >= 0 && prefixMatch("OK", reply)) {
+			wpa_monitor.sock = sock;
+			wpa_monitor.task = SVC_watch(sock, wpa_monitorEvent, NULL);
+			wifilog("listening for supplicant events\n");
+		}
+		else if (sock >= 0) {
+			wpa_close(sock, wpa_monitor.path);
+		}
+	}
+	bool watching = wpa_monitor.sock >= 0;
+	pthread_mutex_unlock(&wpa_monitor.lock);
+	return watching;
+}
+
+void PLAT_wifiWatchUnregister(void)
+{
+	pthread_mutex_lock(&wpa_monitor.lock);
+	if (wpa_monitor.sock >= 0) {
+		SVC_remove(wpa_monitor.task);
+		send(wpa_monitor.sock, "DETACH", 6, 0);
+		wpa_close(wpa_monitor.sock, wpa_monitor.path);
+		wpa_monitor.sock = -1;
+		wpa_monitor.task = -1;
+	}
+	wpa_monitor.callback = NULL;
+	pthread_mutex_unlock(&wpa_monitor.lock);
+}
+
 bool PLAT_wifiConnected()
 {
 	if(!CFG_getWifi()) {
@@ -3575,6 +4576,13 @@ dev_list_t *discovered_controllers = NULL;
 dev_list_t *discovered_audiodev = NULL;
 
 static bool auto_connect = true;
+static void (*bt_event_callback)(int event) = NULL;
+
+static void bt_notify(int event)
+{
+	if (bt_event_callback)
+		bt_event_callback(event);
+}
 
 #define btlog(fmt, ...) \
     LOG_note(PLAT_bluetoothDiagnosticsEnabled() ? LOG_INFO : LOG_DEBUG, fmt, ##__VA_ARGS__)
@@ -3653,6 +4661,7 @@ static void bt_test_gap_connected_changed_cb(btmg_bt_device_t *device)
 		sprintf(act, "bluetoothctl trust %s", device->remote_address);
 		system(act);
 	}
+	bt_notify(BT_EVENT_CONNECTION);
 }
 
 static void bt_test_dev_add_cb(btmg_bt_device_t *device)
@@ -3672,6 +4681,7 @@ static void bt_test_dev_add_cb(btmg_bt_device_t *device)
 				btmg_dev_list_add_device(discovered_controllers, device->remote_name, device->remote_address);
 		}
 	}
+	bt_notify(BT_EVENT_DEVICES);
 }
 
 static void bt_test_dev_remove_cb(btmg_bt_device_t *device)
@@ -3683,6 +4693,7 @@ static void bt_test_dev_remove_cb(btmg_bt_device_t *device)
 		btmg_dev_list_remove_device(discovered_audiodev, device->remote_address);
 		btmg_dev_list_remove_device(discovered_controllers, device->remote_address);
 	}
+	bt_notify(BT_EVENT_DEVICES);
 }
 
 static void bt_test_update_rssi_cb(const char *address, int rssi)
@@ -3729,6 +4740,7 @@ static void bt_test_bond_state_cb(btmg_bond_state_t state,const  char *bd_addr,c
 			btlog("Pairing state for %s is BONDING\n", name);
 		}
 	}
+	bt_notify(BT_EVENT_CONNECTION);
 }
 #define BUFFER_SIZE 17
 static void bt_test_pair_ask(const char *prompt,char *buffer)
@@ -3861,6 +4873,7 @@ static void bt_test_a2dp_source_connection_state_cb(const char *bd_addr, btmg_a2
 	} else if (state == BTMG_A2DP_SOURCE_DISCONNEC_FAILED) {
 		btlog("A2DP source disconnect with device: %s failed!\n", bd_addr);
 	}
+	bt_notify(BT_EVENT_CONNECTION);
 }
 
 static void bt_test_a2dp_source_audio_state_cb(const char *bd_addr, btmg_a2dp_source_audio_state_t state)
@@ -4205,50 +5218,266 @@ void PLAT_bluetoothDisconnect(char *addr)
 	//	LOG_error("BT disconnect BTMG_AVRCP failed: %d\n", ret);
 }
 
-bool PLAT_bluetoothConnected()
+// connection state
+// most processes never start btmanager, so rather than asking it (or forking
+// hcitool every few seconds) each one keeps raw hci sockets filtered down to
+// connect/disconnect events on the service thread and only re-reads the
+// kernel's connection list when one arrives. the kernel only delivers those
+// to sockets bound to that adapter, so there's one per adapter plus an
+// unbound one for the stack's adapter added/removed/up/down events, which
+// is when the per-adapter ones get (re)bound.
+
+#include <sys/socket.h>
+
+// from the kernel's hci.h/hci_sock.h uapi, the bluez headers aren't in the toolchain
+#define BT_PROTO_HCI 1
+#define BT_HCI_DEV_NONE 0xffff
+#define BT_HCI_CHANNEL_RAW 0
+#define BT_SOL_HCI 0
+#define BT_HCI_FILTER 2
+#define BT_HCI_EVENT_PKT 0x04
+#define BT_HCI_ACL_LINK 0x01
+#define BT_EVT_CONN_COMPLETE 0x03
+#define BT_EVT_DISCONN_COMPLETE 0x05
+#define BT_EVT_STACK_INTERNAL 0xfd
+#define BT_EVT_SI_DEVICE 0x0001
+#define BT_HCI_DEV_REG 1
+#define BT_HCI_DEV_UNREG 2
+#define BT_HCI_DEV_UP 3
+#define BT_HCIGETDEVLIST _IOR('H', 210, int)
+#define BT_HCIGETCONNLIST _IOR('H', 212, int)
+#define BT_MAX_DEV 4
+#define BT_MAX_CONN 8
+
+struct bt_sockaddr_hci {
+	sa_family_t hci_family;
+	unsigned short hci_dev;
+	unsigned short hci_channel;
+};
+struct bt_hci_filter {
+	uint32_t type_mask;
+	uint32_t event_mask[2];
+	uint16_t opcode;
+};
+struct bt_hci_conn_info {
+	uint16_t handle;
+	uint8_t bdaddr[6];
+	uint8_t type;
+	uint8_t out;
+	uint16_t state;
+	uint32_t link_mode;
+};
+
+typedef struct {
+	int dev_id;
+	int sock;
+	int task;
+} bt_adapter;
+
+static struct {
+	pthread_mutex_t lock;
+	int sock; // unbound, stack events and the ioctls
+	int task;
+	bt_adapter adapters[BT_MAX_DEV];
+	int connected;
+	int failed;
+} bt_link = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.sock = -1,
+	.task = -1,
+};
+
+// same as hcitool con | grep ACL
+static int bt_acl_connected(int sock)
 {
-	//bt_paried_device *devices = NULL;
-	//int pairCnt = -1;
-	//bool connected = false;
-//
-	//bt_manager_get_paired_devices(&devices,&pairCnt);
-	//bt_paried_device *iter = devices;
-	//if(iter) {
-	//	while(iter) {
-	//		if(iter->is_connected) {
-	//			connected = true;
-	//			break;
-	//		}
-//
-	//		iter = iter->next;
-	//	}
-	//	bt_manager_free_paired_devices(devices);
-	//}
-	
-	// no btmgr here!
+	struct {
+		uint16_t dev_num;
+		struct {
+			uint16_t dev_id;
+			uint32_t dev_opt;
+		} dev_req[BT_MAX_DEV];
+	} devs = { .dev_num = BT_MAX_DEV };
+	if (ioctl(sock, BT_HCIGETDEVLIST, &devs) < 0)
+		return 0;
 
-	FILE *fp;
-    char buffer[256];
-	bool connected = false;
+	for (int d = 0; d < devs.dev_num; d++) {
+		struct {
+			uint16_t dev_id;
+			uint16_t conn_num;
+			struct bt_hci_conn_info conn_info[BT_MAX_CONN];
+		} conns = { .dev_id = devs.dev_req[d].dev_id, .conn_num = BT_MAX_CONN };
+		if (ioctl(sock, BT_HCIGETCONNLIST, &conns) < 0)
+			continue;
+		for (int c = 0; c < conns.conn_num; c++) {
+			if (conns.conn_info[c].type == BT_HCI_ACL_LINK)
+				return 1;
+		}
+	}
+	return 0;
+}
 
-	fp = popen("hcitool con", "r");
-    if (fp == NULL) {
-        perror("Failed to run hcitool");
-        return 1;
-    }
+static void bt_link_update(void)
+{
+	int connected = bt_acl_connected(bt_link.sock);
+	if (connected != bt_link.connected)
+		btlog("bluetooth %s\n", connected ? "connected" : "disconnected");
+	bt_link.connected = connected;
+}
 
-    while (fgets(buffer, sizeof(buffer), fp) != NULL) {
-        if (strstr(buffer, "ACL")) {
-            connected = true;
-            break;
-        }
-    }
+static int bt_hci_listen(int dev_id, const int *events, int count)
+{
+	int sock = socket(AF_BLUETOOTH, SOCK_RAW | SOCK_CLOEXEC, BT_PROTO_HCI);
+	if (sock < 0)
+		return -1;
+
+	struct bt_hci_filter filter = { .type_mask = 1 << BT_HCI_EVENT_PKT };
+	for (int i = 0; i < count; i++) {
+		int bit = events[i] & 63;
+		filter.event_mask[bit >> 5] |= 1u << (bit & 31);
+	}
+	struct bt_sockaddr_hci addr = {
+		.hci_family = AF_BLUETOOTH,
+		.hci_dev = dev_id,
+		.hci_channel = BT_HCI_CHANNEL_RAW,
+	};
+	if (setsockopt(sock, BT_SOL_HCI, BT_HCI_FILTER, &filter, sizeof(filter)) < 0
+		|| bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+static void bt_adapter_changed(void *arg)
+{
+	bt_adapter *adapter = arg;
+	char buffer[260]; // the largest hci event
+	while (recv(adapter->sock, buffer, sizeof(buffer), MSG_DONTWAIT) > 0)
+		; // which event doesn't matter, the connection list is the truth
+
+	pthread_mutex_lock(&bt_link.lock);
+	bt_link_update();
+	pthread_mutex_unlock(&bt_link.lock);
+}
+
+static void bt_adapter_close(bt_adapter *adapter)
+{
+	if (adapter->sock < 0)
+		return;
+	SVC_remove(adapter->task);
+	close(adapter->sock);
+	adapter->sock = -1;
+	adapter->task = -1;
+}
+
+// a socket bound to an adapter goes dead when it's unregistered, so this
+// always starts over with a fresh one
+static void bt_adapter_bind(int dev_id)
+{
+	bt_adapter *adapter = NULL;
+	for (int i = 0; i < BT_MAX_DEV; i++) {
+		if (bt_link.adapters[i].sock >= 0 && bt_link.adapters[i].dev_id == dev_id) {
+			adapter = &bt_link.adapters[i];
+			bt_adapter_close(adapter);
+			break;
+		}
+	}
+	for (int i = 0; !adapter && i < BT_MAX_DEV; i++) {
+		if (bt_link.adapters[i].sock < 0)
+			adapter = &bt_link.adapters[i];
+	}
+	if (!adapter)
+		return;
+
+	static const int events[] = { BT_EVT_CONN_COMPLETE, BT_EVT_DISCONN_COMPLETE };
+	adapter->sock = bt_hci_listen(dev_id, events, 2);
+	if (adapter->sock < 0) {
+		LOG_error("bluetooth: can't listen on hci%i: %s\n", dev_id, strerror(errno));
+		return;
+	}
+	adapter->dev_id = dev_id;
+	adapter->task = SVC_watch(adapter->sock, bt_adapter_changed, adapter);
+}
+
+static void bt_adapter_unbind(int dev_id)
+{
+	for (int i = 0; i < BT_MAX_DEV; i++) {
+		if (bt_link.adapters[i].dev_id == dev_id)
+			bt_adapter_close(&bt_link.adapters[i]);
+	}
+}
+
+static void bt_link_changed(void *arg)
+{
+	uint8_t buffer[260]; // the largest hci event
+	ssize_t size;
+	pthread_mutex_lock(&bt_link.lock);
+	while ((size = recv(bt_link.sock, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+		// packet type, event code, length, then evt_stack_internal { type, evt_si_device { event, dev_id } }
+		if (size < 9 || buffer[1] != BT_EVT_STACK_INTERNAL || (buffer[3] | buffer[4] << 8) != BT_EVT_SI_DEVICE)
+			continue;
+		int event = buffer[5] | buffer[6] << 8;
+		int dev_id = buffer[7] | buffer[8] << 8;
+		if (event == BT_HCI_DEV_REG || event == BT_HCI_DEV_UP)
+			bt_adapter_bind(dev_id);
+		else if (event == BT_HCI_DEV_UNREG)
+			bt_adapter_unbind(dev_id);
+	}
+	bt_link_update();
+	pthread_mutex_unlock(&bt_link.lock);
+}
 
-    pclose(fp);
+// expects bt_link.lock
+static void bt_link_open(void)
+{
+	for (int i = 0; i < BT_MAX_DEV; i++)
+		bt_link.adapters[i].sock = bt_link.adapters[i].task = -1;
+
+	static const int events[] = { BT_EVT_STACK_INTERNAL };
+	int sock = bt_hci_listen(BT_HCI_DEV_NONE, events, 1);
+	if (sock < 0) {
+		LOG_error("bluetooth: can't listen for hci events: %s\n", strerror(errno));
+		bt_link.failed = 1;
+		return;
+	}
+	bt_link.sock = sock;
+	bt_link.task = SVC_watch(sock, bt_link_changed, NULL);
+
+	// adapters that were already there before we started listening
+	struct {
+		uint16_t dev_num;
+		struct {
+			uint16_t dev_id;
+			uint32_t dev_opt;
+		} dev_req[BT_MAX_DEV];
+	} devs = { .dev_num = BT_MAX_DEV };
+	if (ioctl(sock, BT_HCIGETDEVLIST, &devs) == 0) {
+		for (int d = 0; d < devs.dev_num; d++)
+			bt_adapter_bind(devs.dev_req[d].dev_id);
+	}
+	bt_link.connected = bt_acl_connected(sock);
+}
 
+bool PLAT_bluetoothConnected()
+{
+	pthread_mutex_lock(&bt_link.lock);
+	if (bt_link.sock < 0 && !bt_link.failed)
+		bt_link_open();
+	bool connected = bt_link.connected;
+	pthread_mutex_unlock(&bt_link.lock);
 	return connected;
 }
 
+void PLAT_bluetoothEventsRegister(void (*cb)(int event))
+{
+	bt_event_callback = cb;
+}
+
+void PLAT_bluetoothEventsUnregister(void)
+{
+	bt_event_callback = NULL;
+}
+
 int PLAT_bluetoothVolume()
 {
 	int vol_value = 0;